@@ -6,11 +6,25 @@ TEMPLATE = app
 SOURCES += \
     main.cpp \
     jsonwidget.cpp \
-    ../src/jsontreemodel.cpp
+    ../src/jsontreemodel.cpp \
+    ../src/jsontreesnapshot.cpp \
+    ../src/jsontreeflatmodel.cpp \
+    ../src/jsontreefiltermodel.cpp \
+    ../src/jsontreepager.cpp \
+    ../src/jsontreequery.cpp \
+    ../src/jsontreedictionary.cpp
 
 HEADERS += \
     jsonwidget.h \
-    ../src/jsontreemodel.h
+    ../src/datatreemodelnode.h \
+    ../src/datatreemodelcore.h \
+    ../src/jsontreemodel.h \
+    ../src/jsontreesnapshot.h \
+    ../src/jsontreeflatmodel.h \
+    ../src/jsontreefiltermodel.h \
+    ../src/jsontreepager.h \
+    ../src/jsontreequery.h \
+    ../src/jsontreedictionary.h
 
 FORMS += \
     jsonwidget.ui
@@ -53,14 +53,16 @@ JsonWidget::JsonWidget(QWidget *parent) :
 	// Connect View actions
 	auto getModelJson = [=](const QModelIndex& index) -> QByteArray
 	{
+		// NOTE: The preview is cut short, so that clicking the root of a huge document doesn't serialize all of it
+		if (index.column() == 0)
+			return model->preview(index);
+
 		auto json = model->json(index);
 		switch (json.type())
 		{
 		case QJsonValue::Bool: return json.toBool() ? "true" : "false";
 		case QJsonValue::Double: return QByteArray::number(json.toDouble());
 		case QJsonValue::String: return json.toString().toUtf8();
-		case QJsonValue::Array: return QJsonDocument(json.toArray()).toJson();
-		case QJsonValue::Object: return QJsonDocument(json.toObject()).toJson();
 		default: return QByteArray();
 		}
 	};
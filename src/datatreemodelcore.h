@@ -0,0 +1,207 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef DATATREEMODELCORE_H
+#define DATATREEMODELCORE_H
+
+#include "datatreemodelnode.h"
+#include <QModelIndex>
+#include <QStringList>
+
+//=================================
+// DataTreeModelCore
+//=================================
+/*!
+	\class DataTreeModelCore
+	\brief DataTreeModelCore implements the parts of the item model interface that JsonTreeModel
+		   and VariantTreeModel share.
+
+	Both models lay out their nodes in the same way:
+
+	- Column 0 shows the structure of the tree. It contains array indices and object member names.
+	- Column 1 shows the scalar elements of arrays.
+	- Columns 2 and above show the scalar members of objects (the \e named \e scalar \e columns).
+
+	The model indexes of both models point to their nodes. The functions of this class work on
+	the nodes alone, so each model only adds what it keeps beside its nodes (such as its headers)
+	and calls \c createIndex() itself.
+
+	In the functions below, \a columns holds the names of all columns under a parent, including
+	the first two.
+*/
+template<typename Value>
+class DataTreeModelCore
+{
+public:
+	typedef DataTreeModelNode<Value> Node;
+	typedef DataTreeModelScalarNode<Value> ScalarNode;
+	typedef DataTreeModelListNode<Value> ListNode;
+	typedef DataTreeModelNamedListNode<Value> NamedListNode;
+	typedef typename Node::Traits Traits;
+
+	/*!
+		\brief Returns the node under the given \a index, or \a rootNode if the \a index is invalid.
+	*/
+	static inline Node* node(const QModelIndex& index, ListNode* rootNode)
+	{ return index.isValid() ? static_cast<Node*>(index.internalPointer()) : rootNode; }
+
+	/*!
+		\brief Returns the array or object under the given \a index (\a rootNode if the \a index
+		is invalid), or \c nullptr if there is none.
+	*/
+	static inline ListNode* listNode(const QModelIndex& index, ListNode* rootNode)
+	{
+		auto found = node(index, rootNode);
+		if (found == nullptr || found->type() == Node::Scalar) // Short-circuit
+			return nullptr;
+		return static_cast<ListNode*>(found);
+	}
+
+	/*!
+		\brief Returns the number of rows under the given \a parent.
+
+		The rows of an array are its elements. The rows of an object are its non-scalar members.
+	*/
+	static inline int rowCount(const QModelIndex& parent, ListNode* rootNode)
+	{
+		// NOTE: A QTreeView will try to probe the child count of all nodes, so we must check the node type.
+		auto parentNode = listNode(parent, rootNode);
+		return (parentNode != nullptr) ? parentNode->childCount() : 0;
+	}
+
+	/*!
+		\brief Returns the node in the given \a row of \a parentNode, or \c nullptr if the \a row
+		does not exist.
+	*/
+	static inline Node* child(ListNode* parentNode, int row)
+	{
+		if (parentNode == nullptr || row >= parentNode->childCount() || row < 0)
+			return nullptr;
+		return parentNode->childAt(row);
+	}
+
+	static Node* parentNode(const QModelIndex& index, const ListNode* rootNode, int* row);
+	static QVariant displayData(const QModelIndex& index, const QStringList& columns);
+	static Value value(const QModelIndex& index, ListNode* rootNode, const QStringList& columns);
+	static bool isEditable(const QModelIndex& index);
+};
+
+/*!
+	\brief Returns the node that is the parent row of the given \a index, and stores its row in
+	\a row. Returns \c nullptr if the \a index is a top-level row, or if it is invalid.
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelCore<Value>::parentNode(const QModelIndex& index, const ListNode* rootNode, int* row)
+{
+	auto node = static_cast<Node*>(index.internalPointer());
+	if (node == nullptr)
+		return nullptr;
+
+	auto parent = node->parent();
+	if (parent == nullptr || parent == rootNode)
+		return nullptr;
+
+	Q_ASSERT(parent->type() != Node::Scalar);
+	auto grandparent = static_cast<ListNode*>(parent->parent());
+	Q_ASSERT(grandparent != nullptr);
+	*row = grandparent->childPosition(parent);
+	return parent;
+}
+
+/*!
+	\brief Returns the text that a view shows under the given \a index.
+
+	In column 0, this is the array index or the object member name of the row. In the other
+	columns, this is the scalar value, converted to a QVariant.
+*/
+template<typename Value>
+QVariant
+DataTreeModelCore<Value>::displayData(const QModelIndex& index, const QStringList& columns)
+{
+	auto node = static_cast<Node*>(index.internalPointer());
+	if (node == nullptr)
+		return QVariant();
+
+	const int column = index.column();
+	switch (column)
+	{
+	case 0: // Struct column
+		if (node->parent()->type() == Node::Array)
+			return index.row();
+
+		// A node's parent cannot be a Scalar node
+		Q_ASSERT(node->parent()->type() == Node::Object);
+		return static_cast<NamedListNode*>( node->parent() )->childListNodeName(node);
+
+	case 1: // Scalar column
+		if (node->type() == Node::Scalar)
+			return Traits::toVariant( static_cast<ScalarNode*>(node)->value() );
+		break;
+
+	default: // Named scalars
+		if (node->type() == Node::Object && column < columns.count())
+			return Traits::toVariant( static_cast<NamedListNode*>(node)->namedScalarValue(columns[column]) );
+	}
+	return QVariant();
+}
+
+/*!
+	\brief Returns the value under the given \a index, or the whole tree if the \a index is
+	invalid.
+
+	Unlike displayData(), this returns the full array or object of the row in column 0.
+*/
+template<typename Value>
+Value
+DataTreeModelCore<Value>::value(const QModelIndex& index, ListNode* rootNode, const QStringList& columns)
+{
+	// Top-level
+	if (!index.isValid())
+		return (rootNode != nullptr) ? rootNode->value() : Value();
+
+	// Not top-level
+	auto node = static_cast<Node*>(index.internalPointer());
+	switch (index.column())
+	{
+	case 0: // "Structure" column
+		return node->value();
+
+	case 1: // "Scalar" column
+		if (node->type() == Node::Scalar)
+			return node->value();
+		break;
+
+	default: // Named scalar columns
+		if (node->type() == Node::Object)
+			return static_cast<NamedListNode*>(node)->namedScalarValue( columns.value(index.column()) );
+	}
+	return Value();
+}
+
+/*!
+	\brief Returns \c true if the data under the given \a index is editable.
+
+	Only scalar elements of arrays (in column 1) and scalar members of objects (in the named
+	scalar columns) are editable.
+*/
+template<typename Value>
+bool
+DataTreeModelCore<Value>::isEditable(const QModelIndex& index)
+{
+	if (!index.isValid())
+		return false;
+
+	// TODO: Allow changing an Object's member names
+	auto node = static_cast<Node*>(index.internalPointer());
+	return !(  node->type() == Node::Array
+			|| ( node->type() == Node::Scalar && index.column() != 1 )
+			|| ( node->type() == Node::Object && index.column() <= 1 )  );
+}
+
+#endif // DATATREEMODELCORE_H
@@ -0,0 +1,1203 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef DATATREEMODELNODE_H
+#define DATATREEMODELNODE_H
+
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QVariant>
+#include <QVector>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+
+//=================================
+// Value backends
+//=================================
+/*!
+	\class DataTreeValueTraits
+	\brief DataTreeValueTraits describes how the node classes store, inspect and
+		   rebuild the values of a particular backend.
+
+	A backend must provide:
+	- \c List and \c Map typedefs for its structure types,
+	- isList(), isMap() and isScalar() to classify a value,
+	- toList() and toMap() to unpack a structure,
+	- toVariant() and fromVariant() to exchange scalars with item views.
+
+	Specializations are provided for QJsonValue (used by JsonTreeModel) and QVariant
+	(used by VariantTreeModel).
+*/
+template<typename Value>
+struct DataTreeValueTraits;
+
+template<>
+struct DataTreeValueTraits<QJsonValue>
+{
+	typedef QJsonArray List;
+	typedef QJsonObject Map;
+
+	static inline bool isList(const QJsonValue& value)
+	{ return value.type() == QJsonValue::Array; }
+
+	static inline bool isMap(const QJsonValue& value)
+	{ return value.type() == QJsonValue::Object; }
+
+	static inline bool isScalar(const QJsonValue& value)
+	{ return !isList(value) && !isMap(value) && value.type() != QJsonValue::Undefined; }
+
+	static inline List toList(const QJsonValue& value)
+	{ return value.toArray(); }
+
+	static inline Map toMap(const QJsonValue& value)
+	{ return value.toObject(); }
+
+	/*
+		Qt Bug? (As of Qt 5.10.0)
+		- If the data value is a QJsonValue that holds a string, it shows up fine in the View.
+		- If the data value is a QJsonValue that holds a double, it doesn't show up fine in the View.
+		- If the data value is a QVariant that holds a double, it shows up fine in the View.
+
+		Possibly related to the fact that QVariant::toString() works if the data is QJsonValue::String, but not QJsonValue::Number
+
+		See also
+		- QTBUG-52097
+		- QTBUG-53579
+		- QTBUG-60999
+	*/
+	static inline QVariant toVariant(const QJsonValue& value)
+	{ return value.toVariant(); }
+
+	static bool fromVariant(const QVariant& variant, QJsonValue* value)
+	{
+		switch (  static_cast<QMetaType::Type>( variant.type() )  )
+		{
+		case QMetaType::Void:
+			*value = QJsonValue();
+			return true;
+
+		case QMetaType::Bool:
+			*value = variant.toBool();
+			return true;
+
+		case QMetaType::Short:
+		case QMetaType::UShort:
+		case QMetaType::Int:
+		case QMetaType::UInt:
+		case QMetaType::Long:
+		case QMetaType::ULong:
+		case QMetaType::LongLong:
+		case QMetaType::ULongLong:
+		case QMetaType::Float:
+		case QMetaType::Double:
+			*value = variant.toDouble(); // TODO: Preserve numeric representation?
+			return true;
+
+		// TODO: Convert char/QChar?
+
+		case QMetaType::QString:
+			*value = variant.toString();
+			return true;
+
+		default:
+			return false;
+		}
+	}
+};
+
+template<>
+struct DataTreeValueTraits<QVariant>
+{
+	typedef QVariantList List;
+	typedef QVariantMap Map;
+
+	static inline bool isList(const QVariant& value)
+	{ return value.userType() == QMetaType::QVariantList || value.userType() == QMetaType::QStringList; }
+
+	static inline bool isMap(const QVariant& value)
+	{ return value.userType() == QMetaType::QVariantMap || value.userType() == QMetaType::QVariantHash; }
+
+	// NOTE: An invalid QVariant is a null scalar, like a JSON null
+	static inline bool isScalar(const QVariant& value)
+	{ return !isList(value) && !isMap(value); }
+
+	static inline List toList(const QVariant& value)
+	{ return value.toList(); }
+
+	static inline Map toMap(const QVariant& value)
+	{ return value.toMap(); }
+
+	// NOTE: QVariant is already what the views consume, so no conversion is needed
+	static inline const QVariant& toVariant(const QVariant& value)
+	{ return value; }
+
+	static inline bool fromVariant(const QVariant& variant, QVariant* value)
+	{
+		if (isList(variant) || isMap(variant))
+			return false;
+		*value = variant;
+		return true;
+	}
+};
+
+
+//=================================
+// Column discovery
+//=================================
+/*!
+	\struct DataTreeScalarNameCollector
+	\brief DataTreeScalarNameCollector collects the names of the scalar members of the objects
+		   within a structure while its nodes are being constructed.
+
+	This finds the same names as dataTreeScalarNames(), without a separate walk through the
+	structure.
+*/
+struct DataTreeScalarNameCollector
+{
+	explicit DataTreeScalarNameCollector(bool comprehensive) : comprehensive(comprehensive) {}
+
+	QSet<QString> names;
+	bool comprehensive; ///< If \c false, only the first element of each array is scanned.
+};
+
+
+//=================================
+// DataTreeModelNode and subclasses
+//=================================
+template<typename Value> class DataTreeModelScalarNode;
+template<typename Value> class DataTreeModelListNode;
+template<typename Value> class DataTreeModelNamedListNode;
+template<typename Value> class DataTreeModelNodeLoader;
+
+/*!
+	\class DataTreeModelNode
+	\brief DataTreeModelNode is the base class for the internal data structure behind
+		   JsonTreeModel and VariantTreeModel.
+
+	The node classes are templates on the \c Value type of the backend (see DataTreeValueTraits).
+	The node type is stored in the base class, so type() and value() do not need virtual
+	dispatch.
+*/
+template<typename Value>
+class DataTreeModelNode
+{
+public:
+	typedef DataTreeValueTraits<Value> Traits;
+
+	enum Type {
+		Scalar, ///< Represents scalar values (nulls, Booleans, numbers, and strings).
+		Object, ///< Represents named structures (JSON objects, QVariantMaps).
+		Array   ///< Represents ordered structures (JSON arrays, QVariantLists).
+	};
+
+	/*!
+		\brief Constructs a new node of the given \a type with the given \a parent.
+
+		\note Only a DataTreeModelListNode (or one of its subclasses) can be a parent.
+	*/
+	DataTreeModelNode(Type type, DataTreeModelNode* parent) : m_parent(parent), m_type(type), m_cachedHash(0) {}
+
+	/*!
+		\brief Frees the memory held by this node and its children.
+
+		\warning This node is not automatically removed from its parent's list of children.
+	*/
+	virtual ~DataTreeModelNode() {}
+
+	/*!
+		\brief Returns this node's parent.
+
+		\sa setParent()
+	*/
+	inline DataTreeModelNode* parent() const
+	{ return m_parent; }
+
+	/*!
+		\brief Makes this node a child of \a parent.
+
+		\note Only a DataTreeModelListNode (or one of its subclasses) can be a parent.
+
+		\warning This function only updates this node's internal pointer to its parent. The caller
+				 must manually update the child's
+				 \link DataTreeModelListNode::registerChild() registration\endlink.
+
+		\sa parent()
+	*/
+	inline void setParent(DataTreeModelNode* parent)
+	{ Q_ASSERT(parent->type() != Scalar); m_parent = parent; }
+
+	/*!
+		\brief Returns the type of data represented by this node.
+	*/
+	inline Type type() const
+	{ return m_type; }
+
+	Value value() const;
+
+	/*!
+		\brief Returns the hash of this node's contents that was stored by setCachedHash(), or 0 if
+		there is none.
+
+		The node does not compute the hash itself; the model decides how values are hashed.
+
+		\sa invalidateCachedHash()
+	*/
+	inline quint64 cachedHash() const
+	{ return m_cachedHash; }
+
+	/*!
+		\brief Stores the \a hash of this node's contents. A \a hash of 0 means "not computed".
+
+		\sa cachedHash()
+	*/
+	inline void setCachedHash(quint64 hash) const
+	{ m_cachedHash = hash; }
+
+	/*!
+		\brief Clears the cached hashes of this node and its ancestors, after this node's contents
+		changed.
+
+		\sa cachedHash()
+	*/
+	inline void invalidateCachedHash()
+	{ for (auto node = this; node != nullptr; node = node->m_parent) node->m_cachedHash = 0; }
+
+private:
+	// NOTE: Only DataTreeModelListNode can be a parent, but I don't want to introduce a dependency to a subclass
+	DataTreeModelNode* m_parent;
+	const Type m_type;
+	mutable quint64 m_cachedHash;
+};
+
+/*!
+	\class DataTreeModelScalarNode
+	\brief DataTreeModelScalarNode is the most basic element of the model's internal data.
+
+	It represents a single scalar value (nulls, Booleans, numbers, and strings).
+
+	\note DataTreeModelScalarNode cannot be the \link DataTreeModelNode::parent() parent \endlink of another node.
+*/
+template<typename Value>
+class DataTreeModelScalarNode : public DataTreeModelNode<Value>
+{
+public:
+	typedef DataTreeModelNode<Value> Node;
+
+	/*!
+		\brief Constructs a node under the specified \a parent to represent the specified scalar \a value.
+	*/
+	DataTreeModelScalarNode(const Value& value, Node* parent) :
+		Node(Node::Scalar, parent),
+		m_value(value)
+	{}
+
+	/*!
+		\brief Returns the scalar value represented by this node.
+
+		\sa setValue()
+	*/
+	inline const Value& value() const
+	{ return m_value; }
+
+	/*!
+		\brief Replaces the \a value represented by this node.
+
+		\sa value()
+	*/
+	inline void setValue(const Value& value)
+	{ m_value = value; }
+
+private:
+	Value m_value;
+};
+
+/*!
+	\class DataTreeModelListNode
+	\brief DataTreeModelListNode represents a structure (namely an array or an object)
+		   and provides the backbone of the tree model.
+
+	This class can have \e children. Child nodes manifest as child rows in the model.
+
+	Objects are best represented as a DataTreeModelNamedListNode.
+*/
+template<typename Value>
+class DataTreeModelListNode : public DataTreeModelNode<Value>
+{
+public:
+	typedef DataTreeModelNode<Value> Node;
+	typedef typename Node::Traits Traits;
+
+	/*!
+		\brief Constructs an empty DataTreeModelListNode under the specified \a parent.
+
+		The new node can be populated later.
+	*/
+	DataTreeModelListNode(Node* parent) : Node(Node::Array, parent), m_isWrapper(false), m_isExpanded(false), m_loader(nullptr) {}
+	DataTreeModelListNode(const typename Traits::List& list, Node* parent, const QSet<QString>* projection = nullptr,
+			DataTreeScalarNameCollector* collector = nullptr);
+
+	~DataTreeModelListNode() override
+	{
+		// TODO: Tell parent to remove this child from its list? Only if we do partial deletions
+		qDeleteAll(m_childList);
+		delete m_loader;
+	}
+
+	/*!
+		\brief Returns the child node at index \a i.
+
+		\warning The caller must ensure that 0 <= \a i < childCount()
+
+		\sa childPosition()
+	*/
+	inline Node* childAt(int i) const
+	{ ensureLoaded(); return m_childList[i]; }
+
+	/*!
+		\brief Returns the number of child nodes under this row.
+
+		This is equivalent to the number of rows in the model where this node is the parent QModelIndex.
+	*/
+	inline int childCount() const;
+
+	/*!
+		\brief Returns index number of the specified \a child, or
+		-1 if the \a child does not belong to this node.
+
+		\sa childAt()
+	*/
+	inline int childPosition(Node* child) const
+	{ ensureLoaded(); return m_childPositions.value(child, -1); }
+
+	/*!
+		\brief Returns \c true if this node is a DataTreeModelWrapperNode.
+	*/
+	inline bool isWrapper() const
+	{ return m_isWrapper; }
+
+	/*!
+		\brief Returns \c true if this node's children are shown by views that flatten the tree.
+
+		\sa setExpanded()
+	*/
+	inline bool isExpanded() const
+	{ return m_isExpanded; }
+
+	/*!
+		\brief Sets whether this node's children are shown by views that flatten the tree.
+
+		\note This is only a flag. Use JsonTreeFlatModel::setExpanded() to expand a row of
+			  a flattened model.
+
+		\sa isExpanded()
+	*/
+	inline void setExpanded(bool expanded)
+	{ m_isExpanded = expanded; }
+
+	/*!
+		\brief Returns \c false if the creation of this node's contents is still deferred.
+
+		\sa setLoader()
+	*/
+	inline bool isLoaded() const
+	{ return m_loader == nullptr; }
+
+	void setLoader(DataTreeModelNodeLoader<Value>* loader);
+	void releaseChildren(DataTreeModelNodeLoader<Value>* loader);
+
+	/*!
+		\brief Creates the contents of this node if they were deferred via setLoader().
+
+		All accessors call this function, so callers rarely need to call it directly.
+	*/
+	inline void ensureLoaded() const
+	{
+		if (Q_UNLIKELY(m_loader != nullptr))
+			load();
+	}
+
+	Node* insertChild(int position, const Value& value);
+	Node* takeChild(int position);
+	void appendChildren(const QVector<Node*>& children);
+
+	Value value() const;
+
+protected:
+	DataTreeModelListNode(typename Node::Type type, Node* parent) : Node(type, parent), m_isWrapper(false), m_isExpanded(false), m_loader(nullptr) {}
+
+	void registerChild(Node* child);
+	void deregisterChild(Node* child);
+
+	Node* createChild(const Value& child, const QSet<QString>* projection = nullptr, DataTreeScalarNameCollector* collector = nullptr);
+
+	/* Returns the loader of this node, or nullptr if its contents are not deferred */
+	inline const DataTreeModelNodeLoader<Value>* loader() const
+	{ return m_loader; }
+
+	// NOTE: Set by DataTreeModelWrapperNode, so that value() can stay non-virtual
+	bool m_isWrapper;
+	bool m_isExpanded;
+
+private:
+	void load() const;
+
+	QVector<Node*> m_childList;
+	QHash<Node*, int> m_childPositions;
+
+	// NOTE: Mutable because the contents of a deferred node are created by const accessors
+	mutable DataTreeModelNodeLoader<Value>* m_loader;
+
+	friend class DataTreeModelNodeLoader<Value>;
+};
+
+/*!
+	\class DataTreeModelNamedListNode
+	\brief DataTreeModelNamedListNode represents an object (a JSON object or a QVariantMap).
+
+	Scalar members of this node appear in named scalar columns in the model.
+
+	Non-scalar members of this node (arrays and objects) appear as child rows in the model.
+
+	If this node represents a top-level object of a document and it contains scalar
+	members, then this node must be wrapped in a DataTreeModelWrapperNode.
+*/
+template<typename Value>
+class DataTreeModelNamedListNode : public DataTreeModelListNode<Value>
+{
+public:
+	typedef DataTreeModelNode<Value> Node;
+	typedef typename Node::Traits Traits;
+
+	DataTreeModelNamedListNode(const typename Traits::Map& map, Node* parent, const QSet<QString>* projection = nullptr,
+			DataTreeScalarNameCollector* collector = nullptr);
+
+	/*!
+		\brief Returns the member name of the specified non-scalar \a child.
+	*/
+	inline QString childListNodeName(Node* child) const
+	{ this->ensureLoaded(); return m_childListNodeNames[child]; }
+
+	/*!
+		\brief Returns the number of scalar elements within this node.
+
+		In the model, these are the elements that appear under the named scalar columns.
+	*/
+	inline int namedScalarCount() const
+	{ return namedScalars().size(); }
+
+	/*!
+		\brief Returns the scalar element in this node which has the given \a name.
+
+		If the underlying object has no member with the given \a name (or if the member
+		is non-scalar), this function returns a default-constructed \c Value.
+
+		Unlike namedScalars(), this does not materialize the members that were left out by a
+		projection.
+
+		\sa setNamedScalarValue()
+	*/
+	Value namedScalarValue(const QString& name) const;
+	bool hasNamedScalar(const QString& name) const;
+
+	void collectNamedScalarNames(QSet<QString>* names) const;
+
+	/*!
+		\brief Returns all scalar elements in this node, keyed by name.
+
+		If the node was constructed with a projection, the members that were left out are
+		materialized first.
+	*/
+	inline const QMap<QString, Value>& namedScalars() const
+	{ this->ensureLoaded(); materializeScalars(); return m_namedScalarMap; }
+
+	/*!
+		\brief Adds or updates a scalar element of the object represented by this node.
+
+		\sa namedScalarValue()
+	*/
+	inline void setNamedScalarValue(const QString& name, const Value& value)
+	{
+		Q_ASSERT(Traits::isScalar(value));
+		this->ensureLoaded();
+		m_namedScalarMap[name] = value;
+	}
+
+	/*!
+		\brief Removes the scalar element with the given \a name from the object represented by this node.
+
+		\sa setNamedScalarValue()
+	*/
+	inline void removeNamedScalarValue(const QString& name)
+	{
+		this->ensureLoaded();
+		materializeScalars(); // NOTE: Otherwise, the residual would bring the member back
+		m_namedScalarMap.remove(name);
+	}
+
+	/*!
+		\brief Replaces each stored scalar element with the result of calling \a function with
+		its name and value.
+
+		Unlike namedScalars(), this neither loads deferred contents nor materializes the members
+		that were left out by a projection, so those members are not passed to \a function.
+	*/
+	template<typename Function>
+	void updateNamedScalars(Function function)
+	{
+		for (auto i = m_namedScalarMap.begin(); i != m_namedScalarMap.end(); ++i)
+			i.value() = function(i.key(), i.value());
+	}
+
+	/*!
+		\brief Makes this node's scalar elements a copy of those in \a other.
+
+		The copy is implicitly shared, so the two nodes only store their scalars once until
+		either of them is modified.
+	*/
+	inline void shareNamedScalars(const DataTreeModelNamedListNode& other)
+	{
+		m_namedScalarMap = other.m_namedScalarMap;
+		m_residual = other.m_residual;
+	}
+
+	Node* namedChild(const QString& name) const;
+	int namedChildInsertionPoint(const QString& name) const;
+	Node* insertNamedChild(const QString& name, const Value& value);
+	Node* takeNamedChild(const QString& name);
+
+	Value value() const;
+
+private:
+	void materializeScalars() const;
+
+	// TODO: Use DataTreeModelListNode::childPosition() for indexing; not need for map with m_childListNodeNames
+	QHash<Node*, QString> m_childListNodeNames;
+	QMap<QString, Value> m_namedScalarMap;
+
+	// NOTE: The source object, if a projection left out some of its scalars. Maps are implicitly shared, so this is
+	// only a reference; only the scalars that are not in m_namedScalarMap are read from it.
+	typename Traits::Map m_residual;
+
+	friend class DataTreeModelListNode<Value>;
+	friend class DataTreeModelNodeLoader<Value>;
+};
+
+/*!
+	\class DataTreeModelWrapperNode
+	\brief The DataTreeModelWrapperNode class wraps a top-level DataTreeModelNamedListNode,
+		   to allow its scalar members to be shown.
+*/
+template<typename Value>
+class DataTreeModelWrapperNode : public DataTreeModelListNode<Value>
+{
+public:
+	typedef DataTreeModelListNode<Value> ListNode;
+
+	/*!
+		\brief Constructs a wrapper for \a realNode and takes ownership of it.
+
+		Unlike the constructors for other classes derived from DataTreeModelNode, this one does not take a parent
+		because DataTreeModelWrapperNode is only meant to be used as the model's root node.
+	*/
+	DataTreeModelWrapperNode(DataTreeModelNamedListNode<Value>* realNode) :
+		ListNode(nullptr)
+	{
+		Q_ASSERT(realNode->parent() == nullptr);
+		this->m_isWrapper = true;
+
+		// NOTE: Only a parent can register a child, so we must call setParent() before registerChild()
+		realNode->setParent(this);
+		this->registerChild(realNode);
+	}
+};
+
+
+/*!
+	\class DataTreeModelNodeLoader
+	\brief DataTreeModelNodeLoader creates the contents of a DataTreeModelListNode on demand.
+
+	A loader is attached to an empty node via DataTreeModelListNode::setLoader(). The first
+	time any of the node's contents are accessed, load() is called once and the loader is
+	deleted. Until then, childCount() must report the number of children that load() will
+	create, so that views can show expansion indicators without loading anything.
+
+	Subclasses populate the node through the protected helper functions.
+*/
+template<typename Value>
+class DataTreeModelNodeLoader
+{
+public:
+	typedef DataTreeModelNode<Value> Node;
+	typedef DataTreeModelListNode<Value> ListNode;
+	typedef DataTreeModelNamedListNode<Value> NamedListNode;
+
+	virtual ~DataTreeModelNodeLoader() {}
+
+	/*!
+		\brief Returns the number of child nodes that load() will create.
+	*/
+	virtual int childCount() const = 0;
+
+	/*!
+		\brief Creates the contents of \a node.
+	*/
+	virtual void load(ListNode* node) = 0;
+
+	/*!
+		\brief Adds the names of the named scalars that load() will create to \a names.
+
+		The default implementation adds nothing, which is correct for loaders that leave the
+		named scalars in the node.
+	*/
+	virtual void collectScalarNames(QSet<QString>* names) const
+	{ Q_UNUSED(names) }
+
+protected:
+	static inline Node* createChild(ListNode* node, const Value& value, const QSet<QString>* projection = nullptr)
+	{ return node->createChild(value, projection); }
+
+	static inline void appendChild(ListNode* node, Node* child)
+	{ node->registerChild(child); }
+
+	static inline void appendNamedChild(NamedListNode* node, const QString& name, Node* child)
+	{
+		node->registerChild(child);
+		node->m_childListNodeNames[child] = name;
+	}
+
+	static inline void insertNamedScalar(NamedListNode* node, const QString& name, const Value& value)
+	{ node->m_namedScalarMap.insert(name, value); }
+};
+
+
+//=================================
+// Template implementations
+//=================================
+/*!
+	\brief Returns the value represented by this node and its children (if any).
+*/
+template<typename Value>
+Value
+DataTreeModelNode<Value>::value() const
+{
+	switch (m_type)
+	{
+	case Scalar: return static_cast<const DataTreeModelScalarNode<Value>*>(this)->value();
+	case Object: return static_cast<const DataTreeModelNamedListNode<Value>*>(this)->value();
+	case Array:  return static_cast<const DataTreeModelListNode<Value>*>(this)->value();
+	}
+	return Value();
+}
+
+/*!
+	\brief Constructs a node under the specified \a parent to represent the specified \a list.
+
+	All \a list elements will be placed within child nodes and \link registerChild() registered\endlink.
+	The \a projection (if any) is passed on to the objects within the list. If a \a collector is
+	given, the names of the scalar columns are added to it.
+*/
+template<typename Value>
+DataTreeModelListNode<Value>::DataTreeModelListNode(const typename Traits::List& list, Node* parent, const QSet<QString>* projection,
+		DataTreeScalarNameCollector* collector) :
+	Node(Node::Array, parent),
+	m_isWrapper(false),
+	m_isExpanded(false),
+	m_loader(nullptr)
+{
+	m_childList.reserve(list.size());
+	for (const Value& child : list)
+	{
+		auto childNode = createChild(child, projection, collector);
+
+		// NOTE: Like dataTreeScalarNames(), a quick search only looks at the first element
+		if (collector != nullptr && !collector->comprehensive)
+			collector = nullptr;
+
+		if (childNode == nullptr)
+			continue; // Shouldn't happen
+		registerChild(childNode);
+	}
+}
+
+/*!
+	\brief Returns the number of child nodes under this row.
+
+	This is equivalent to the number of rows in the model where this node is the parent QModelIndex.
+	If the contents of this node have not been created yet, they stay deferred.
+*/
+template<typename Value>
+inline int
+DataTreeModelListNode<Value>::childCount() const
+{
+	if (m_loader != nullptr)
+		return m_loader->childCount();
+	return m_childList.count();
+}
+
+/*!
+	\brief Defers the creation of this node's contents until they are first accessed.
+
+	This node takes ownership of the \a loader.
+
+	\warning This node must be empty.
+*/
+template<typename Value>
+void
+DataTreeModelListNode<Value>::setLoader(DataTreeModelNodeLoader<Value>* loader)
+{
+	Q_ASSERT(m_childList.isEmpty() && m_loader == nullptr);
+	m_loader = loader;
+}
+
+/*!
+	\brief Deletes this node's child nodes, and defers their re-creation to \a loader.
+
+	This node takes ownership of the \a loader, which must re-create the same children. The named
+	scalars of an object are kept.
+
+	\warning The caller must ensure that nothing refers to the deleted child nodes.
+
+	\sa setLoader()
+*/
+template<typename Value>
+void
+DataTreeModelListNode<Value>::releaseChildren(DataTreeModelNodeLoader<Value>* loader)
+{
+	Q_ASSERT(m_loader == nullptr);
+	qDeleteAll(m_childList);
+	m_childList.clear();
+	m_childPositions.clear();
+	if (this->type() == Node::Object)
+		static_cast<DataTreeModelNamedListNode<Value>*>(this)->m_childListNodeNames.clear();
+	m_loader = loader;
+}
+
+template<typename Value>
+void
+DataTreeModelListNode<Value>::load() const
+{
+	// NOTE: Detach the loader first, so that the loader's own calls to the accessors don't recurse
+	auto loader = m_loader;
+	m_loader = nullptr;
+	loader->load(const_cast<DataTreeModelListNode*>(this));
+	delete loader;
+}
+
+/*!
+	\brief Creates a new node under this one to represent \a child, or returns
+	\c nullptr if \a child is neither a scalar nor a structure.
+
+	The new node is not \link registerChild() registered\endlink. The \a projection (if any) and
+	the \a collector (if any) are passed on to the objects within \a child.
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelListNode<Value>::createChild(const Value& child, const QSet<QString>* projection, DataTreeScalarNameCollector* collector)
+{
+	if (Traits::isList(child))
+		return new DataTreeModelListNode<Value>(Traits::toList(child), this, projection, collector);
+	if (Traits::isMap(child))
+		return new DataTreeModelNamedListNode<Value>(Traits::toMap(child), this, projection, collector);
+	if (Traits::isScalar(child))
+		return new DataTreeModelScalarNode<Value>(child, this);
+	return nullptr;
+}
+
+/*!
+	\brief Creates a new child node to represent \a value, and inserts it at the given \a position.
+
+	Returns the new node, or \c nullptr if \a value is neither a scalar nor a structure.
+
+	\warning The caller must ensure that 0 <= \a position <= childCount(). Use
+			 DataTreeModelNamedListNode::insertNamedChild() for objects instead.
+
+	\sa takeChild()
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelListNode<Value>::insertChild(int position, const Value& value)
+{
+	ensureLoaded();
+	auto child = createChild(value);
+	if (child == nullptr)
+		return nullptr;
+
+	m_childList.insert(position, child);
+	for (int i = position; i < m_childList.count(); ++i)
+		m_childPositions[ m_childList[i] ] = i;
+	return child;
+}
+
+/*!
+	\brief Removes the child node at the given \a position from this node, and returns it.
+
+	The caller takes ownership of the returned node.
+
+	\warning The caller must ensure that 0 <= \a position < childCount(). Use
+			 DataTreeModelNamedListNode::takeNamedChild() for objects instead.
+
+	\sa insertChild()
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelListNode<Value>::takeChild(int position)
+{
+	auto child = childAt(position);
+	deregisterChild(child);
+	return child;
+}
+
+/*!
+	\brief Appends the \a children to this node, and takes ownership of them.
+
+	The \a children must not have a parent yet. This allows nodes to be created in other threads
+	(which must not touch this node) and adopted afterwards.
+
+	\warning Use DataTreeModelNamedListNode::insertNamedChild() for objects instead.
+
+	\sa insertChild()
+*/
+template<typename Value>
+void
+DataTreeModelListNode<Value>::appendChildren(const QVector<Node*>& children)
+{
+	ensureLoaded();
+	m_childList.reserve(m_childList.count() + children.count());
+	for (auto child : children)
+	{
+		Q_ASSERT(child->parent() == nullptr);
+		child->setParent(this);
+		registerChild(child);
+	}
+}
+
+/*!
+	\brief Returns the structure (array or object) represented by this node.
+*/
+template<typename Value>
+Value
+DataTreeModelListNode<Value>::value() const
+{
+	ensureLoaded();
+	if (m_isWrapper)
+		return childAt(0)->value(); // ASSUMPTION: A wrapper node will always have exactly 1 child DataTreeModelNamedListNode
+
+	typename Traits::List fullList;
+	for (const auto childNode : qAsConst(m_childList))
+		fullList.append(childNode->value());
+	return fullList;
+}
+
+/*!
+	\brief Puts the \a child node under this node's hierarchy
+
+	\note Only the \a child's parent can call this function
+*/
+template<typename Value>
+void
+DataTreeModelListNode<Value>::registerChild(Node* child)
+{
+	Q_ASSERT_X(child->parent() == this, "registerChild()", "Only a parent can register its own child");
+	m_childPositions[child] = m_childList.count();
+	m_childList << child;
+}
+
+/*!
+	\brief Removes the \a child node from this node's hierarchy
+
+	\note Only the \a child's parent can call this function
+*/
+template<typename Value>
+void
+DataTreeModelListNode<Value>::deregisterChild(Node* child)
+{
+	Q_ASSERT_X(child->parent() == this, "deregisterChild()", "Only a parent can deregister its own child");
+	ensureLoaded();
+	auto i = m_childPositions.take(child);
+	m_childList.remove(i);
+
+	// ASSUMPTION: Registration/deregistration is infrequent, but lookups are very frequent. Thus, this O(n) loop is acceptable.
+	while (i < m_childList.count())
+	{
+		m_childPositions[ m_childList[i] ] = i;
+		++i;
+	}
+	// TODO: Add function to deregister multiple children simultaneously
+}
+
+/*!
+	\brief Constructs a node under the specified \a parent to represent the specified \a map.
+
+	If a \a projection is given, only the scalar members whose names are in the \a projection are
+	copied into the node. The node keeps a reference to the \a map for the others, so value() still
+	returns the whole object. If a \a collector is given, the names of all scalar members (including
+	those of the objects within the \a map) are added to it.
+*/
+template<typename Value>
+DataTreeModelNamedListNode<Value>::DataTreeModelNamedListNode(const typename Traits::Map& map, Node* parent, const QSet<QString>* projection,
+		DataTreeScalarNameCollector* collector) :
+	DataTreeModelListNode<Value>(Node::Object, parent)
+{
+	for (auto i = map.constBegin(); i != map.constEnd(); ++i)
+	{
+		const Value child = i.value();
+		if (Traits::isScalar(child))
+		{
+			if (collector != nullptr)
+				collector->names.insert(i.key());
+			if (projection == nullptr || projection->contains(i.key()))
+				m_namedScalarMap[i.key()] = child;
+			else if (m_residual.isEmpty())
+				m_residual = map;
+			continue;
+		}
+
+		auto childNode = this->createChild(child, projection, collector);
+		if (childNode == nullptr)
+			continue;
+		this->registerChild(childNode);
+		m_childListNodeNames[childNode] = i.key();
+	}
+}
+
+template<typename Value>
+Value
+DataTreeModelNamedListNode<Value>::namedScalarValue(const QString& name) const
+{
+	this->ensureLoaded();
+	auto i = m_namedScalarMap.constFind(name);
+	if (i != m_namedScalarMap.constEnd())
+		return i.value();
+
+	if (!m_residual.isEmpty())
+	{
+		const Value member = m_residual.value(name);
+		if (Traits::isScalar(member))
+			return member;
+	}
+	return Value();
+}
+
+/*!
+	\brief Returns \c true if this node has a scalar element with the given \a name.
+
+	Unlike namedScalars(), this does not materialize the members that were left out by a
+	projection.
+
+	\sa namedScalarValue()
+*/
+template<typename Value>
+bool
+DataTreeModelNamedListNode<Value>::hasNamedScalar(const QString& name) const
+{
+	this->ensureLoaded();
+	if (m_namedScalarMap.contains(name))
+		return true;
+	return !m_residual.isEmpty() && m_residual.contains(name) && Traits::isScalar(m_residual.value(name));
+}
+
+/*!
+	\brief Adds the names of this node's scalar elements to \a names.
+
+	Unlike namedScalars(), this neither loads deferred contents nor materializes the members that
+	were left out by a projection. The names of deferred scalars are taken from the node's loader.
+*/
+template<typename Value>
+void
+DataTreeModelNamedListNode<Value>::collectNamedScalarNames(QSet<QString>* names) const
+{
+	for (auto i = m_namedScalarMap.constBegin(); i != m_namedScalarMap.constEnd(); ++i)
+		names->insert(i.key());
+	for (auto i = m_residual.constBegin(); i != m_residual.constEnd(); ++i)
+	{
+		if (Traits::isScalar(i.value()))
+			names->insert(i.key());
+	}
+	if (this->loader() != nullptr)
+		this->loader()->collectScalarNames(names);
+}
+
+/*
+	Copies the scalars that were left out by a projection from the residual source object, and
+	drops the residual.
+*/
+template<typename Value>
+void
+DataTreeModelNamedListNode<Value>::materializeScalars() const
+{
+	if (m_residual.isEmpty())
+		return;
+
+	// NOTE: Like ensureLoaded(), this completes the node's contents on demand
+	auto self = const_cast<DataTreeModelNamedListNode*>(this);
+	for (auto i = m_residual.constBegin(); i != m_residual.constEnd(); ++i)
+	{
+		const Value member = i.value();
+		if (Traits::isScalar(member) && !m_namedScalarMap.contains(i.key()))
+			self->m_namedScalarMap.insert(i.key(), member);
+	}
+	self->m_residual = typename Traits::Map();
+}
+
+/*!
+	\brief Returns the non-scalar member with the given \a name, or \c nullptr if there is none.
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelNamedListNode<Value>::namedChild(const QString& name) const
+{
+	const int position = namedChildInsertionPoint(name);
+	if (position < this->childCount())
+	{
+		auto child = this->childAt(position);
+		if (m_childListNodeNames.value(child) == name)
+			return child;
+	}
+	return nullptr;
+}
+
+/*!
+	\brief Returns the position where insertNamedChild() would insert a member with the given \a name.
+
+	The child nodes are sorted by name, so this is a binary search.
+*/
+template<typename Value>
+int
+DataTreeModelNamedListNode<Value>::namedChildInsertionPoint(const QString& name) const
+{
+	this->ensureLoaded();
+	int first = 0;
+	int last = this->childCount();
+	while (first < last)
+	{
+		const int middle = first + (last - first) / 2;
+		if (m_childListNodeNames.value(this->childAt(middle)) < name)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+/*!
+	\brief Creates a new non-scalar member with the given \a name to represent \a value.
+
+	The new node is inserted among the existing child nodes in the order of their names, which is
+	the order that the constructor creates them in. Returns the new node, or \c nullptr if
+	\a value is not a structure.
+
+	\warning The caller must ensure that this node does not have a member with the same \a name.
+
+	\sa takeNamedChild()
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelNamedListNode<Value>::insertNamedChild(const QString& name, const Value& value)
+{
+	if (!Traits::isList(value) && !Traits::isMap(value))
+		return nullptr;
+
+	auto child = this->insertChild(namedChildInsertionPoint(name), value);
+	m_childListNodeNames[child] = name;
+	return child;
+}
+
+/*!
+	\brief Removes the non-scalar member with the given \a name from this node, and returns it.
+
+	The caller takes ownership of the returned node. Returns \c nullptr if there is no such member.
+
+	\sa insertNamedChild()
+*/
+template<typename Value>
+DataTreeModelNode<Value>*
+DataTreeModelNamedListNode<Value>::takeNamedChild(const QString& name)
+{
+	auto child = namedChild(name);
+	if (child == nullptr)
+		return nullptr;
+
+	this->deregisterChild(child);
+	m_childListNodeNames.remove(child);
+	return child;
+}
+
+/*!
+	\brief Returns the object represented by this node.
+*/
+template<typename Value>
+Value
+DataTreeModelNamedListNode<Value>::value() const
+{
+	this->ensureLoaded();
+
+	typename Traits::Map fullMap;
+	for (auto i = m_residual.constBegin(); i != m_residual.constEnd(); ++i)
+	{
+		if (Traits::isScalar(i.value()))
+			fullMap.insert(i.key(), i.value()); // NOTE: Overwritten below if the member was projected
+	}
+	for (auto i = m_namedScalarMap.constBegin(); i != m_namedScalarMap.constEnd(); ++i)
+		fullMap.insert(i.key(), i.value());
+	for (auto i = m_childListNodeNames.constBegin(); i != m_childListNodeNames.constEnd(); ++i)
+		fullMap.insert(i.value(), i.key()->value()); // i's value is the element name, while i's key is the node
+	return fullMap;
+}
+
+
+//=================================
+// Helper functions
+//=================================
+/*!
+	\brief Returns the names of the scalar members of the objects within \a data.
+
+	If \a comprehensive is \c false, only the first element of each array is scanned.
+*/
+template<typename Value>
+QSet<QString>
+dataTreeScalarNames(const Value& data, bool comprehensive)
+{
+	typedef DataTreeValueTraits<Value> Traits;
+
+	auto processList = [](const typename Traits::List& list, bool comprehensive) -> QSet<QString>
+	{
+		QSet<QString> names;
+		for (const Value& element : list)
+		{
+			if (Traits::isMap(element) || Traits::isList(element))
+				names += dataTreeScalarNames(element, comprehensive);
+
+			if (!comprehensive)
+				break; // Non-comprehensive searches only look at the first array element
+		}
+		return names;
+	};
+
+	QSet<QString> names;
+	if (Traits::isList(data))
+		names += processList(Traits::toList(data), comprehensive);
+
+	else if (Traits::isMap(data))
+	{
+		const auto dataMap = Traits::toMap(data);
+		for (auto i = dataMap.constBegin(); i != dataMap.constEnd(); ++i)
+		{
+			const Value value = i.value();
+			if (Traits::isList(value))
+				names += processList(Traits::toList(value), comprehensive);
+			else if (Traits::isMap(value))
+				names += dataTreeScalarNames(value, comprehensive);
+			else
+				names += i.key(); // This is a scalar
+		}
+	}
+	return names;
+}
+
+#endif // DATATREEMODELNODE_H
@@ -0,0 +1,163 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreedictionary.h"
+
+/*!
+	\class JsonTreeStringDictionary
+	\brief The JsonTreeStringDictionary class deduplicates the repeated string values of a
+	JsonTreeModel.
+
+	Each named scalar column (and the elements of arrays) gets its own dictionary, which assigns
+	a small integer code to each distinct string. The nodes keep storing QJsonValue objects, but
+	every occurrence of a string refers to the dictionary's copy instead of its own: a million
+	rows with \c "Country" = \c "New Zealand" then hold a single copy of the text. Because equal
+	strings share their data, comparisons can recognize them without comparing any characters.
+
+	Only low-cardinality columns benefit. Once a column has more than maxCardinality() distinct
+	strings, it falls back to plain storage: its dictionary is freed, and its new values are
+	stored as they are.
+
+	\sa JsonTreeModel::setDictionaryEncoding()
+*/
+
+/*!
+	\brief Returns the code of the given \a text in the given \a column, or -1 if the text is not
+	in the column's dictionary.
+*/
+int
+JsonTreeStringDictionary::code(const QString& column, const QString& text) const
+{
+	auto entry = m_columns.constFind(column);
+	if (entry == m_columns.constEnd())
+		return -1;
+	return entry.value().codes.value(text, -1);
+}
+
+/*!
+	\brief Returns the text that has the given \a code in the given \a column, or a null string
+	if there is no such code.
+*/
+QString
+JsonTreeStringDictionary::text(const QString& column, int code) const
+{
+	return m_columns.value(column).texts.value(code);
+}
+
+/*!
+	\brief Returns \c true if the strings of the given \a column are still deduplicated, i.e. the
+	column has not fallen back to plain storage.
+*/
+bool
+JsonTreeStringDictionary::isEncoded(const QString& column) const
+{
+	auto entry = m_columns.constFind(column);
+	return entry != m_columns.constEnd() && !entry.value().isPlain;
+}
+
+/*!
+	\brief Returns the value to store for the given \a value of the given \a column.
+
+	If \a value is a string that is already in the column's dictionary, the returned value refers
+	to the dictionary's copy. Otherwise, the string is added to the dictionary (unless the column
+	has reached maxCardinality(), in which case it falls back to plain storage) and \a value is
+	returned unchanged. Other types of values are always returned unchanged.
+*/
+QJsonValue
+JsonTreeStringDictionary::encodeValue(const QString& column, const QJsonValue& value)
+{
+	if (!value.isString() || m_maxCardinality <= 0)
+		return value;
+
+	auto& entry = m_columns[column];
+	if (entry.isPlain)
+		return value;
+
+	const QString text = value.toString();
+	auto code = entry.codes.constFind(text);
+	if (code != entry.codes.constEnd())
+		return QJsonValue(entry.texts[code.value()]);
+
+	if (entry.texts.count() >= m_maxCardinality)
+	{
+		// NOTE: The values that were already deduplicated keep sharing their data, which is harmless
+		entry.isPlain = true;
+		entry.codes.clear();
+		entry.texts.clear();
+		entry.texts.squeeze();
+		return value;
+	}
+
+	// NOTE: The first occurrence becomes the dictionary's copy, so it is not copied again
+	entry.codes.insert(text, entry.texts.count());
+	entry.texts << text;
+	return value;
+}
+
+/*!
+	\brief Deduplicates the string values of the given \a node and its descendants.
+
+	Contents that were deferred (e.g. by a memory budget) are left alone, and should be encoded
+	when they are loaded.
+*/
+void
+JsonTreeStringDictionary::encodeTree(JsonTreeModelNode* node)
+{
+	if (node == nullptr || m_maxCardinality <= 0)
+		return;
+
+	QVector<JsonTreeModelNode*> stack{node};
+	while (!stack.isEmpty())
+	{
+		auto current = stack.takeLast();
+		if (current->type() == JsonTreeModelNode::Scalar)
+		{
+			// NOTE: Scalar nodes are always elements of arrays
+			auto scalarNode = static_cast<JsonTreeModelScalarNode*>(current);
+			if (scalarNode->value().isString())
+				scalarNode->setValue( encodeValue(QString(), scalarNode->value()) );
+			continue;
+		}
+
+		if (current->type() == JsonTreeModelNode::Object)
+		{
+			static_cast<JsonTreeModelNamedListNode*>(current)->updateNamedScalars([this](const QString& name, const QJsonValue& value)
+			{
+				return encodeValue(name, value);
+			});
+		}
+
+		auto listNode = static_cast<JsonTreeModelListNode*>(current);
+		if (!listNode->isLoaded())
+			continue;
+		for (int i = 0; i < listNode->childCount(); ++i)
+			stack << listNode->childAt(i);
+	}
+}
+
+/*!
+	\brief Returns the dictionary's copy of the given string \a value of the given \a column, or
+	\a value itself if the dictionary does not have it. The dictionary is not changed.
+
+	Comparisons with the returned value can recognize equal strings by their shared data.
+*/
+QJsonValue
+JsonTreeStringDictionary::shared(const QString& column, const QJsonValue& value) const
+{
+	if (!value.isString())
+		return value;
+
+	auto entry = m_columns.constFind(column);
+	if (entry == m_columns.constEnd())
+		return value;
+
+	auto code = entry.value().codes.constFind(value.toString());
+	if (code == entry.value().codes.constEnd())
+		return value;
+	return QJsonValue(entry.value().texts[code.value()]);
+}
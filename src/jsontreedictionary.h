@@ -0,0 +1,50 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREEDICTIONARY_H
+#define JSONTREEDICTIONARY_H
+
+#include "jsontreemodel.h"
+#include <QHash>
+#include <QVector>
+
+//=================================
+// JsonTreeStringDictionary
+//=================================
+class JsonTreeStringDictionary
+{
+public:
+	explicit JsonTreeStringDictionary(int maxCardinality) : m_maxCardinality(maxCardinality) {}
+
+	int maxCardinality() const { return m_maxCardinality; }
+	void clear() { m_columns.clear(); }
+
+	int code(const QString& column, const QString& text) const;
+	QString text(const QString& column, int code) const;
+	bool isEncoded(const QString& column) const;
+
+	QJsonValue encodeValue(const QString& column, const QJsonValue& value);
+	void encodeTree(JsonTreeModelNode* node);
+	QJsonValue shared(const QString& column, const QJsonValue& value) const;
+
+private:
+	// The distinct strings of one named scalar column (or of array elements, for a null name)
+	struct Column
+	{
+		Column() : isPlain(false) {}
+
+		QHash<QString, int> codes;
+		QVector<QString> texts; // Indexed by code
+		bool isPlain;           // Set once the column had too many distinct strings
+	};
+
+	QHash<QString, Column> m_columns;
+	int m_maxCardinality;
+};
+
+#endif // JSONTREEDICTIONARY_H
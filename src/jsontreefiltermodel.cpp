@@ -0,0 +1,679 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreefiltermodel.h"
+#include <algorithm>
+
+//=================================
+// JsonTreeFilterModel itself
+//=================================
+/*!
+	\class JsonTreeFilterModel
+	\brief The JsonTreeFilterModel class shows the rows of a JsonTreeModel that match a filter,
+		   together with their ancestors.
+
+	The filter is either a predicate on a named scalar column (see setFilter()) or a text match
+	(see setFilterText()). A row is shown if it matches the filter, or if any of its descendants
+	do, so the matches can always be reached from the top-level rows.
+
+	Unlike QSortFilterProxyModel with recursive filtering, this model reads the nodes of the
+	sourceModel() directly instead of calling data(), and it keeps the result: for every array
+	and object, it stores the source rows of its visible children. Setting a filter evaluates
+	each row once. Afterwards, when a value changes, only that row and its ancestors are
+	evaluated again, and rows are inserted or removed instead of resetting the model. Rows that
+	are inserted into the sourceModel() are evaluated as they arrive.
+
+	The columns, data and flags are the same as the sourceModel()'s, and edits are passed on to
+	the sourceModel().
+
+	\note Evaluating a filter reads every row, so the rows that the sourceModel() paged out
+		  (see JsonTreeModel::setMemoryBudget()) are read back. The rows that this model shows
+		  are never paged out while the filter is set.
+
+	\sa JsonTreeModel, JsonTreeFlatModel
+*/
+
+/*!
+	\typedef JsonTreeFilterModel::Predicate
+	\brief A function that returns \c true if a value matches the filter.
+*/
+
+/*!
+	\brief Constructs an unfiltered JsonTreeFilterModel that shows \a sourceModel, with the given \a parent.
+*/
+JsonTreeFilterModel::JsonTreeFilterModel(JsonTreeModel* sourceModel, QObject* parent) :
+	QAbstractItemModel(parent),
+	m_sourceModel(sourceModel),
+	m_mode(NoFilter),
+	m_sensitivity(Qt::CaseInsensitive),
+	m_changeForwarded(false)
+{
+	Q_ASSERT(sourceModel != nullptr);
+
+	connect(sourceModel, &QAbstractItemModel::dataChanged, this, &JsonTreeFilterModel::onSourceDataChanged);
+	connect(sourceModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &JsonTreeFilterModel::onSourceRowsAboutToBeInserted);
+	connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &JsonTreeFilterModel::onSourceRowsInserted);
+	connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &JsonTreeFilterModel::onSourceRowsAboutToBeRemoved);
+	connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &JsonTreeFilterModel::onSourceRowsRemoved);
+	connect(sourceModel, &QAbstractItemModel::columnsAboutToBeInserted, this, &JsonTreeFilterModel::onSourceColumnsAboutToBeInserted);
+	connect(sourceModel, &QAbstractItemModel::columnsInserted, this, &JsonTreeFilterModel::onSourceColumnsInserted);
+	connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, &JsonTreeFilterModel::beginResetModel);
+	connect(sourceModel, &QAbstractItemModel::modelReset, this, &JsonTreeFilterModel::onSourceModelReset);
+
+	// NOTE: m_visibleRows and this model's indexes refer to the source model's nodes, so they must not be paged out
+	sourceModel->attachNodePinner(this, [this](QVector<const JsonTreeModelNode*>* nodes)
+	{
+		for (auto i = m_visibleRows.constBegin(); i != m_visibleRows.constEnd(); ++i)
+			*nodes << i.key();
+		for (const auto& index : persistentIndexList())
+			*nodes << static_cast<const JsonTreeModelNode*>(index.internalPointer());
+	});
+}
+
+/*!
+	\fn JsonTreeModel* JsonTreeFilterModel::sourceModel
+	\brief Returns the model that this model filters.
+*/
+
+/*!
+	Headers are the same as the sourceModel()'s.
+*/
+QVariant
+JsonTreeFilterModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation == Qt::Horizontal)
+		return m_sourceModel->headerData(section, orientation, role);
+	return QAbstractItemModel::headerData(section, orientation, role);
+}
+
+QModelIndex
+JsonTreeFilterModel::index(int row, int column, const QModelIndex& parent) const
+{
+	if (!hasIndex(row, column, parent))
+		return QModelIndex();
+
+	auto parentNode = parent.isValid() ? static_cast<JsonTreeModelListNode*>(parent.internalPointer()) : rootNode();
+	return createIndex(row, column, parentNode->childAt( sourceRow(parentNode, row) ));
+}
+
+QModelIndex
+JsonTreeFilterModel::parent(const QModelIndex& index) const
+{
+	if (!index.isValid())
+		return QModelIndex();
+
+	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
+	return filterIndex( static_cast<JsonTreeModelListNode*>(node->parent()) );
+}
+
+/*!
+	\brief Returns the number of visible rows under the given \a parent.
+*/
+int
+JsonTreeFilterModel::rowCount(const QModelIndex& parent) const
+{
+	if (parent.column() > 0)
+		return 0;
+
+	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : rootNode();
+	if (node == nullptr || node->type() == JsonTreeModelNode::Scalar)
+		return 0;
+
+	auto listNode = static_cast<JsonTreeModelListNode*>(node);
+	if (m_mode == NoFilter)
+		return listNode->childCount();
+	return m_visibleRows.value(listNode).count();
+}
+
+int
+JsonTreeFilterModel::columnCount(const QModelIndex& parent) const
+{
+	return m_sourceModel->columnCount(mapToSource(parent));
+}
+
+QVariant
+JsonTreeFilterModel::data(const QModelIndex& index, int role) const
+{
+	return m_sourceModel->data(mapToSource(index), role);
+}
+
+QHash<int, QByteArray>
+JsonTreeFilterModel::roleNames() const
+{
+	return m_sourceModel->roleNames();
+}
+
+bool
+JsonTreeFilterModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+	if (!index.isValid())
+		return false;
+	return m_sourceModel->setData(mapToSource(index), value, role);
+}
+
+Qt::ItemFlags
+JsonTreeFilterModel::flags(const QModelIndex& index) const
+{
+	return m_sourceModel->flags(mapToSource(index));
+}
+
+/*!
+	\brief Returns the sourceModel()'s index that corresponds to the given \a index.
+
+	\sa mapFromSource()
+*/
+QModelIndex
+JsonTreeFilterModel::mapToSource(const QModelIndex& index) const
+{
+	if (!index.isValid())
+		return QModelIndex();
+
+	const auto sourceIndex = m_sourceModel->nodeIndex( static_cast<JsonTreeModelNode*>(index.internalPointer()) );
+	return sourceIndex.sibling(sourceIndex.row(), index.column());
+}
+
+/*!
+	\brief Returns the index that corresponds to the given \a sourceIndex, or an invalid index if
+	the row is filtered out.
+
+	\sa mapToSource()
+*/
+QModelIndex
+JsonTreeFilterModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+	if (!sourceIndex.isValid())
+		return QModelIndex();
+
+	auto node = static_cast<JsonTreeModelNode*>(sourceIndex.internalPointer());
+	if (!isShown(node))
+		return QModelIndex();
+
+	const int row = filterRow( static_cast<JsonTreeModelListNode*>(node->parent()), sourceIndex.row() );
+	return createIndex(row, sourceIndex.column(), node);
+}
+
+/*!
+	\brief Shows the rows whose value in the named scalar \a column satisfies the \a predicate,
+	and their ancestors.
+
+	If \a column is a null string, the scalar elements of arrays (in the "Scalar" column) are
+	tested instead. Objects that have no member with the given name do not match.
+
+	\sa setFilterText(), clearFilter()
+*/
+void
+JsonTreeFilterModel::setFilter(const QString& column, const Predicate& predicate)
+{
+	m_mode = PredicateFilter;
+	m_column = column;
+	m_predicate = predicate;
+	m_text.clear();
+	refilter();
+}
+
+/*!
+	\brief Shows the rows that contain the given \a text, and their ancestors.
+
+	A row contains the \a text if its member name, its scalar value or the value in one of its
+	named scalar columns does, when formatted like data() formats it. An empty \a text clears the
+	filter.
+
+	\sa setFilter(), clearFilter()
+*/
+void
+JsonTreeFilterModel::setFilterText(const QString& text, Qt::CaseSensitivity sensitivity)
+{
+	m_mode = text.isEmpty() ? NoFilter : TextFilter;
+	m_text = text;
+	m_sensitivity = sensitivity;
+	m_column.clear();
+	m_predicate = Predicate();
+	refilter();
+}
+
+/*!
+	\brief Shows all rows of the sourceModel().
+
+	\sa isFiltered()
+*/
+void
+JsonTreeFilterModel::clearFilter()
+{
+	m_mode = NoFilter;
+	m_column.clear();
+	m_predicate = Predicate();
+	m_text.clear();
+	refilter();
+}
+
+/*!
+	\fn bool JsonTreeFilterModel::isFiltered
+	\brief Returns \c true if a filter is set.
+*/
+
+/*
+	Returns the source model's root node. Its children are the top-level rows.
+*/
+JsonTreeModelListNode*
+JsonTreeFilterModel::rootNode() const
+{
+	return m_sourceModel->m_rootNode;
+}
+
+/*
+	Returns the node of a parent index in the source model.
+*/
+JsonTreeModelListNode*
+JsonTreeFilterModel::sourceNode(const QModelIndex& sourceIndex) const
+{
+	if (!sourceIndex.isValid())
+		return rootNode();
+	return static_cast<JsonTreeModelListNode*>(sourceIndex.internalPointer());
+}
+
+/*
+	Returns true if the node itself matches the filter, regardless of its descendants.
+*/
+bool
+JsonTreeFilterModel::matches(const JsonTreeModelNode* node) const
+{
+	if (m_mode == PredicateFilter)
+	{
+		if (m_column.isNull())
+			return node->type() == JsonTreeModelNode::Scalar && m_predicate( static_cast<const JsonTreeModelScalarNode*>(node)->value() );
+		if (node->type() != JsonTreeModelNode::Object)
+			return false;
+
+		// NOTE: namedScalarValue() returns null for missing members too, but only nulls need the slower lookup
+		auto object = static_cast<const JsonTreeModelNamedListNode*>(node);
+		const QJsonValue value = object->namedScalarValue(m_column);
+		if (value.isNull() && !object->namedScalars().contains(m_column))
+			return false;
+		return m_predicate(value);
+	}
+
+	auto parentNode = node->parent();
+	if ( parentNode->type() == JsonTreeModelNode::Object
+			&& static_cast<JsonTreeModelNamedListNode*>(parentNode)->childListNodeName(const_cast<JsonTreeModelNode*>(node)).contains(m_text, m_sensitivity) )
+		return true;
+
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return containsText( static_cast<const JsonTreeModelScalarNode*>(node)->value() );
+
+	if (node->type() == JsonTreeModelNode::Object)
+	{
+		auto object = static_cast<const JsonTreeModelNamedListNode*>(node);
+		const QStringList columns = m_sourceModel->columnsFor(parentNode);
+		for (int i = 2; i < columns.count(); ++i)
+		{
+			if ( containsText(object->namedScalarValue(columns[i])) )
+				return true;
+		}
+	}
+	return false;
+}
+
+bool
+JsonTreeFilterModel::containsText(const QJsonValue& value) const
+{
+	return JsonTreeModelNode::Traits::toVariant(value).toString().contains(m_text, m_sensitivity);
+}
+
+/*
+	Evaluates the filter for every row again.
+*/
+void
+JsonTreeFilterModel::refilter()
+{
+	beginResetModel();
+	m_visibleRows.clear();
+	if (m_mode != NoFilter && rootNode() != nullptr)
+		build(rootNode());
+	endResetModel();
+}
+
+/*
+	Finds the visible children of the given node and its descendants. Returns true if the node is
+	visible.
+*/
+bool
+JsonTreeFilterModel::build(JsonTreeModelNode* node)
+{
+	bool visible = (node != rootNode()) && matches(node);
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return visible;
+
+	auto listNode = static_cast<JsonTreeModelListNode*>(node);
+	QVector<int> rows;
+	for (int i = 0; i < listNode->childCount(); ++i)
+	{
+		if (build(listNode->childAt(i)))
+			rows << i;
+	}
+	if (rows.isEmpty())
+		return visible;
+
+	// NOTE: Don't hold references into m_visibleRows across the recursive calls above; inserting can rehash
+	m_visibleRows.insert(listNode, rows);
+	return true;
+}
+
+/*
+	Appends the given node and its descendants that have visible children to nodes.
+*/
+void
+JsonTreeFilterModel::collectVisibleRows(const JsonTreeModelNode* node, QVector<const JsonTreeModelListNode*>* nodes) const
+{
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return;
+
+	// ASSUMPTION: Only a node with visible children can have descendants with visible children
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	auto rows = m_visibleRows.constFind(listNode);
+	if (rows == m_visibleRows.constEnd())
+		return;
+
+	*nodes << listNode;
+	for (int row : rows.value())
+		collectVisibleRows(listNode->childAt(row), nodes);
+}
+
+/*
+	Evaluates the filter for the given node again, and then for its ancestors until one of them
+	keeps its visibility. Rows are inserted or removed where the visibility changed.
+*/
+void
+JsonTreeFilterModel::revalidate(JsonTreeModelNode* node)
+{
+	auto root = rootNode();
+	while (node != root)
+	{
+		auto parentNode = static_cast<JsonTreeModelListNode*>(node->parent());
+		const int row = parentNode->childPosition(node);
+		const bool visible = matches(node)
+				|| ( node->type() != JsonTreeModelNode::Scalar && m_visibleRows.contains(static_cast<JsonTreeModelListNode*>(node)) );
+
+		int visibleRow = 0;
+		bool wasVisible = false;
+		auto rows = m_visibleRows.constFind(parentNode);
+		if (rows != m_visibleRows.constEnd())
+		{
+			const auto position = std::lower_bound(rows.value().constBegin(), rows.value().constEnd(), row);
+			visibleRow = position - rows.value().constBegin();
+			wasVisible = (position != rows.value().constEnd() && *position == row);
+		}
+		if (visible == wasVisible)
+			return;
+
+		// NOTE: The rows under a hidden parent change silently; the parent itself is inserted or removed next
+		const bool isParentShown = isShown(parentNode);
+		if (visible)
+		{
+			if (isParentShown)
+				beginInsertRows(filterIndex(parentNode), visibleRow, visibleRow);
+			m_visibleRows[parentNode].insert(visibleRow, row);
+			if (isParentShown)
+				endInsertRows();
+		}
+		else
+		{
+			if (isParentShown)
+				beginRemoveRows(filterIndex(parentNode), visibleRow, visibleRow);
+			auto changedRows = m_visibleRows.find(parentNode);
+			changedRows.value().remove(visibleRow);
+			if (changedRows.value().isEmpty())
+				m_visibleRows.erase(changedRows);
+			if (isParentShown)
+				endRemoveRows();
+		}
+		node = parentNode;
+	}
+}
+
+/*
+	Returns true if the node and all of its ancestors are visible.
+*/
+bool
+JsonTreeFilterModel::isShown(const JsonTreeModelNode* node) const
+{
+	if (m_mode == NoFilter)
+		return true;
+
+	auto root = rootNode();
+	for (; node != root; node = node->parent())
+	{
+		auto parentNode = static_cast<const JsonTreeModelListNode*>(node->parent());
+		if (filterRow( parentNode, parentNode->childPosition(const_cast<JsonTreeModelNode*>(node)) ) < 0)
+			return false;
+	}
+	return true;
+}
+
+/*
+	Returns the row of this model that shows the given child of a node, or -1 if the child is
+	hidden.
+*/
+int
+JsonTreeFilterModel::filterRow(const JsonTreeModelListNode* parentNode, int sourceRow) const
+{
+	if (m_mode == NoFilter)
+		return sourceRow;
+
+	auto rows = m_visibleRows.constFind(parentNode);
+	if (rows == m_visibleRows.constEnd())
+		return -1;
+
+	const auto position = std::lower_bound(rows.value().constBegin(), rows.value().constEnd(), sourceRow);
+	if (position == rows.value().constEnd() || *position != sourceRow)
+		return -1;
+	return position - rows.value().constBegin();
+}
+
+/*
+	Returns the source row of the given row of this model.
+*/
+int
+JsonTreeFilterModel::sourceRow(const JsonTreeModelListNode* parentNode, int filterRow) const
+{
+	if (m_mode == NoFilter)
+		return filterRow;
+	return m_visibleRows.value(parentNode).value(filterRow, -1);
+}
+
+/*
+	Returns the index of a shown node in column 0, or an invalid index for the root node.
+*/
+QModelIndex
+JsonTreeFilterModel::filterIndex(const JsonTreeModelListNode* node) const
+{
+	if (node == rootNode())
+		return QModelIndex();
+
+	auto parentNode = static_cast<const JsonTreeModelListNode*>(node->parent());
+	const int row = filterRow( parentNode, parentNode->childPosition(const_cast<JsonTreeModelListNode*>(node)) );
+	return createIndex(row, 0, const_cast<JsonTreeModelListNode*>(node));
+}
+
+void
+JsonTreeFilterModel::onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles)
+{
+	if (!topLeft.isValid())
+		return;
+
+	auto parentNode = sourceNode(topLeft.parent());
+	if (m_mode != NoFilter)
+	{
+		for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+			revalidate(parentNode->childAt(row));
+	}
+	if (!isShown(parentNode))
+		return;
+
+	// NOTE: The rows that are still visible within the range are contiguous in this model
+	int first = topLeft.row();
+	int last = bottomRight.row();
+	if (m_mode != NoFilter)
+	{
+		const QVector<int> rows = m_visibleRows.value(parentNode);
+		first = std::lower_bound(rows.constBegin(), rows.constEnd(), first) - rows.constBegin();
+		last = std::upper_bound(rows.constBegin(), rows.constEnd(), last) - rows.constBegin() - 1;
+		if (first > last)
+			return;
+	}
+
+	const auto parent = filterIndex(parentNode);
+	emit dataChanged( index(first, topLeft.column(), parent), index(last, bottomRight.column(), parent), roles );
+}
+
+void
+JsonTreeFilterModel::onSourceRowsAboutToBeInserted(const QModelIndex& parent, int first, int last)
+{
+	// NOTE: Without a filter, the rows are counted by the source model, so the insertion must be announced beforehand
+	m_changeForwarded = (m_mode == NoFilter);
+	if (m_changeForwarded)
+		beginInsertRows(mapFromSource(parent), first, last);
+}
+
+void
+JsonTreeFilterModel::onSourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+	if (m_changeForwarded)
+	{
+		m_changeForwarded = false;
+		endInsertRows();
+		return;
+	}
+	if (m_mode == NoFilter)
+		return;
+
+	auto parentNode = sourceNode(parent);
+	const int count = last - first + 1;
+	int position = 0;
+	auto rows = m_visibleRows.find(parentNode);
+	if (rows != m_visibleRows.end())
+	{
+		position = std::lower_bound(rows.value().begin(), rows.value().end(), first) - rows.value().begin();
+		for (int i = position; i < rows.value().count(); ++i)
+			rows.value()[i] += count;
+	}
+
+	// NOTE: Don't hold iterators into m_visibleRows across build(); inserting can rehash
+	QVector<int> added;
+	for (int i = first; i <= last; ++i)
+	{
+		if (build(parentNode->childAt(i)))
+			added << i;
+	}
+
+	if (!added.isEmpty())
+	{
+		const bool isParentShown = isShown(parentNode);
+		if (isParentShown)
+			beginInsertRows(filterIndex(parentNode), position, position + added.count() - 1);
+		auto& changedRows = m_visibleRows[parentNode];
+		changedRows.insert(position, added.count(), 0);
+		std::copy(added.constBegin(), added.constEnd(), changedRows.begin() + position);
+		if (isParentShown)
+			endInsertRows();
+	}
+
+	// The parent may have gained its first visible child
+	revalidate(parentNode);
+}
+
+void
+JsonTreeFilterModel::onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+	m_changeForwarded = false;
+	if (m_mode == NoFilter)
+	{
+		m_changeForwarded = true;
+		beginRemoveRows(mapFromSource(parent), first, last);
+		return;
+	}
+
+	// NOTE: The visible rows are only updated in onSourceRowsRemoved(), once the source rows are gone
+	auto parentNode = sourceNode(parent);
+	auto rows = m_visibleRows.constFind(parentNode);
+	if (rows == m_visibleRows.constEnd())
+		return;
+
+	const int begin = std::lower_bound(rows.value().constBegin(), rows.value().constEnd(), first) - rows.value().constBegin();
+	const int end = std::upper_bound(rows.value().constBegin(), rows.value().constEnd(), last) - rows.value().constBegin();
+	m_changeForwarded = (begin < end) && isShown(parentNode);
+	if (m_changeForwarded)
+		beginRemoveRows(filterIndex(parentNode), begin, end - 1);
+
+	// NOTE: The removed nodes are deleted before onSourceRowsRemoved(), so their entries are found now and dropped then
+	for (int i = first; i <= last; ++i)
+		collectVisibleRows(parentNode->childAt(i), &m_removedNodes);
+}
+
+void
+JsonTreeFilterModel::onSourceRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+	const bool changeForwarded = m_changeForwarded;
+	m_changeForwarded = false;
+	if (m_mode == NoFilter)
+	{
+		if (changeForwarded)
+			endRemoveRows();
+		return;
+	}
+
+	for (auto node : qAsConst(m_removedNodes))
+		m_visibleRows.remove(node);
+	m_removedNodes.clear();
+
+	auto parentNode = sourceNode(parent);
+	const int count = last - first + 1;
+	auto rows = m_visibleRows.find(parentNode);
+	if (rows != m_visibleRows.end())
+	{
+		auto& changedRows = rows.value();
+		const int begin = std::lower_bound(changedRows.constBegin(), changedRows.constEnd(), first) - changedRows.constBegin();
+		const int end = std::upper_bound(changedRows.constBegin(), changedRows.constEnd(), last) - changedRows.constBegin();
+		changedRows.remove(begin, end - begin);
+		for (int i = begin; i < changedRows.count(); ++i)
+			changedRows[i] -= count;
+		if (changedRows.isEmpty())
+			m_visibleRows.erase(rows);
+	}
+	if (changeForwarded)
+		endRemoveRows();
+
+	// The parent may have lost its last visible child
+	revalidate(parentNode);
+}
+
+void
+JsonTreeFilterModel::onSourceColumnsAboutToBeInserted(const QModelIndex& parent, int first, int last)
+{
+	m_changeForwarded = !parent.isValid() || isShown(sourceNode(parent));
+	if (m_changeForwarded)
+		beginInsertColumns(mapFromSource(parent), first, last);
+}
+
+void
+JsonTreeFilterModel::onSourceColumnsInserted()
+{
+	if (m_changeForwarded)
+		endInsertColumns();
+	m_changeForwarded = false;
+}
+
+void
+JsonTreeFilterModel::onSourceModelReset()
+{
+	m_visibleRows.clear();
+	m_removedNodes.clear();
+	m_changeForwarded = false;
+	if (m_mode != NoFilter && rootNode() != nullptr)
+		build(rootNode());
+	endResetModel();
+}
@@ -0,0 +1,104 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREEFILTERMODEL_H
+#define JSONTREEFILTERMODEL_H
+
+#include "jsontreemodel.h"
+#include <QAbstractItemModel>
+#include <QHash>
+#include <functional>
+
+//=================================
+// JsonTreeFilterModel itself
+//=================================
+class JsonTreeFilterModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<bool(const QJsonValue& value)> Predicate;
+
+	explicit JsonTreeFilterModel(JsonTreeModel* sourceModel, QObject* parent = nullptr);
+
+	JsonTreeModel* sourceModel() const { return m_sourceModel; }
+
+	// Header:
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	// Basic functionality:
+	QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+	QModelIndex parent(const QModelIndex& index) const override;
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	// Editable:
+	bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+	Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+	// API specific to JsonTreeFilterModel:
+	QModelIndex mapToSource(const QModelIndex& index) const;
+	QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
+
+	void setFilter(const QString& column, const Predicate& predicate);
+	void setFilterText(const QString& text, Qt::CaseSensitivity sensitivity = Qt::CaseInsensitive);
+	void clearFilter();
+	bool isFiltered() const { return m_mode != NoFilter; }
+
+private:
+	enum FilterMode { NoFilter, PredicateFilter, TextFilter };
+
+	JsonTreeModelListNode* rootNode() const;
+	JsonTreeModelListNode* sourceNode(const QModelIndex& sourceIndex) const;
+
+	bool matches(const JsonTreeModelNode* node) const;
+	bool containsText(const QJsonValue& value) const;
+
+	void refilter();
+	bool build(JsonTreeModelNode* node);
+	void collectVisibleRows(const JsonTreeModelNode* node, QVector<const JsonTreeModelListNode*>* nodes) const;
+	void revalidate(JsonTreeModelNode* node);
+
+	bool isShown(const JsonTreeModelNode* node) const;
+	int filterRow(const JsonTreeModelListNode* parentNode, int sourceRow) const;
+	int sourceRow(const JsonTreeModelListNode* parentNode, int filterRow) const;
+	QModelIndex filterIndex(const JsonTreeModelListNode* node) const;
+
+	void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
+	void onSourceRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+	void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+	void onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+	void onSourceRowsRemoved(const QModelIndex& parent, int first, int last);
+	void onSourceColumnsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+	void onSourceColumnsInserted();
+	void onSourceModelReset();
+
+	JsonTreeModel* m_sourceModel;
+
+	FilterMode m_mode;
+	QString m_column;
+	Predicate m_predicate;
+	QString m_text;
+	Qt::CaseSensitivity m_sensitivity;
+
+	// NOTE: The sorted source rows of the visible children of each array or object, including hidden ones. A row is
+	// visible if it matches the filter or has visible children, so nodes without visible children have no entry.
+	QHash<const JsonTreeModelListNode*, QVector<int>> m_visibleRows;
+
+	// The nodes with visible children that are being removed from the source model
+	QVector<const JsonTreeModelListNode*> m_removedNodes;
+
+	// Between the "about to be" signals and the signals that complete them
+	bool m_changeForwarded;
+};
+
+#endif // JSONTREEFILTERMODEL_H
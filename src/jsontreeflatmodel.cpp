@@ -0,0 +1,647 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreeflatmodel.h"
+
+//=================================
+// JsonTreeFlatModel itself
+//=================================
+/*!
+	\class JsonTreeFlatModel
+	\brief The JsonTreeFlatModel class presents the expanded rows of a JsonTreeModel as a flat table.
+
+	Views that cannot show trees (such as QML's ListView and TableView) can use this model to
+	show a tree anyway: each visible row of the JsonTreeModel becomes one row of this model, in
+	the order that a tree view would show them. Use setExpanded() (or setData() with
+	\c ExpandedRole) to expand and collapse rows, and \c DepthRole to indent them.
+
+	The columns are the same as the columns of the sourceModel(). In branch column mode, they are
+	the sourceModel()'s scalarColumns(), and each row shows its own columns with the same names
+	(see JsonTreeModel::setBranchColumns()). Edits are passed on to the
+	sourceModel(), and changes to the sourceModel() (such as edits and patches) are reflected
+	in this model.
+
+	Expanding or collapsing a row, and mapping between rows and nodes, take O(d log n) time, where
+	d is the depth of the row and n is the number of rows at each level: every expanded node keeps
+	a Fenwick tree of the number of visible rows under each of its children. The tree is built
+	when the node is expanded, and dropped when it is collapsed.
+
+	\note The expansion state is stored in the source model's nodes
+		  (see DataTreeModelListNode::isExpanded()), so it persists when a row is collapsed
+		  and expanded again. Only one JsonTreeFlatModel should be attached to a JsonTreeModel.
+
+	\sa JsonTreeModel
+*/
+
+/*!
+	\enum JsonTreeFlatModel::Roles
+	\brief This enum describes the extra roles that JsonTreeFlatModel provides for column 0.
+
+	\value DepthRole The number of ancestors of the row, starting at 0 for top-level rows.
+	\value ExpandedRole \c true if the children of the row are shown. Writable.
+	\value HasChildrenRole \c true if the row is an array or object with at least one child.
+*/
+
+/*!
+	\brief Constructs a JsonTreeFlatModel that flattens \a sourceModel, with the given \a parent.
+*/
+JsonTreeFlatModel::JsonTreeFlatModel(JsonTreeModel* sourceModel, QObject* parent) :
+	QAbstractTableModel(parent),
+	m_sourceModel(sourceModel),
+	m_removalParent(nullptr),
+	m_removalOldTotal(0),
+	m_removalVisible(false)
+{
+	Q_ASSERT(sourceModel != nullptr);
+
+	connect(sourceModel, &QAbstractItemModel::dataChanged, this, &JsonTreeFlatModel::onSourceDataChanged);
+	connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &JsonTreeFlatModel::onSourceRowsInserted);
+	connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &JsonTreeFlatModel::onSourceRowsAboutToBeRemoved);
+	connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &JsonTreeFlatModel::onSourceRowsRemoved);
+	connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, &JsonTreeFlatModel::beginResetModel);
+	connect(sourceModel, &QAbstractItemModel::modelReset, this, &JsonTreeFlatModel::onSourceModelReset);
+
+	if (rootNode() != nullptr)
+		ensureRowTree(rootNode());
+}
+
+/*!
+	\fn JsonTreeModel* JsonTreeFlatModel::sourceModel
+	\brief Returns the model that this model flattens.
+*/
+
+/*!
+	Horizontal headers are the same as the sourceModel()'s. Vertical headers show the flat row numbers.
+*/
+QVariant
+JsonTreeFlatModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation == Qt::Horizontal)
+	{
+		// NOTE: The sourceModel()'s headers belong to its top-level rows in branch column mode
+		if (m_sourceModel->branchColumns() && role == Qt::DisplayRole)
+			return m_sourceModel->m_headers.value(section);
+		return m_sourceModel->headerData(section, orientation, role);
+	}
+	return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+/*!
+	\brief Returns the number of visible rows.
+*/
+int
+JsonTreeFlatModel::rowCount(const QModelIndex& parent) const
+{
+	auto root = rootNode();
+	if (parent.isValid() || root == nullptr)
+		return 0;
+	return m_rowTrees.value(root).total();
+}
+
+/*!
+	\brief Returns the number of columns of the sourceModel(), not counting branch columns.
+*/
+int
+JsonTreeFlatModel::columnCount(const QModelIndex& parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return m_sourceModel->m_headers.count();
+}
+
+/*!
+	\brief Returns the data under the given \a index for the specified \a role.
+
+	The Roles enum is handled by this model; all other roles are passed on to the sourceModel().
+*/
+QVariant
+JsonTreeFlatModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid())
+		return QVariant();
+
+	auto node = nodeAt(index.row());
+	if (node == nullptr)
+		return QVariant();
+
+	switch (role)
+	{
+	case DepthRole:
+		{
+			int depth = 0;
+			for (auto parentNode = node->parent(); parentNode != rootNode(); parentNode = parentNode->parent())
+				++depth;
+			return depth;
+		}
+
+	case ExpandedRole:
+		return node->type() != JsonTreeModelNode::Scalar && static_cast<JsonTreeModelListNode*>(node)->isExpanded();
+
+	case HasChildrenRole:
+		return node->type() != JsonTreeModelNode::Scalar && static_cast<JsonTreeModelListNode*>(node)->childCount() > 0;
+
+	default:
+		return m_sourceModel->data(mapToSource(index), role);
+	}
+}
+
+/*!
+	\brief Returns the sourceModel()'s role names, as well as \c "depth", \c "expanded" and \c "hasChildren".
+*/
+QHash<int, QByteArray>
+JsonTreeFlatModel::roleNames() const
+{
+	auto names = m_sourceModel->roleNames();
+	names.insert(DepthRole, "depth");
+	names.insert(ExpandedRole, "expanded");
+	names.insert(HasChildrenRole, "hasChildren");
+	return names;
+}
+
+/*!
+	\brief Expands or collapses the row if \a role is \c ExpandedRole; otherwise, passes the \a value
+	on to the sourceModel().
+*/
+bool
+JsonTreeFlatModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+	if (!index.isValid())
+		return false;
+
+	if (role == ExpandedRole)
+	{
+		if (isExpanded(index.row()) == value.toBool())
+			return false;
+		setExpanded(index.row(), value.toBool());
+		return isExpanded(index.row()) == value.toBool();
+	}
+	return m_sourceModel->setData(mapToSource(index), value, role);
+}
+
+Qt::ItemFlags
+JsonTreeFlatModel::flags(const QModelIndex& index) const
+{
+	return m_sourceModel->flags(mapToSource(index));
+}
+
+/*!
+	\brief Returns the sourceModel()'s index that corresponds to the given flat \a index.
+
+	\sa mapFromSource()
+*/
+QModelIndex
+JsonTreeFlatModel::mapToSource(const QModelIndex& index) const
+{
+	if (!index.isValid())
+		return QModelIndex();
+
+	auto node = nodeAt(index.row());
+	if (node == nullptr)
+		return QModelIndex();
+
+	const int column = m_sourceModel->branchColumn(node, index.column());
+	if (column < 0)
+		return QModelIndex();
+
+	const auto sourceIndex = m_sourceModel->nodeIndex(node);
+	return sourceIndex.sibling(sourceIndex.row(), column);
+}
+
+/*!
+	\brief Returns the flat index that corresponds to the given \a sourceIndex, or an invalid
+	index if the row is hidden because one of its ancestors is collapsed.
+
+	\sa mapToSource()
+*/
+QModelIndex
+JsonTreeFlatModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+	if (!sourceIndex.isValid())
+		return QModelIndex();
+
+	auto node = static_cast<JsonTreeModelNode*>(sourceIndex.internalPointer());
+	const int column = m_sourceModel->modelColumn(node, sourceIndex.column());
+	if (!isVisible(node) || column < 0)
+		return QModelIndex();
+	return index(flatRow(node), column);
+}
+
+/*!
+	\brief Returns \c true if the children of the given \a row are shown.
+
+	\sa setExpanded()
+*/
+bool
+JsonTreeFlatModel::isExpanded(int row) const
+{
+	auto node = nodeAt(row);
+	return node != nullptr
+			&& node->type() != JsonTreeModelNode::Scalar
+			&& static_cast<JsonTreeModelListNode*>(node)->isExpanded();
+}
+
+/*!
+	\brief Shows or hides the children of the given \a row.
+
+	The children's own expansion states are kept, so expanding a row also shows the descendants
+	that were expanded before. Scalar rows cannot be expanded.
+
+	\sa isExpanded(), expand(), collapse()
+*/
+void
+JsonTreeFlatModel::setExpanded(int row, bool expanded)
+{
+	auto node = nodeAt(row);
+	if (node == nullptr || node->type() == JsonTreeModelNode::Scalar)
+		return;
+
+	auto listNode = static_cast<JsonTreeModelListNode*>(node);
+	if (listNode->isExpanded() == expanded)
+		return;
+
+	if (expanded)
+	{
+		const int total = ensureRowTree(listNode);
+		if (total > 0)
+			beginInsertRows(QModelIndex(), row + 1, row + total);
+		listNode->setExpanded(true);
+		propagate(listNode, total);
+		if (total > 0)
+			endInsertRows();
+	}
+	else
+	{
+		const int total = m_rowTrees.value(listNode).total();
+		if (total > 0)
+			beginRemoveRows(QModelIndex(), row + 1, row + total);
+		propagate(listNode, -total); // NOTE: Only propagates while the node is still expanded
+		listNode->setExpanded(false);
+
+		// NOTE: Only the rows under the root and expanded nodes have row trees, so that the source
+		// model can evict the rows under collapsed nodes
+		dropRowTrees(listNode);
+		if (total > 0)
+			endRemoveRows();
+	}
+
+	const auto changed = index(row, 0);
+	emit dataChanged(changed, changed, QVector<int>{ExpandedRole});
+}
+
+/*
+	Returns the source model's root node. Its children are the top-level rows, and it is always expanded.
+*/
+JsonTreeModelListNode*
+JsonTreeFlatModel::rootNode() const
+{
+	return m_sourceModel->m_rootNode;
+}
+
+/*
+	Builds the row tree of the given node (and of its expanded descendants) if it does not exist
+	yet. Returns the number of rows under the node when it is expanded.
+*/
+int
+JsonTreeFlatModel::ensureRowTree(JsonTreeModelListNode* node)
+{
+	auto existing = m_rowTrees.constFind(node);
+	if (existing != m_rowTrees.constEnd())
+		return existing.value().total();
+
+	QVector<int> weights(node->childCount());
+	for (int i = 0; i < weights.count(); ++i)
+	{
+		auto child = node->childAt(i);
+		weights[i] = 1;
+		if ( child->type() != JsonTreeModelNode::Scalar && static_cast<JsonTreeModelListNode*>(child)->isExpanded() )
+			weights[i] += ensureRowTree(static_cast<JsonTreeModelListNode*>(child));
+	}
+
+	// NOTE: Don't hold references into m_rowTrees across the recursive calls above; inserting can rehash
+	RowTree tree;
+	tree.build(weights);
+	m_rowTrees.insert(node, tree);
+	return tree.total();
+}
+
+/*
+	Drops the row trees of the given node and its descendants, which are about to be deleted.
+*/
+void
+JsonTreeFlatModel::dropRowTrees(JsonTreeModelNode* node)
+{
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return;
+
+	// ASSUMPTION: Only a node with a row tree can have descendants with row trees
+	auto listNode = static_cast<JsonTreeModelListNode*>(node);
+	if (!m_rowTrees.contains(listNode))
+		return;
+
+	for (int i = 0; i < listNode->childCount(); ++i)
+		dropRowTrees(listNode->childAt(i));
+	m_rowTrees.remove(listNode);
+}
+
+/*
+	Adds delta to the row counts of the expanded ancestors of the given node, after the number of
+	rows under the node changed.
+*/
+void
+JsonTreeFlatModel::propagate(JsonTreeModelListNode* node, int delta)
+{
+	auto root = rootNode();
+	while (node != root && node->isExpanded() && delta != 0)
+	{
+		auto parentNode = static_cast<JsonTreeModelListNode*>(node->parent());
+		auto tree = m_rowTrees.find(parentNode);
+		if (tree == m_rowTrees.end())
+			return;
+
+		tree.value().add(parentNode->childPosition(node), delta);
+		node = parentNode;
+	}
+}
+
+/*
+	Returns true if all of the node's ancestors are expanded.
+*/
+bool
+JsonTreeFlatModel::isVisible(const JsonTreeModelNode* node) const
+{
+	auto root = rootNode();
+	for (auto parentNode = node->parent(); parentNode != root; parentNode = parentNode->parent())
+	{
+		if (parentNode == nullptr || !static_cast<const JsonTreeModelListNode*>(parentNode)->isExpanded())
+			return false;
+	}
+	return true;
+}
+
+/*
+	Returns true if the children of the given node are visible rows.
+*/
+bool
+JsonTreeFlatModel::showsChildren(const JsonTreeModelListNode* node) const
+{
+	return node == rootNode() || (node->isExpanded() && isVisible(node));
+}
+
+/*
+	Returns the flat row of a visible node.
+*/
+int
+JsonTreeFlatModel::flatRow(const JsonTreeModelNode* node) const
+{
+	auto root = rootNode();
+	int row = -1;
+	while (node != root)
+	{
+		auto parentNode = static_cast<const JsonTreeModelListNode*>(node->parent());
+		row += 1 + m_rowTrees[parentNode].prefix( parentNode->childPosition(const_cast<JsonTreeModelNode*>(node)) );
+		node = parentNode;
+	}
+	return row;
+}
+
+/*
+	Returns the flat row of the first child of a node whose children are visible.
+*/
+int
+JsonTreeFlatModel::firstChildRow(const JsonTreeModelListNode* node) const
+{
+	return (node == rootNode()) ? 0 : flatRow(node) + 1;
+}
+
+/*
+	Returns the node shown in the given flat row, or nullptr if the row does not exist.
+*/
+JsonTreeModelNode*
+JsonTreeFlatModel::nodeAt(int row) const
+{
+	JsonTreeModelListNode* node = rootNode();
+	if (node == nullptr || row < 0 || row >= rowCount())
+		return nullptr;
+
+	while (true)
+	{
+		int offset = row;
+		auto child = node->childAt( m_rowTrees[node].find(&offset) );
+		if (offset == 0)
+			return child;
+
+		// The row is one of the child's descendants
+		Q_ASSERT(child->type() != JsonTreeModelNode::Scalar);
+		node = static_cast<JsonTreeModelListNode*>(child);
+		row = offset - 1;
+	}
+}
+
+/*
+	Returns the node of a parent index in the source model.
+*/
+JsonTreeModelListNode*
+JsonTreeFlatModel::sourceNode(const QModelIndex& sourceIndex) const
+{
+	if (!sourceIndex.isValid())
+		return rootNode();
+	return static_cast<JsonTreeModelListNode*>(sourceIndex.internalPointer());
+}
+
+void
+JsonTreeFlatModel::onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles)
+{
+	if (!topLeft.isValid())
+		return;
+
+	auto parentNode = sourceNode(topLeft.parent());
+	if (!showsChildren(parentNode))
+		return;
+
+	// NOTE: Branch columns are ordered differently, so only single columns are mapped exactly
+	int firstColumn = topLeft.column();
+	int lastColumn = bottomRight.column();
+	if (m_sourceModel->branchColumns())
+	{
+		auto node = static_cast<JsonTreeModelNode*>(topLeft.internalPointer());
+		if (firstColumn == lastColumn)
+			firstColumn = lastColumn = m_sourceModel->modelColumn(node, firstColumn);
+		else
+		{
+			firstColumn = 0;
+			lastColumn = columnCount() - 1;
+		}
+		if (firstColumn < 0)
+			return;
+	}
+
+	// NOTE: The range also covers the descendants of any expanded rows in between, which is harmless
+	const auto& tree = m_rowTrees[parentNode];
+	const int firstRow = firstChildRow(parentNode);
+	emit dataChanged( index(firstRow + tree.prefix(topLeft.row()), firstColumn),
+			index(firstRow + tree.prefix(bottomRight.row()), lastColumn),
+			roles );
+}
+
+void
+JsonTreeFlatModel::onSourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+	Q_UNUSED(last);
+
+	auto parentNode = sourceNode(parent);
+	if (!m_rowTrees.contains(parentNode))
+	{
+		// The parent was never expanded, but it may have gained its first child
+		if (parentNode != rootNode() && isVisible(parentNode))
+		{
+			const auto changed = index(flatRow(parentNode), 0);
+			emit dataChanged(changed, changed, QVector<int>{HasChildrenRole});
+		}
+		return;
+	}
+
+	const bool isShown = showsChildren(parentNode);
+	const int oldTotal = m_rowTrees[parentNode].total();
+	const int start = isShown ? firstChildRow(parentNode) + m_rowTrees[parentNode].prefix(first) : 0;
+
+	// NOTE: Rebuilding costs O(children), like inserting into the node itself
+	m_rowTrees.remove(parentNode);
+	const int delta = ensureRowTree(parentNode) - oldTotal;
+
+	if (isShown && delta > 0)
+		beginInsertRows(QModelIndex(), start, start + delta - 1);
+	propagate(parentNode, delta);
+	if (isShown && delta > 0)
+		endInsertRows();
+}
+
+void
+JsonTreeFlatModel::onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+	auto parentNode = sourceNode(parent);
+	if (!m_rowTrees.contains(parentNode))
+	{
+		m_removalParent = nullptr;
+		return;
+	}
+
+	const auto& tree = m_rowTrees[parentNode];
+	m_removalParent = parentNode;
+	m_removalOldTotal = tree.total();
+	m_removalVisible = showsChildren(parentNode);
+
+	const int removedRows = tree.prefix(last + 1) - tree.prefix(first);
+	if (m_removalVisible)
+	{
+		const int start = firstChildRow(parentNode) + tree.prefix(first);
+		beginRemoveRows(QModelIndex(), start, start + removedRows - 1);
+	}
+
+	for (int i = first; i <= last; ++i)
+		dropRowTrees(parentNode->childAt(i));
+}
+
+void
+JsonTreeFlatModel::onSourceRowsRemoved()
+{
+	if (m_removalParent == nullptr)
+		return;
+
+	auto parentNode = m_removalParent;
+	m_removalParent = nullptr;
+
+	m_rowTrees.remove(parentNode);
+	propagate(parentNode, ensureRowTree(parentNode) - m_removalOldTotal);
+	if (m_removalVisible)
+		endRemoveRows();
+}
+
+void
+JsonTreeFlatModel::onSourceModelReset()
+{
+	m_rowTrees.clear();
+	m_removalParent = nullptr;
+	if (rootNode() != nullptr)
+		ensureRowTree(rootNode());
+	endResetModel();
+}
+
+
+//=================================
+// JsonTreeFlatModel::RowTree
+//=================================
+/*
+	Replaces the contents of the tree with the given weights, in O(n) time.
+*/
+void
+JsonTreeFlatModel::RowTree::build(const QVector<int>& weights)
+{
+	const int n = weights.count();
+	m_tree.fill(0, n + 1);
+	m_total = 0;
+	for (int i = 1; i <= n; ++i)
+	{
+		m_tree[i] += weights[i - 1];
+		m_total += weights[i - 1];
+
+		const int parent = i + (i & -i);
+		if (parent <= n)
+			m_tree[parent] += m_tree[i];
+	}
+}
+
+/*
+	Adds delta to the weight at the given (0-based) position.
+*/
+void
+JsonTreeFlatModel::RowTree::add(int position, int delta)
+{
+	m_total += delta;
+	for (int i = position + 1; i < m_tree.count(); i += (i & -i))
+		m_tree[i] += delta;
+}
+
+/*
+	Returns the sum of the first count weights.
+*/
+int
+JsonTreeFlatModel::RowTree::prefix(int count) const
+{
+	int sum = 0;
+	for (int i = count; i > 0; i -= (i & -i))
+		sum += m_tree[i];
+	return sum;
+}
+
+/*
+	Returns the position whose range of rows contains *offset, and changes *offset to the offset
+	within that range.
+
+	ASSUMPTION: 0 <= *offset < total()
+*/
+int
+JsonTreeFlatModel::RowTree::find(int* offset) const
+{
+	const int n = m_tree.count() - 1;
+	int step = 1;
+	while (step * 2 <= n)
+		step *= 2;
+
+	int position = 0;
+	int remaining = *offset;
+	for (; step > 0; step /= 2)
+	{
+		if (position + step <= n && m_tree[position + step] <= remaining)
+		{
+			position += step;
+			remaining -= m_tree[position];
+		}
+	}
+	*offset = remaining;
+	return position;
+}
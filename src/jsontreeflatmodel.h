@@ -0,0 +1,103 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREEFLATMODEL_H
+#define JSONTREEFLATMODEL_H
+
+#include "jsontreemodel.h"
+#include <QAbstractTableModel>
+#include <QHash>
+
+//=================================
+// JsonTreeFlatModel itself
+//=================================
+class JsonTreeFlatModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+public:
+	enum Roles
+	{
+		DepthRole = Qt::UserRole + 1,
+		ExpandedRole,
+		HasChildrenRole
+	};
+
+	explicit JsonTreeFlatModel(JsonTreeModel* sourceModel, QObject* parent = nullptr);
+
+	JsonTreeModel* sourceModel() const { return m_sourceModel; }
+
+	// Header:
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	// Basic functionality:
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	// Editable:
+	bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+	Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+	// API specific to JsonTreeFlatModel:
+	QModelIndex mapToSource(const QModelIndex& index) const;
+	QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
+
+	Q_INVOKABLE bool isExpanded(int row) const;
+	Q_INVOKABLE void setExpanded(int row, bool expanded);
+	Q_INVOKABLE void expand(int row) { setExpanded(row, true); }
+	Q_INVOKABLE void collapse(int row) { setExpanded(row, false); }
+
+private:
+	// A Fenwick tree of the number of visible rows under each child of a node
+	class RowTree
+	{
+	public:
+		RowTree() : m_total(0) {}
+
+		void build(const QVector<int>& weights);
+		void add(int position, int delta);
+		int prefix(int count) const;
+		int find(int* offset) const;
+		int total() const { return m_total; }
+
+	private:
+		QVector<int> m_tree; // 1-based
+		int m_total;
+	};
+
+	JsonTreeModelListNode* rootNode() const;
+	int ensureRowTree(JsonTreeModelListNode* node);
+	void dropRowTrees(JsonTreeModelNode* node);
+	void propagate(JsonTreeModelListNode* node, int delta);
+
+	bool isVisible(const JsonTreeModelNode* node) const;
+	bool showsChildren(const JsonTreeModelListNode* node) const;
+	int flatRow(const JsonTreeModelNode* node) const;
+	int firstChildRow(const JsonTreeModelListNode* node) const;
+	JsonTreeModelNode* nodeAt(int row) const;
+	JsonTreeModelListNode* sourceNode(const QModelIndex& sourceIndex) const;
+
+	void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
+	void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+	void onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+	void onSourceRowsRemoved();
+	void onSourceModelReset();
+
+	JsonTreeModel* m_sourceModel;
+	QHash<const JsonTreeModelListNode*, RowTree> m_rowTrees;
+
+	// Between rowsAboutToBeRemoved() and rowsRemoved()
+	JsonTreeModelListNode* m_removalParent;
+	int m_removalOldTotal;
+	bool m_removalVisible;
+};
+
+#endif // JSONTREEFLATMODEL_H
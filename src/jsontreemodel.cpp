@@ -7,338 +7,28 @@
 \*/
 
 #include "jsontreemodel.h"
+#include "jsontreesnapshot.h"
+#include "jsontreepager.h"
+#include "jsontreequery.h"
+#include "jsontreedictionary.h"
+#include <QIODevice>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 //#include <QFont>
-#include <QSet>
-
-//=================================
-// JsonTreeModelNode and subclasses
-//=================================
-/*!
-	\class JsonTreeModelNode
-	\brief JsonTreeModelNode is the base class for the internal data structure behind JsonTreeModel.
-*/
-/*!
-	\enum JsonTreeModelNode::Type
-	\brief This enum describes the type of data represented by a JsonTreeModelNode.
-
-	\sa type()
-*/
-/*!
-	\fn JsonTreeModelNode::JsonTreeModelNode
-	\brief Constructs a new node with the given \a parent.
-
-	\note Only a JsonTreeModelListNode (or one of its subclasses) can be a parent.
-*/
-/*!
-	\fn JsonTreeModelNode::~JsonTreeModelNode
-	\brief Frees the memory held by this node and its children.
-
-	\warning This node is not automatically removed from its parent's list of children.
-*/
-/*!
-	\fn JsonTreeModelNode* JsonTreeModelNode::parent
-	\brief Returns this node's parent.
-
-	\sa setParent()
-*/
-/*!
-	\fn void JsonTreeModelNode::setParent
-	\brief Makes this node a child of \a parent.
-
-	\note Only a JsonTreeModelListNode (or one of its subclasses) can be a parent.
-
-	\warning This function only updates this node's internal pointer to its parent. The caller
-			 must manually update the child's
-			 \link JsonTreeModelListNode::registerChild() registration\endlink.
-
-	\sa parent()
-*/
-/*!
-	\fn virtual QJsonValue JsonTreeModelNode::value
-	\brief Returns the JSON value represented by this node and its children (if any).
-*/
-
-/*!
-	\class JsonTreeModelScalarNode
-	\brief JsonTreeModelScalarNode is the most basic element of a JsonTreeModel's internal data.
-
-	It represents a single scalar JSON value (nulls, Booleans, numbers, and strings).
-
-	\note JsonTreeModelScalarNode cannot be the \link JsonTreeModelNode::parent() parent \endlink of another node.
-*/
-/*!
-	\brief Constructs a node under the specified \a parent to represent the specified scalar \a value.
-*/
-JsonTreeModelScalarNode::JsonTreeModelScalarNode(const QJsonValue& value, JsonTreeModelNode* parent) :
-	JsonTreeModelNode(parent),
-	m_value(value)
-{}
-
-/*!
-	\fn Type JsonTreeModelScalarNode::type
-	\brief Returns JsonTreeModelNode::Scalar
-*/
-/*!
-	\fn void JsonTreeModelScalarNode::setValue
-	\brief Replaces the \a value represented by this node.
-
-	\sa value()
-*/
-/*!
-	\fn QJsonValue JsonTreeModelScalarNode::value
-	\brief Returns the scalar JSON value represented by this node.
-
-	\sa setValue()
-*/
-
-/*!
-	\class JsonTreeModelListNode
-	\brief JsonTreeModelListNode represents a JSON structure (namely an array or an object)
-		   and provides the backbone of the tree model.
-
-	This class can have \e children. Child nodes manifest as child rows in the
-	JsonTreeModel.
-
-	JSON objects are best represented as a JsonTreeModelNamedListNode.
-*/
-/*!
-	\fn JsonTreeModelListNode::JsonTreeModelListNode(JsonTreeModelNode* parent)
-	\brief Constructs an empty JsonTreeModelListNode under the specified \a parent.
-
-	The new node can be populated later.
-*/
-/*!
-	\brief Constructs a node under the specified \a parent to represent the specified JSON \a array.
-
-	All \a array elements will be placed within child nodes and \link registerChild() registered\endlink.
-*/
-JsonTreeModelListNode::JsonTreeModelListNode(const QJsonArray& array, JsonTreeModelNode* parent) :
-	JsonTreeModelNode(parent)
-{
-	JsonTreeModelNode* childNode;
-	for (int i = 0; i < array.count(); ++i)
-	{
-		const auto& child = array[i];
-
-		switch (child.type())
-		{
-		case QJsonValue::Null:
-		case QJsonValue::Bool:
-		case QJsonValue::Double:
-		case QJsonValue::String:
-			childNode = new JsonTreeModelScalarNode(child, this);
-			break;
-
-		case QJsonValue::Array:
-			childNode = new JsonTreeModelListNode(child.toArray(), this);
-			break;
-
-		case QJsonValue::Object:
-			childNode = new JsonTreeModelNamedListNode(child.toObject(), this);
-			break;
-
-		case QJsonValue::Undefined:
-			continue; // Shouldn't happen
-		}
-		registerChild(childNode);
-	}
-}
-
-/*!
-	\fn JsonTreeModelNode* JsonTreeModelListNode::childAt
-	\brief Returns the child node at index \a i.
-
-	\warning The caller must ensure that 0 <= \a i < childCount()
-
-	\sa childPosition()
-*/
-/*!
-	\fn int JsonTreeModelListNode::childCount
-	\brief Returns the number of child nodes under this row.
-
-	This is equivalent to the number of \link JsonTreeModel::rowCount() rows \endlink
-	in the JsonTreeModel where this node is the parent QModelIndex.
-*/
-/*!
-	\fn int JsonTreeModelListNode::childPosition
-	\brief Returns index number of the specified \a child, or
-	-1 if the \a child does not belong to this node.
-
-	\sa childAt()
-*/
-/*!
-	\fn Type JsonTreeModelListNode::type
-	\brief Returns JsonTreeModelNode::Array.
-*/
-
-/*!
-	\brief Returns the JSON structure (array or object) represented by this node.
-*/
-QJsonValue
-JsonTreeModelListNode::value() const
-{
-	QJsonArray fullArray;
-	for (const auto childNode : qAsConst(m_childList))
-		fullArray << childNode->value();
-	return fullArray;
-}
-
-/*!
-	\brief Puts the \a child node under this node's hierarchy
-
-	\note Only the \a child's parent can call this function
-*/
-void
-JsonTreeModelListNode::registerChild(JsonTreeModelNode* child)
-{
-	Q_ASSERT_X(child->parent() == this, "registerChild()", "Only a parent can register its own child");
-	m_childPositions[child] = m_childList.count();
-	m_childList << child;
-}
-
-/*!
-	\brief Removes the \a child node from this node's hierarchy
-
-	\note Only the \a child's parent can call this function
-*/
-void
-JsonTreeModelListNode::deregisterChild(JsonTreeModelNode* child)
-{
-	Q_ASSERT_X(child->parent() == this, "deregisterChild()", "Only a parent can deregister its own child");
-	auto i = m_childPositions.take(child);
-	m_childList.remove(i);
-
-	// ASSUMPTION: Registration/deregistration is infrequent, but lookups are very frequent. Thus, this O(n) loop is acceptable.
-	while (i < m_childList.count())
-	{
-		m_childPositions[ m_childList[i] ] = i;
-		++i;
-	}
-	// TODO: Add function to deregister multiple children simultaneously
-}
-
-/*!
-	\class JsonTreeModelNamedListNode
-	\brief JsonTreeModelNamedListNode represents a JSON object.
-
-	Scalar members of this node appear in named
-	\link JsonTreeModel::scalarColumns() scalar columns\endlink in the JsonTreeModel.
-
-	Non-scalar members of this node (arrays and objects) appear as child rows in the JsonTreeModel.
-
-	If this node represents a top-level object of a JSON document and it contains scalar
-	members, then this node must be wrapped in a JsonTreeModelWrapperNode.
-*/
-/*!
-	\brief Constructs a node under the specified \a parent to represent the specified JSON \a object.
-*/
-JsonTreeModelNamedListNode::JsonTreeModelNamedListNode(const QJsonObject& object, JsonTreeModelNode* parent) :
-	JsonTreeModelListNode(parent)
-{
-	JsonTreeModelNode* childNode;
-	for (const QString& key : object.keys())
-	{
-		const auto& child = object[key];
-		switch (child.type())
-		{
-		case QJsonValue::Null:
-		case QJsonValue::Bool:
-		case QJsonValue::Double:
-		case QJsonValue::String:
-			m_namedScalarMap[key] = child;
-			continue;
-
-		case QJsonValue::Array:
-			childNode = new JsonTreeModelListNode(child.toArray(), this);
-			break;
-
-		case QJsonValue::Object:
-			childNode = new JsonTreeModelNamedListNode(child.toObject(), this);
-			break;
-
-		default: continue;
-		}
-		registerChild(childNode);
-		m_childListNodeNames[childNode] = key;
-	}
-}
-
-/*!
-	\fn QString JsonTreeModelNamedListNode::childListNodeName
-	\brief
-*/
-/*!
-	\fn int JsonTreeModelNamedListNode::namedScalarCount
-	\brief Returns the number of scalar elements within this node.
-
-	In the JsonTreeModel, these are the elements that appear under the
-	model's \link JsonTreeModel::scalarColumns() scalar columns\endlink.
-*/
-/*!
-	\fn QJsonValue JsonTreeModelNamedListNode::namedScalarValue
-	\brief Returns the scalar element in this node which has the given \a name.
-
-	If the underlying JSON object has no member with the given \a name
-	(or if the member is non-scalar), this function returns an undefined
-	QJsonValue.
-
-	\sa setNamedScalarValue()
-*/
-/*!
-	\fn void JsonTreeModelNamedListNode::setNamedScalarValue
-	\brief Adds or updates a scalar element of the JSON object represented
-		   by this node.
-
-	\sa namedScalarValue()
-*/
-/*!
-	\fn Type JsonTreeModelNamedListNode::type
-	\brief Returns JsonTreeModelNode::Object
-*/
-/*!
-	\fn QJsonValue JsonTreeModelNamedListNode::value
-	\brief Returns the JSON object represented by this node.
-*/
-
-QJsonValue
-JsonTreeModelNamedListNode::value() const
-{
-	QJsonObject fullObject;
-	for (auto i = m_namedScalarMap.constBegin(); i != m_namedScalarMap.constEnd(); ++i)
-		fullObject.insert(i.key(), i.value());
-	for (auto i = m_childListNodeNames.constBegin(); i != m_childListNodeNames.constEnd(); ++i)
-		fullObject.insert(i.value(), i.key()->value()); // i's value is the element name, while i's key is the node
-	return fullObject;
-}
-
-/*!
-	\class JsonTreeModelWrapperNode
-	\brief The JsonTreeModelWrapperNode class wraps a top-level JsonTreeModelNamedListNode,
-		   to allow its scalar members to be shown.
-*/
-/*!
-	\brief Constructs a wrapper for \a realNode and takes ownership of it.
-
-	Unlike the constructors for other classes derived from JsonTreeModelNode, this one does not take a parent
-	because JsonTreeModelWrapperNode is only meant to be used as the JsonTreeModel's root node.
-*/
-JsonTreeModelWrapperNode::JsonTreeModelWrapperNode(JsonTreeModelNamedListNode* realNode) :
-	JsonTreeModelListNode(nullptr)
-{
-	Q_ASSERT(realNode->parent() == nullptr);
-
-	// NOTE: Only a parent can register a child, so we must call setParent() before registerChild()
-	realNode->setParent(this);
-	registerChild(realNode);
-}
-
-/*!
-	\fn QJsonValue JsonTreeModelWrapperNode::value
-
-	\brief Returns the JSON object represented by the wrapped node.
-*/
-
 
 //=================================
 // JsonTreeModel itself
@@ -467,6 +157,43 @@ JsonTreeModelWrapperNode::JsonTreeModelWrapperNode(JsonTreeModelNamedListNode* r
 	but this could be expensive for large JSON documents.
 */
 
+/*!
+	\enum JsonTreeModel::ExportOption
+	\brief This enum controls the output of exportDelimited().
+
+	\sa exportDelimited()
+*/
+/*!
+	\var JsonTreeModel::TabSeparated
+
+	Writes tab-separated values (TSV) instead of comma-separated values (CSV).
+*/
+/*!
+	\var JsonTreeModel::OmitHeader
+
+	Leaves out the header line.
+*/
+/*!
+	\var JsonTreeModel::Recursive
+
+	Writes the descendants of each row too.
+*/
+
+/*!
+	\enum JsonTreeModel::Roles
+	\brief This enum describes the roles that QML delegates can use to access a row, regardless of
+	the column of the index.
+
+	\value KeyRole The array index or object member name of the row, like column 0. Named \c key.
+	\value ValueRole The scalar element of the row, like column 1. Named \c value. Writable.
+	\value TypeRole The type of the row's value: \c "object", \c "array", \c "string",
+		   \c "number", \c "bool" or \c "null". Named \c type.
+	\value ScalarColumnRole The scalar member under the first named scalar column. The next column
+		   has role \c ScalarColumnRole + 1, and so on. Named after the column. Writable.
+
+	\sa roleNames()
+*/
+
 
 /*!
 	\brief Constructs an empty JsonTreeModel with the given \a parent.
@@ -474,17 +201,54 @@ JsonTreeModelWrapperNode::JsonTreeModelWrapperNode(JsonTreeModelNamedListNode* r
 JsonTreeModel::JsonTreeModel(QObject* parent) :
 	QAbstractItemModel(parent),
 	m_rootNode(nullptr),
-	m_headers({"<Structure>", "<Scalar>"})
-{}
+	m_headers({"<Structure>", "<Scalar>"}),
+	m_columnProjection(false),
+	m_branchColumns(false),
+	m_journalBase(0),
+	m_journalPosition(0),
+	m_undoLimit(0),
+	m_notificationTimer(new QTimer(this)),
+	m_postedUpdates(nullptr),
+	m_updateTimer(new QTimer(this)),
+	m_readCacheValid(false),
+	m_memoryBudget(0),
+	m_residentBytes(0),
+	m_pageClock(1),
+	m_pageFile(nullptr),
+	m_trimScheduled(false),
+	m_pageCompression(false),
+	m_compressedBytes(0),
+	m_dictionary(nullptr),
+	m_subtreeSharing(false),
+	m_followWatcher(nullptr),
+	m_followOffset(0),
+	m_followSearchMode(QuickSearch)
+{
+	m_notificationTimer->setSingleShot(true);
+	connect(m_notificationTimer, &QTimer::timeout, this, &JsonTreeModel::flushChanges);
 
-/*!
-	\fn JsonTreeModel::~JsonTreeModel
+	m_updateTimer->setSingleShot(true);
+	connect(m_updateTimer, &QTimer::timeout, this, &JsonTreeModel::applyPostedUpdates);
+}
 
+/*!
 	\brief Destroys the JsonTreeModel and frees its memory.
 */
+JsonTreeModel::~JsonTreeModel()
+{
+	for (auto update = m_postedUpdates.fetchAndStoreAcquire(nullptr); update != nullptr; )
+	{
+		auto next = update->next;
+		delete update;
+		update = next;
+	}
+	delete m_rootNode;
+	delete m_dictionary;
+}
 
 /*!
-	Horizontal headers show the text of scalarColumns() for the third column onwards.
+	Horizontal headers show the text of scalarColumns() for the third column onwards. In
+	branch column mode, they show the scalarColumns() of the top-level rows instead.
 	Vertical headers show the text of column 0.
 */
 QVariant
@@ -492,8 +256,9 @@ JsonTreeModel::headerData(int section, Qt::Orientation orientation, int role) co
 {
 	if (role == Qt::DisplayRole)
 	{
-		if (orientation == Qt::Horizontal && section < m_headers.count())
-			return m_headers[section];
+		const QStringList headers = columnsFor(m_rootNode);
+		if (orientation == Qt::Horizontal && section < headers.count())
+			return headers[section];
 
 		// ASSUMPTION: Vertical headers are only requested by Table Views
 		return data(index(section, 0));
@@ -504,45 +269,35 @@ JsonTreeModel::headerData(int section, Qt::Orientation orientation, int role) co
 QModelIndex
 JsonTreeModel::index(int row, int column, const QModelIndex& parent) const
 {
-	// NOTE: m_headers also takes the struct column and scalar column into account
-	if (column >= m_headers.count() || column < 0)
+	auto parentNode = JsonTreeModelCore::listNode(parent, m_rootNode);
+	if (parentNode == nullptr) // Short-circuit
 		return QModelIndex();
 
-	auto parentNode = parent.isValid() ?
-			static_cast<JsonTreeModelNode*>(parent.internalPointer()) :
-			m_rootNode;
-
-	if (parentNode == nullptr || parentNode->type() == JsonTreeModelNode::Scalar) // Short-circuit
+	// NOTE: The headers also take the struct column and scalar column into account
+	if (column >= columnsFor(parentNode).count() || column < 0)
 		return QModelIndex();
 
 	// ASSUMPTION: For sub-items, parent's column always == 0 and the parent is an array/object
 	// TODO: Check assumption
-	auto specificParentNode = static_cast<JsonTreeModelListNode*>(parentNode);
-	if (row >= specificParentNode->childCount() || row < 0)
+	auto childRow = JsonTreeModelCore::child(parentNode, row);
+	if (childRow == nullptr)
 		return QModelIndex();
 
-	auto childRow = specificParentNode->childAt(row);
+	// NOTE: rowCount() doesn't count as a use, because a QTreeView probes every row
+	if (m_memoryBudget > 0)
+		touchPage(parentNode);
+
 	return createIndex(row, column, childRow);
 }
 
 QModelIndex
 JsonTreeModel::parent(const QModelIndex& index) const
 {
-	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
-	if (node)
-	{
-		auto parentNode = node->parent();
-		if (parentNode != nullptr && parentNode != m_rootNode)
-		{
-			Q_ASSERT(parentNode->type() != JsonTreeModelNode::Scalar);
-			auto grandparentNode = static_cast<JsonTreeModelListNode*>(parentNode->parent());
-			Q_ASSERT(grandparentNode != nullptr);
-			int parentRow = grandparentNode->childPosition(parentNode);
-
-			return createIndex(parentRow, 0 , parentNode);
-		}
-	}
-	return QModelIndex();
+	int parentRow;
+	auto parentNode = JsonTreeModelCore::parentNode(index, m_rootNode, &parentRow);
+	if (parentNode == nullptr)
+		return QModelIndex();
+	return createIndex(parentRow, 0, parentNode);
 }
 
 /*!
@@ -557,18 +312,13 @@ JsonTreeModel::parent(const QModelIndex& index) const
 int
 JsonTreeModel::rowCount(const QModelIndex& parent) const
 {
-	// NOTE: A QTreeView will try to probe the child count of all nodes, so we must check the node type.
-	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : m_rootNode;
-	if (node == nullptr || node->type() == JsonTreeModelNode::Scalar) // Short-circuit
-		return 0;
-
-	return static_cast<JsonTreeModelListNode*>(node)->childCount();
+	return JsonTreeModelCore::rowCount(parent, m_rootNode);
 }
 
 /*!
-	\brief Returns the number of columns in the model.
+	\brief Returns the number of columns under the given \a parent.
 
-	This number is the same for the entire model; the \a parent is irrelevant.
+	This number is the same for the entire model, unless branchColumns() is enabled.
 	- Column 0 shows the structure of the JSON document. It contains array index numbers and object
 	  member names.
 	- Column 1 shows the scalar elements of JSON arrays.
@@ -579,10 +329,10 @@ JsonTreeModel::rowCount(const QModelIndex& parent) const
 int
 JsonTreeModel::columnCount(const QModelIndex& parent) const
 {
-	Q_UNUSED(parent);
-
 	// NOTE: The headers list includes Struct and Scalar columns
-	return m_headers.count();
+	if (!m_branchColumns)
+		return m_headers.count();
+	return columnsFor( parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : m_rootNode ).count();
 }
 
 /*!
@@ -614,43 +364,80 @@ JsonTreeModel::data(const QModelIndex& index, int role) const
 		if (!node)
 			return QVariant();
 
-		auto col = index.column();
-		switch (col)
+		// NOTE: Only the named scalar columns need the headers
+		if (index.column() < 2 || node->type() != JsonTreeModelNode::Object)
+			return JsonTreeModelCore::displayData(index, QStringList());
+		return JsonTreeModelCore::displayData(index, columnsFor(node->parent()));
+	}
+	else if (role >= KeyRole)
+	{
+		auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
+		if (!node)
+			return QVariant();
+
+		switch (role)
 		{
-		case 0: // Struct column
+		case KeyRole:
+			return data(createIndex(index.row(), 0, node));
+
+		case ValueRole:
+			if (node->type() == JsonTreeModelNode::Scalar)
+				return JsonTreeModelNode::Traits::toVariant( static_cast<JsonTreeModelScalarNode*>(node)->value() );
+			break;
+
+		case TypeRole:
+			switch (node->type())
+			{
+			case JsonTreeModelNode::Object: return QStringLiteral("object");
+			case JsonTreeModelNode::Array:  return QStringLiteral("array");
+			case JsonTreeModelNode::Scalar: break;
+			}
+			switch (static_cast<JsonTreeModelScalarNode*>(node)->value().type())
 			{
-				if (node->parent()->type() == JsonTreeModelNode::Array)
-					return index.row();
+			case QJsonValue::String: return QStringLiteral("string");
+			case QJsonValue::Double: return QStringLiteral("number");
+			case QJsonValue::Bool:   return QStringLiteral("bool");
+			default:                 return QStringLiteral("null");
+			}
 
-				// A node's parent cannot be a Scalar node
-				Q_ASSERT(node->parent()->type() == JsonTreeModelNode::Object);
-				return static_cast<JsonTreeModelNamedListNode*>( node->parent() )->childListNodeName(node);
+		default: // Named scalars, by their position in the model-wide headers
+			{
+				const int column = role - ScalarColumnRole + 2;
+				if (node->type() == JsonTreeModelNode::Object && column < m_headers.count())
+					return JsonTreeModelNode::Traits::toVariant( static_cast<JsonTreeModelNamedListNode*>(node)->namedScalarValue(m_headers[column]) );
 			}
+		}
+	}
+	return QVariant();
+}
 
-		/*
-			Qt Bug? (As of Qt 5.10.0)
-			- If the data value is a QJsonValue that holds a string, it shows up fine in the View.
-			- If the data value is a QJsonValue that holds a double, it doesn't show up fine in the View.
-			- If the data value is a QVariant that holds a double, it shows up fine in the View.
+/*!
+	\brief Returns the names of the roles that QML delegates can use, including one for each of
+	the scalarColumns().
 
-			Possibly related to the fact that QVariant::toString() works if the data is QJsonValue::String, but not QJsonValue::Number
+	A role is resolved by its offset from \c ScalarColumnRole, so data() does not look up role
+	names. Columns that are named after another role (such as \c key or \c display) do not get
+	a role of their own. QML views read the role names once, so the scalar columns should be set
+	before the model is given to a view.
 
-			See also
-			- QTBUG-52097
-			- QTBUG-53579
-			- QTBUG-60999
-		*/
-		case 1: // Scalar column
-			if (node->type() == JsonTreeModelNode::Scalar)
-				return static_cast<JsonTreeModelScalarNode*>(node)->value().toVariant();
-			break;
+	\sa Roles
+*/
+QHash<int, QByteArray>
+JsonTreeModel::roleNames() const
+{
+	auto names = QAbstractItemModel::roleNames();
+	names.insert(KeyRole, "key");
+	names.insert(ValueRole, "value");
+	names.insert(TypeRole, "type");
 
-		default: // Named scalars
-			if (col < m_headers.count() && node->type() == JsonTreeModelNode::Object)
-				return static_cast<JsonTreeModelNamedListNode*>(node)->namedScalarValue( m_headers[col] ).toVariant();
-		}
+	const auto reserved = names.values();
+	for (int column = 2; column < m_headers.count(); ++column)
+	{
+		const QByteArray name = m_headers[column].toUtf8();
+		if (!reserved.contains(name))
+			names.insert(ScalarColumnRole + column - 2, name);
 	}
-	return QVariant();
+	return names;
 }
 
 /*
@@ -659,71 +446,262 @@ JsonTreeModel::data(const QModelIndex& index, int role) const
 bool
 JsonTreeModel::setData(const QModelIndex& index, const QVariant& value, int role)
 {
-	if ( role != Qt::EditRole
-			|| !isEditable(index) // NOTE: isEditable() checks for index validity
-			|| data(index, role) == value )
-	{
+	// NOTE: QML delegates write the cells of a row through roles, via the index of column 0
+	const bool itemRole = (role == ValueRole || role >= ScalarColumnRole);
+	const QModelIndex cell = itemRole ? roleIndex(index, role) : index;
+	if ( (role != Qt::EditRole && !itemRole) || !writeData(cell, value) )
 		return false; // TODO: Check if setting an indentical value should return true or false
-	}
 
-	QJsonValue newData;
-	switch (  static_cast<QMetaType::Type>( value.type() )  )
-	{
-	case QMetaType::Void:
-		// newData remains null
-		break;
+	// NOTE: The displayed text and the item role of the cell change too, whatever role was written
+	DirtyCells dirty;
+	markDirty(dirty, static_cast<JsonTreeModelNode*>(cell.internalPointer()), cell.row(), cell.column());
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return true;
+}
 
-	case QMetaType::Bool:
-		newData = value.toBool();
-		break;
+/*!
+	\brief Sets the data of many cells at once, and returns the number of cells that changed.
 
-	case QMetaType::Short:
-	case QMetaType::UShort:
-	case QMetaType::Int:
-	case QMetaType::UInt:
-	case QMetaType::Long:
-	case QMetaType::ULong:
-	case QMetaType::LongLong:
-	case QMetaType::ULongLong:
-	case QMetaType::Float:
-	case QMetaType::Double:
-		newData = value.toDouble(); // TODO: Preserve numeric representation?
-		break;
+	Each element of \a cells pairs an index with its new value. The values are applied as if by
+	setData(), but the \c dataChanged() signals are only emitted after all of them have been
+	applied. Changed cells that share a parent are merged into as few rectangular ranges as
+	possible, so updating a whole block of cells emits a single signal.
 
-	// TODO: Convert char/QChar?
+	Only \c Qt::EditRole is supported for the \a role.
 
-	case QMetaType::QString:
-		newData = value.toString();
-		break;
+	\sa setData()
+*/
+int
+JsonTreeModel::setDataBatch(const QVector<QPair<QModelIndex, QVariant>>& cells, int role)
+{
+	if (role != Qt::EditRole)
+		return 0;
 
-	default:
-		return false;
+	DirtyCells dirty;
+	int changeCount = 0;
+	for (const auto& cell : cells)
+	{
+		if (writeData(cell.first, cell.second))
+		{
+			markDirty(dirty, static_cast<JsonTreeModelNode*>(cell.first.internalPointer()), cell.first.row(), cell.first.column());
+			++changeCount;
+		}
 	}
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return changeCount;
+}
 
-	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
-	Q_ASSERT(node != nullptr);
-	switch (index.column())
-	{
-	case 0: // "Structure" column
-		return false; // TODO: Allow changing an Object's member names
+/*!
+	\overload
 
-	case 1: // "Scalar" column
-		Q_ASSERT(node->type() == JsonTreeModelNode::Scalar);
-		static_cast<JsonTreeModelScalarNode*>(node)->setValue(newData);
-		break;
+	Sets the data of a block of cells that starts at \a topLeft and is \a columnCount columns
+	wide. The \a values are listed in row-major order; the number of rows is derived from the
+	number of values.
+*/
+int
+JsonTreeModel::setDataBatch(const QModelIndex& topLeft, int columnCount, const QVariantList& values, int role)
+{
+	if (role != Qt::EditRole || !topLeft.isValid() || columnCount <= 0)
+		return 0;
 
-	default: // Named scalar columns
-		if (node->type() == JsonTreeModelNode::Object)
-			static_cast<JsonTreeModelNamedListNode*>(node)->setNamedScalarValue(m_headers[index.column()], newData);
-		else
-			return false;
+	const auto parentIndex = topLeft.parent();
+	DirtyCells dirty;
+	int changeCount = 0;
+	for (int i = 0; i < values.count(); ++i)
+	{
+		const auto cell = index(topLeft.row() + i/columnCount, topLeft.column() + i%columnCount, parentIndex);
+		if (writeData(cell, values[i]))
+		{
+			markDirty(dirty, static_cast<JsonTreeModelNode*>(cell.internalPointer()), cell.row(), cell.column());
+			++changeCount;
+		}
 	}
-
-	emit dataChanged(index, index, QVector<int>{role});
-	return true;
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return changeCount;
 }
 
-Qt::ItemFlags
+/*!
+	\brief Limits how often the model emits \c dataChanged() signals for edited cells.
+
+	By default, the \a msec interval is 0: every edit is signalled immediately. If the interval is
+	positive, the cells changed by setData(), setDataBatch(), undo(), redo() and restore() are
+	accumulated instead, and signalled as merged ranges at most once per interval. This allows the
+	data to be updated far more often than the views are repainted.
+
+	Call flushChanges() to signal the accumulated cells right away. Changing the interval flushes
+	the cells that are already pending.
+
+	\sa notificationInterval(), flushChanges()
+*/
+void
+JsonTreeModel::setNotificationInterval(int msec)
+{
+	flushChanges();
+	m_notificationTimer->setInterval(qMax(0, msec));
+}
+
+/*!
+	\brief Returns the minimum time between \c dataChanged() signals for edited cells, in milliseconds.
+
+	\sa setNotificationInterval()
+*/
+int
+JsonTreeModel::notificationInterval() const
+{
+	return m_notificationTimer->interval();
+}
+
+/*!
+	\brief Emits the \c dataChanged() signals for all cells whose notification is still pending.
+
+	Does nothing if no cells are pending, which is always the case when notificationInterval() is 0.
+
+	\sa setNotificationInterval()
+*/
+void
+JsonTreeModel::flushChanges()
+{
+	m_notificationTimer->stop();
+	if (m_pendingChanges.isEmpty())
+		return;
+
+	// NOTE: Swap the pending cells out first, in case a slot connected to dataChanged() edits the model
+	DirtyCells pending;
+	QVector<int> roles;
+	pending.swap(m_pendingChanges);
+	roles.swap(m_pendingRoles);
+	emitDataChanged(pending, roles);
+}
+
+/*!
+	\brief Queues an update of the scalar at the given JSON \a pointer (RFC 6901) to the given
+	\a value. This function is thread-safe.
+
+	Producer threads never block: the update is pushed onto a lock-free queue, which the model's
+	thread drains in batches, at most once per updateInterval(). Each batch is applied in the
+	order that the updates were posted, and the changed cells are signalled as merged ranges
+	(subject to notificationInterval() as well), so a burst of updates to the same cells costs one
+	\c dataChanged() signal per range rather than one per update.
+
+	The \a pointer must refer to an existing scalar element of an array, or to a scalar member
+	of an object (which is added if it does not exist). Updates that refer to anything else are
+	dropped when they are applied. Each batch of posted updates that changes the data creates a
+	single revision, and is a single step in the undo history.
+
+	\sa applyPostedUpdates(), setUpdateInterval()
+*/
+void
+JsonTreeModel::postUpdate(const QString& pointer, const QJsonValue& value)
+{
+	auto update = new PostedUpdate{pointer, value, nullptr};
+	PostedUpdate* head;
+	do
+	{
+		head = m_postedUpdates.load();
+		update->next = head;
+	} while (!m_postedUpdates.testAndSetRelease(head, update));
+
+	// NOTE: Only the update that makes the queue non-empty wakes up the model's thread
+	if (head == nullptr)
+		QMetaObject::invokeMethod(m_updateTimer, "start", Qt::QueuedConnection);
+}
+
+/*!
+	\brief Applies the updates that were queued by postUpdate(), and returns the number of
+	updates that were applied.
+
+	This is called automatically, but can be called to apply the updates right away. It must be
+	called from the model's thread.
+
+	\sa postUpdate()
+*/
+int
+JsonTreeModel::applyPostedUpdates()
+{
+	m_updateTimer->stop();
+
+	// NOTE: The queue is taken over as a whole, so the producers and this function never contend for a node
+	PostedUpdate* update = m_postedUpdates.fetchAndStoreAcquire(nullptr);
+	if (update == nullptr)
+		return 0;
+
+	// The queue is a stack, so it is reversed to apply the updates in the order they were posted
+	PostedUpdate* first = nullptr;
+	while (update != nullptr)
+	{
+		auto next = update->next;
+		update->next = first;
+		first = update;
+		update = next;
+	}
+
+	DirtyCells dirty;
+	int applyCount = 0;
+	bool changed = false;
+	QJsonArray patch;
+	QVector<QJsonObject> inverseOperations;
+	for (update = first; update != nullptr; )
+	{
+		QJsonObject operation;
+		QJsonObject inverse;
+		if (applyUpdate(update->pointer, update->value, dirty, &operation, &inverse))
+			++applyCount;
+		if (!inverse.isEmpty())
+		{
+			changed = true;
+			if (m_undoLimit > 0)
+			{
+				patch.append(operation);
+				inverseOperations << inverse;
+			}
+		}
+
+		auto next = update->next;
+		delete update;
+		update = next;
+	}
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+
+	// NOTE: A batch that changes the data is a single revision, which undo() reverts as a whole
+	if (changed)
+	{
+		Edit edit;
+		edit.patch = patch;
+		for (int i = inverseOperations.count() - 1; i >= 0; --i)
+			edit.inversePatch.append(inverseOperations[i]);
+		appendJournal(edit);
+	}
+	return applyCount;
+}
+
+/*!
+	\brief Sets the minimum time between the batches of updates that are applied from
+	postUpdate(), in milliseconds.
+
+	The default \a msec interval is 0, which applies the queued updates as soon as the model's
+	thread returns to its event loop.
+
+	\sa updateInterval()
+*/
+void
+JsonTreeModel::setUpdateInterval(int msec)
+{
+	m_updateTimer->setInterval(qMax(0, msec));
+}
+
+/*!
+	\brief Returns the minimum time between the batches of updates that are applied from
+	postUpdate(), in milliseconds.
+
+	\sa setUpdateInterval()
+*/
+int
+JsonTreeModel::updateInterval() const
+{
+	return m_updateTimer->interval();
+}
+
+Qt::ItemFlags
 JsonTreeModel::flags(const QModelIndex& index) const
 {
 	if (isEditable(index))
@@ -804,36 +782,13 @@ JsonTreeModel::flags(const QModelIndex& index) const
 QJsonValue
 JsonTreeModel::json(const QModelIndex& index) const
 {
-	// Top-level
-	if (!index.isValid())
-	{
-		if (m_rootNode == nullptr)
-			return QJsonValue();
-		return m_rootNode->value();
-	}
+	if (index.column() < 2)
+		return JsonTreeModelCore::value(index, m_rootNode, QStringList());
 
-	// Not top-level
 	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
-	switch (index.column())
-	{
-	case 0: // "Structure" column
-		return node->value();
-
-	case 1: // "Scalar" column
-		if (node->type() == JsonTreeModelNode::Scalar)
-			return node->value();
-		break;
-
-	default: // Named scalar columns
-		if (node->type() == JsonTreeModelNode::Object)
-			return static_cast<JsonTreeModelNamedListNode*>(node)->namedScalarValue(m_headers[index.column()]);
-	}
-	return QJsonValue();
+	return JsonTreeModelCore::value(index, m_rootNode, columnsFor(node->parent()));
 }
 
-static QSet<QString>
-findScalarNames(const QJsonValue &data, bool comprehensive);
-
 /*!
 	\brief Sets the whole model's internal data structure to the given JSON \a array.
 
@@ -845,19 +800,14 @@ findScalarNames(const QJsonValue &data, bool comprehensive);
 void
 JsonTreeModel::setJson(const QJsonArray& array, ScalarColumnSearchMode searchMode)
 {
+	stopFollowing();
 	beginResetModel();
-	if (m_rootNode != nullptr)
-		delete m_rootNode;
-	m_rootNode = new JsonTreeModelListNode(array, nullptr);
+	resetDocumentState();
 
-	if (searchMode != NoSearch)
-	{
-		auto scalarCols = findScalarNames( array, (searchMode == ComprehensiveSearch) ).toList();
-		std::sort(scalarCols.begin(), scalarCols.end());
-		m_headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
-		// TODO: Implement QList::resize() upstream to discard all columns except the first two? See QTBUG-42732
-		// TODO: Check if it's safe to call setScalarColumns() here, which causes nested beginResetModel() calls
-	}
+	buildDocument(array, searchMode);
+	encodeStrings(m_rootNode);
+	shareIdenticalSubtrees();
+	resetPaging(true);
 	endResetModel();
 
 	// TODO: Handle cases where there's no Struct/Scalar column
@@ -874,107 +824,3899 @@ void
 JsonTreeModel::setJson(const QJsonObject& object, ScalarColumnSearchMode searchMode)
 {
 	// TODO: (See todo list of other overload)
+	stopFollowing();
 	beginResetModel();
-	if (m_rootNode != nullptr)
-		delete m_rootNode;
+	resetDocumentState();
 
-	auto namedListNode = new JsonTreeModelNamedListNode(object, nullptr);
-	if (namedListNode->namedScalarCount() > 0)
+	buildDocument(object, searchMode);
+	encodeStrings(m_rootNode);
+	shareIdenticalSubtrees();
+	resetPaging(true);
+	endResetModel();
+}
+
+/*!
+	\brief Writes the model's data and scalar columns to \a device in a compact binary format.
+
+	The snapshot can be loaded with loadSnapshot() much faster than the original JSON document can
+	be parsed. Returns \c false if the data could not be written.
+
+	\note Snapshots are built in memory before they are written, so they are limited to about
+		  2 GiB. If the snapshot would be larger, nothing is written and \c false is returned.
+
+	\sa loadSnapshot()
+*/
+bool
+JsonTreeModel::saveSnapshot(QIODevice* device) const
+{
+	if (device == nullptr || !device->isWritable())
+		return false;
+	return JsonTreeSnapshotWriter::write(device, m_rootNode, scalarColumns());
+}
+
+/*!
+	\brief Replaces the model's data and scalar columns with a snapshot that was written by
+	saveSnapshot().
+
+	If \a device is a QFile, the snapshot is memory-mapped rather than read. The snapshot is not
+	decoded up front: each array or object is decoded the first time that its rows or values are
+	accessed, so loading takes roughly constant time regardless of the size of the document.
+
+	Returns \c false (and leaves the model unchanged) if \a device does not contain a valid
+	snapshot.
+
+	\sa saveSnapshot(), setJson()
+*/
+bool
+JsonTreeModel::loadSnapshot(QIODevice* device)
+{
+	if (device == nullptr || !device->isReadable())
+		return false;
+
+	auto source = JsonTreeSnapshotSource::open(device);
+	if (source.isNull())
+		return false;
+
+	stopFollowing();
+	beginResetModel();
+	resetDocumentState();
+	m_rootNode = source->createRootNode(source);
+	resetPaging(true);
+	m_headers = QStringList{m_headers[0], m_headers[1]} << source->headers();
+	endResetModel();
+
+	return true;
+}
+
+/*
+	A range of complete lines of an NDJSON document, and what was made of them
+*/
+struct NdjsonChunk
+{
+	const char* begin;
+	const char* end;
+	QVector<QJsonValue> records;
+	QVector<JsonTreeModelNode*> nodes;
+	QSet<QString> scalarNames;
+	int invalidLines;
+};
+
+/*
+	Runs a task for each index that has not been claimed yet. Used by runConcurrently().
+*/
+class ConcurrentTaskRunner : public QRunnable
+{
+public:
+	ConcurrentTaskRunner(const std::function<void(int)>& task, int count, QAtomicInt* next, QSemaphore* finished) :
+		m_task(task),
+		m_count(count),
+		m_next(next),
+		m_finished(finished)
+	{}
+
+	void run() override
 	{
-		auto wrapper = new JsonTreeModelWrapperNode(namedListNode);
-		m_rootNode = wrapper;
+		runAll();
+		m_finished->release();
 	}
-	else
-		m_rootNode = namedListNode;
 
-	if (searchMode != NoSearch)
+	void runAll()
 	{
-		auto scalarCols = findScalarNames( object, (searchMode == ComprehensiveSearch) ).toList();
-		std::sort(scalarCols.begin(), scalarCols.end());
-		m_headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
+		for (int i = m_next->fetchAndAddRelaxed(1); i < m_count; i = m_next->fetchAndAddRelaxed(1))
+			m_task(i);
 	}
-	endResetModel();
+
+private:
+	const std::function<void(int)>& m_task;
+	int m_count;
+	QAtomicInt* m_next;
+	QSemaphore* m_finished;
+};
+
+/*
+	Calls task(i) for every i in [0, count), on the calling thread and on the idle threads of the
+	global thread pool. Pooled threads are only borrowed if they are idle, so this never waits for
+	work that is queued behind the caller.
+*/
+static void
+runConcurrently(int count, const std::function<void(int)>& task)
+{
+	QAtomicInt next(0);
+	QSemaphore finished;
+	int borrowed = 0;
+
+	auto pool = QThreadPool::globalInstance();
+	const int threads = qMin(count, QThread::idealThreadCount());
+	for (int i = 1; i < threads; ++i)
+	{
+		auto runner = new ConcurrentTaskRunner(task, count, &next, &finished);
+		if (!pool->tryStart(runner))
+		{
+			delete runner;
+			break;
+		}
+		++borrowed;
+	}
+
+	ConcurrentTaskRunner(task, count, &next, &finished).runAll();
+	finished.acquire(borrowed);
 }
 
 /*!
-	\fn QStringList JsonTreeModel::scalarColumns
-	\brief Returns the names of the JSON objects' scalar members that are shown by the model.
+	\brief Replaces the model's data with the newline-delimited JSON (NDJSON) records in \a device.
 
-	\sa setScalarColumns()
+	Each line of \a device must contain one JSON object or array, which becomes a top-level row in
+	the order of the lines. Blank lines are skipped, and invalid lines are skipped with a warning.
+	The lines are parsed in parallel on the idle threads of QThreadPool::globalInstance(), so large
+	inputs load faster on machines with more cores.
+
+	If \a searchMode is \c QuickSearch (default), the scalar columns are taken from the first
+	record. If it is \c ComprehensiveSearch, they are taken from all records.
+
+	Returns \c false (and leaves the model unchanged) if \a device is not readable.
+
+	\sa followNdjson(), setJson()
 */
+bool
+JsonTreeModel::loadNdjson(QIODevice* device, ScalarColumnSearchMode searchMode)
+{
+	if (device == nullptr || !device->isReadable())
+		return false;
+
+	stopFollowing();
+	resetNdjson(device->readAll(), searchMode);
+	return true;
+}
 
 /*!
-	\brief Sets the JSON objects' scalar members that are shown by the model.
+	\brief Loads the NDJSON file called \a fileName like loadNdjson() does, and keeps appending the
+	records that are written to the end of the file afterwards.
 
-	The model's \e named \e scalar \e columns are set to the list of specified \a columns, in the
-	listed order.
+	New records are appended as top-level rows when the file changes. A line is only read once it
+	is terminated by a newline, so records that are still being written are never split. If the
+	file shrinks (e.g. because it was truncated or rotated), it is loaded again from the start.
+	The scalar columns are found according to \a searchMode when the first records are loaded, and
+	are kept for the records that are appended.
 
-	If a scalar member of a JSON object is named after one of these columns, it is shown under that
-	column. Otherwise, the member is hidden.
+	Following stops when stopFollowing() is called, or when the model's data is replaced in any
+	other way. Returns \c false if the file cannot be opened.
 
-	\sa scalarColumns(), setJson()
+	\sa isFollowing(), stopFollowing()
+*/
+bool
+JsonTreeModel::followNdjson(const QString& fileName, ScalarColumnSearchMode searchMode)
+{
+	stopFollowing();
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	// NOTE: The last line may still be being written, so it is kept until its newline arrives
+	QByteArray data = file.readAll();
+	const int end = data.lastIndexOf('\n') + 1;
+	resetNdjson(data.left(end), searchMode);
+
+	m_followWatcher = new QFileSystemWatcher(this);
+	m_followWatcher->addPath(fileName);
+	connect(m_followWatcher, &QFileSystemWatcher::fileChanged, this, &JsonTreeModel::readFollowedFile);
+	m_followPath = fileName;
+	m_followOffset = file.pos();
+	m_followTail = data.mid(end);
+	m_followSearchMode = searchMode;
+	return true;
+}
+
+/*!
+	\brief Stops appending the records that are written to the file that was passed to
+	followNdjson(). The rows that were already loaded are kept.
+
+	\sa isFollowing()
 */
 void
-JsonTreeModel::setScalarColumns(const QStringList& columns)
+JsonTreeModel::stopFollowing()
 {
-	// TODO: Check if there's anything in common first, before nuking the whole model?
-	beginResetModel();
-	m_headers = QStringList{m_headers[0], m_headers[1]} << columns;
-	endResetModel();
+	delete m_followWatcher;
+	m_followWatcher = nullptr;
+	m_followPath.clear();
+	m_followOffset = 0;
+	m_followTail.clear();
 }
 
-static QSet<QString>
-findScalarNames(const QJsonValue &data, bool comprehensive)
+/*
+	Parses the complete lines of an NDJSON document in parallel, and returns new nodes (without
+	parents) in the order of the lines. Unless the search mode is NoSearch, the scalar columns are
+	collected while the nodes are created. With projection, they are found before the nodes are
+	created instead, so that they can be used as the projection.
+*/
+QVector<JsonTreeModelNode*>
+JsonTreeModel::parseNdjson(const QByteArray& data, ScalarColumnSearchMode searchMode)
 {
-	auto processArray = [](const QJsonArray& array, bool comprehensive) -> QSet<QString>
+	// NOTE: More chunks than threads balance the load, but every chunk adds some overhead
+	static const int MinChunkBytes = 256 * 1024;
+	const int chunkBytes = qMax(MinChunkBytes, data.size() / (4 * QThread::idealThreadCount()));
+
+	QVector<NdjsonChunk> chunks;
+	const char* const dataEnd = data.constData() + data.size();
+	for (const char* begin = data.constData(); begin < dataEnd; )
+	{
+		const char* end = begin + qMin<qint64>(chunkBytes, dataEnd - begin);
+		auto newline = static_cast<const char*>( std::memchr(end - 1, '\n', dataEnd - end + 1) );
+		end = (newline != nullptr) ? newline + 1 : dataEnd;
+		chunks << NdjsonChunk{begin, end, {}, {}, {}, 0};
+		begin = end;
+	}
+
+	// NOTE: The threads only touch their own chunks, so the vector must not detach while they run
+	NdjsonChunk* const chunkData = chunks.data();
+	const bool comprehensive = (searchMode == ComprehensiveSearch);
+	const bool searchFirst = (searchMode != NoSearch && m_columnProjection);
+	const bool collect = (searchMode != NoSearch && !m_columnProjection);
+
+	// NOTE: Like the quick search of setJson(), a quick search only looks at the first record
+	auto foundColumns = [&chunks, comprehensive]()
 	{
 		QSet<QString> names;
-		for (const auto element : array)
+		for (const auto& chunk : qAsConst(chunks))
 		{
-			if (element.type() == QJsonValue::Object || element.type() == QJsonValue::Array)
-				names += findScalarNames(element, comprehensive);
-
-			if (!comprehensive)
-				break; // Non-comprehensive searches only look at the first array element
+			if (comprehensive)
+				names += chunk.scalarNames;
+			else if (names.isEmpty())
+				names = chunk.scalarNames;
 		}
 		return names;
 	};
 
-	QSet<QString> names;
-	if (data.type() == QJsonValue::Array)
-		names += processArray(data.toArray(), comprehensive);
+	runConcurrently(chunks.count(), [=](int c)
+	{
+		auto& chunk = chunkData[c];
+		for (const char* line = chunk.begin; line < chunk.end; )
+		{
+			auto newline = static_cast<const char*>( std::memchr(line, '\n', chunk.end - line) );
+			const char* lineEnd = (newline != nullptr) ? newline : chunk.end;
+			const QByteArray text = QByteArray::fromRawData(line, lineEnd - line).trimmed();
+			line = lineEnd + 1;
+			if (text.isEmpty())
+				continue;
+
+			QJsonParseError error;
+			const auto document = QJsonDocument::fromJson(text, &error);
+			if (error.error != QJsonParseError::NoError)
+			{
+				++chunk.invalidLines;
+				continue;
+			}
+
+			const QJsonValue record = document.isArray() ? QJsonValue(document.array()) : QJsonValue(document.object());
+			if ( searchFirst && (comprehensive || chunk.records.isEmpty()) )
+				chunk.scalarNames += dataTreeScalarNames(record, comprehensive);
+			chunk.records << record;
+		}
+	});
+
+	if (searchFirst)
+	{
+		m_projectedColumns = foundColumns();
+		setFoundColumns(m_projectedColumns);
+	}
 
-	else if (data.type() == QJsonValue::Object)
+	const QSet<QString>* columns = projection();
+	runConcurrently(chunks.count(), [=](int c)
 	{
-		auto dataObj = data.toObject();
-		for (auto i = dataObj.constBegin(); i != dataObj.constEnd(); ++i)
+		auto& chunk = chunkData[c];
+		DataTreeScalarNameCollector collector(comprehensive);
+		chunk.nodes.reserve(chunk.records.count());
+		for (const auto& record : qAsConst(chunk.records))
 		{
-			const auto value = i.value();
-			if (value.type() == QJsonValue::Array)
-				names += processArray(value.toArray(), comprehensive);
-			else if (value.type() == QJsonValue::Object)
-				names += findScalarNames(value, comprehensive);
+			auto recordCollector = ( collect && (comprehensive || chunk.nodes.isEmpty()) ) ? &collector : nullptr;
+			if (record.isArray())
+				chunk.nodes << new JsonTreeModelListNode(record.toArray(), nullptr, columns, recordCollector);
 			else
-				names += i.key(); // This is a scalar
+				chunk.nodes << new JsonTreeModelNamedListNode(record.toObject(), nullptr, columns, recordCollector);
 		}
+		chunk.records.clear(); // NOTE: The values are no longer needed, so they can be freed early
+		if (collect)
+			chunk.scalarNames = collector.names;
+	});
+
+	if (collect)
+	{
+		m_projectedColumns = foundColumns();
+		setFoundColumns(m_projectedColumns);
 	}
-	return names;
+
+	QVector<JsonTreeModelNode*> nodes;
+	int invalidLines = 0;
+	for (const auto& chunk : qAsConst(chunks))
+	{
+		nodes += chunk.nodes;
+		invalidLines += chunk.invalidLines;
+	}
+	if (invalidLines > 0)
+		qWarning("JsonTreeModel: Skipped %d invalid NDJSON line(s)", invalidLines);
+	return nodes;
 }
 
-/*!
-	Returns \e true if the data under the given \a index is editable.
+/*
+	Replaces the model's data with a top-level array of the records in the given NDJSON data.
+*/
+void
+JsonTreeModel::resetNdjson(const QByteArray& data, ScalarColumnSearchMode searchMode)
+{
+	beginResetModel();
 
-	Only scalar elements of JSON arrays or scalar members of JSON objects are editable.
+	// NOTE: The old nodes are freed first, to lower the peak memory usage
+	resetDocumentState();
+
+	const auto records = parseNdjson(data, searchMode);
+	m_rootNode = new JsonTreeModelListNode(nullptr);
+	m_rootNode->appendChildren(records);
+	encodeStrings(m_rootNode);
+	shareIdenticalSubtrees();
+	resetPaging(true);
+	endResetModel();
+}
+
+/*
+	Reads the complete lines that were appended to the followed file since it was last read.
 */
-bool
-JsonTreeModel::isEditable(const QModelIndex& index) const
+void
+JsonTreeModel::readFollowedFile()
 {
-	if (!index.isValid())
-		return false;
+	// NOTE: Rows can only be appended to a top-level array, which patches can replace
+	if (m_rootNode == nullptr || m_rootNode->type() != JsonTreeModelNode::Array || m_rootNode->isWrapper())
+	{
+		stopFollowing();
+		return;
+	}
 
-	// TODO: Allow changing an Object's member names
-	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
-	return !(  node->type() == JsonTreeModelNode::Array
-			|| ( node->type() == JsonTreeModelNode::Scalar && index.column() != 1 )
-			|| ( node->type() == JsonTreeModelNode::Object && index.column() <= 1 )  );
+	// NOTE: Files that are replaced (e.g. by log rotation) are no longer watched
+	if (!m_followWatcher->files().contains(m_followPath))
+		m_followWatcher->addPath(m_followPath);
+
+	QFile file(m_followPath);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+
+	const bool restart = (file.size() < m_followOffset);
+	if (restart)
+	{
+		m_followOffset = 0;
+		m_followTail.clear();
+	}
+	if (!file.seek(m_followOffset))
+		return;
+
+	QByteArray data = m_followTail + file.readAll();
+	m_followOffset = file.pos();
+
+	// NOTE: The last line may still be being written, so it is kept until its newline arrives
+	const int end = data.lastIndexOf('\n') + 1;
+	m_followTail = data.mid(end);
+	data.truncate(end);
+
+	// The scalar columns are found when the first records arrive
+	if ( restart || (m_rootNode->childCount() == 0 && !data.isEmpty()) )
+	{
+		resetNdjson(data, m_followSearchMode);
+		return;
+	}
+	if (data.isEmpty())
+		return;
+
+	const auto records = parseNdjson(data, NoSearch);
+	if (records.isEmpty())
+		return;
+
+	const int first = m_rootNode->childCount();
+	beginInsertRows(QModelIndex(), first, first + records.count() - 1);
+	m_rootNode->appendChildren(records);
+	for (auto record : records)
+	{
+		encodeStrings(record);
+		indexRowKey(m_rootNode, record);
+		accountResidentBytes(record, 1);
+	}
+	m_rootNode->invalidateCachedHash();
+	invalidateReadCache();
+	endInsertRows();
+	extendBranchColumns(m_rootNode, first, first + records.count() - 1);
+}
+
+/*
+	Appends text to an export buffer as UTF-8. CSV fields are quoted if needed, and TSV fields
+	are escaped, because TSV fields cannot contain tabs or line breaks.
+*/
+static void
+appendDelimitedText(QByteArray& buffer, const QString& text, bool tabSeparated)
+{
+	const ushort* units = text.utf16();
+	const int count = text.size();
+
+	bool isQuoted = false;
+	if (!tabSeparated)
+	{
+		for (int i = 0; i < count && !isQuoted; ++i)
+			isQuoted = (units[i] == ',' || units[i] == '"' || units[i] == '\r' || units[i] == '\n');
+		if (isQuoted)
+			buffer.append('"');
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		uint c = units[i];
+		if (c < 0x80)
+		{
+			if (isQuoted && c == '"')
+				buffer.append('"');
+			else if (tabSeparated && (c == '\t' || c == '\n' || c == '\r' || c == '\\'))
+			{
+				buffer.append('\\');
+				c = (c == '\t') ? 't' : (c == '\n') ? 'n' : (c == '\r') ? 'r' : '\\';
+			}
+			buffer.append(static_cast<char>(c));
+			continue;
+		}
+
+		if (c >= 0xD800 && c < 0xE000)
+		{
+			// NOTE: A lone surrogate cannot be encoded, so it is replaced
+			if (c < 0xDC00 && i + 1 < count && units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000)
+				c = 0x10000 + ((c - 0xD800) << 10) + (units[++i] - 0xDC00);
+			else
+				c = 0xFFFD;
+		}
+
+		if (c < 0x800)
+		{
+			buffer.append(static_cast<char>(0xC0 | (c >> 6)));
+		}
+		else if (c < 0x10000)
+		{
+			buffer.append(static_cast<char>(0xE0 | (c >> 12)));
+			buffer.append(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+		}
+		else
+		{
+			buffer.append(static_cast<char>(0xF0 | (c >> 18)));
+			buffer.append(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+			buffer.append(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+		}
+		buffer.append(static_cast<char>(0x80 | (c & 0x3F)));
+	}
+
+	if (isQuoted)
+		buffer.append('"');
+}
+
+/*
+	Appends a number to an export buffer. Integers are written without an exponent, and other
+	numbers with the fewest digits that still read back as the same double.
+*/
+static void
+appendDelimitedNumber(QByteArray& buffer, double value)
+{
+	char digits[32];
+	if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) // 2^53
+		std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+	else
+	{
+		std::snprintf(digits, sizeof(digits), "%.15g", value);
+		if (std::strtod(digits, nullptr) != value)
+			std::snprintf(digits, sizeof(digits), "%.17g", value);
+	}
+	buffer.append(digits);
+}
+
+static void
+appendDelimitedValue(QByteArray& buffer, const QJsonValue& value, bool tabSeparated)
+{
+	switch (value.type())
+	{
+	case QJsonValue::Bool: buffer.append(value.toBool() ? "true" : "false"); break;
+	case QJsonValue::Double: appendDelimitedNumber(buffer, value.toDouble()); break;
+	case QJsonValue::String: appendDelimitedText(buffer, value.toString(), tabSeparated); break;
+	default: break; // NOTE: Nulls and missing members are empty fields
+	}
+}
+
+/*
+	Appends a string to a preview as a quoted, escaped JSON string. Only the first maxLength
+	characters are written.
+*/
+static void
+appendPreviewString(QByteArray& buffer, const QString& text, int maxLength)
+{
+	const int count = qMin(text.size(), qMax(0, maxLength));
+	buffer.append('"');
+
+	int start = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		const ushort c = text.at(i).unicode();
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		buffer.append( text.midRef(start, i - start).toUtf8() );
+		start = i + 1;
+		switch (c)
+		{
+		case '"':  buffer.append("\\\""); break;
+		case '\\': buffer.append("\\\\"); break;
+		case '\b': buffer.append("\\b"); break;
+		case '\f': buffer.append("\\f"); break;
+		case '\n': buffer.append("\\n"); break;
+		case '\r': buffer.append("\\r"); break;
+		case '\t': buffer.append("\\t"); break;
+		default:
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			buffer.append(escaped);
+		}
+	}
+	buffer.append( text.midRef(start, count - start).toUtf8() );
+	buffer.append('"');
+}
+
+static void
+appendPreviewScalar(QByteArray& buffer, const QJsonValue& value, int maxBytes)
+{
+	switch (value.type())
+	{
+	case QJsonValue::Bool: buffer.append(value.toBool() ? "true" : "false"); break;
+	case QJsonValue::Double:
+		if (std::isfinite(value.toDouble()))
+			appendDelimitedNumber(buffer, value.toDouble());
+		else
+			buffer.append("null"); // NOTE: Like QJsonDocument, which has no notation for infinities and NaNs
+		break;
+
+	// NOTE: Every character takes at least one byte, so a longer string would be truncated anyway
+	case QJsonValue::String: appendPreviewString(buffer, value.toString(), qMax(0, maxBytes - buffer.size() + 1)); break;
+	case QJsonValue::Null: buffer.append("null"); break;
+	default: break;
+	}
+}
+
+/*
+	Appends a pretty-printed node to a preview. Returns false as soon as the preview is longer
+	than maxBytes, so that the rest of the node is never visited.
+*/
+static bool
+appendPreviewNode(QByteArray& buffer, const JsonTreeModelNode* node, int level, int maxBytes, int maxDepth)
+{
+	if (node->type() == JsonTreeModelNode::Scalar)
+	{
+		appendPreviewScalar(buffer, static_cast<const JsonTreeModelScalarNode*>(node)->value(), maxBytes);
+		return buffer.size() <= maxBytes;
+	}
+
+	const bool isObject = (node->type() == JsonTreeModelNode::Object);
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+	const bool isEmpty = (listNode->childCount() == 0) && (!isObject || namedNode->namedScalarCount() == 0);
+	if (isEmpty || level > maxDepth)
+	{
+		buffer.append(isObject ? (isEmpty ? "{}" : "{...}") : (isEmpty ? "[]" : "[...]"));
+		return buffer.size() <= maxBytes;
+	}
+
+	// NOTE: The budget is checked before each value, so that nothing more is written once it is used up
+	const QByteArray indent((level + 1) * 4, ' ');
+	buffer.append(isObject ? "{\n" : "[\n");
+	if (!isObject)
+	{
+		for (int i = 0; i < listNode->childCount(); ++i)
+		{
+			if (i > 0)
+				buffer.append(",\n");
+			buffer.append(indent);
+			if (buffer.size() > maxBytes)
+				return false;
+			if ( !appendPreviewNode(buffer, listNode->childAt(i), level + 1, maxBytes, maxDepth) )
+				return false;
+		}
+	}
+	else
+	{
+		// NOTE: The named scalars and the non-scalar members are both sorted by name, so they are merged like QJsonObject's members
+		const auto& scalars = namedNode->namedScalars();
+		auto scalar = scalars.constBegin();
+		int childRow = 0;
+		for (bool first = true; scalar != scalars.constEnd() || childRow < listNode->childCount(); first = false)
+		{
+			JsonTreeModelNode* child = (childRow < listNode->childCount()) ? listNode->childAt(childRow) : nullptr;
+			const QString childName = (child != nullptr) ? namedNode->childListNodeName(child) : QString();
+			const bool takeScalar = (scalar != scalars.constEnd()) && (child == nullptr || scalar.key() < childName);
+
+			if (!first)
+				buffer.append(",\n");
+			buffer.append(indent);
+			if (buffer.size() > maxBytes)
+				return false;
+			appendPreviewString(buffer, takeScalar ? scalar.key() : childName, qMax(0, maxBytes - buffer.size() + 1));
+			buffer.append(": ");
+			if (buffer.size() > maxBytes)
+				return false;
+			if (takeScalar)
+			{
+				appendPreviewScalar(buffer, scalar.value(), maxBytes);
+				++scalar;
+				if (buffer.size() > maxBytes)
+					return false;
+			}
+			else
+			{
+				++childRow;
+				if ( !appendPreviewNode(buffer, child, level + 1, maxBytes, maxDepth) )
+					return false;
+			}
+		}
+	}
+	buffer.append('\n');
+	buffer.append(indent.constData(), level * 4);
+	buffer.append(isObject ? '}' : ']');
+	return buffer.size() <= maxBytes;
+}
+
+/*!
+	\brief Returns a pretty-printed, UTF-8 encoded JSON preview of the value at the given \a index.
+
+	Unlike serializing json(), this writes the preview straight from the model's nodes and stops
+	as soon as the preview is longer than \a maxBytes, so its cost depends on the size of the
+	preview rather than the size of the value. A preview that was cut short ends with a line that
+	contains \c{... (truncated)}. Arrays and objects that are nested more than \a maxDepth levels
+	below the \a index are abbreviated as \c{[...]} and \c{{...}}.
+
+	The preview is meant for display; it is only valid JSON if it was neither cut short nor
+	abbreviated. The members of objects are written in alphabetical order, and the indentation
+	matches QJsonDocument::Indented.
+
+	\sa json()
+*/
+QByteArray
+JsonTreeModel::preview(const QModelIndex& index, int maxBytes, int maxDepth) const
+{
+	QByteArray buffer;
+	bool complete = true;
+	if (index.isValid() && index.column() > 0)
+		appendPreviewScalar(buffer, json(index), maxBytes);
+	else
+	{
+		auto node = index.isValid() ? static_cast<const JsonTreeModelNode*>(index.internalPointer()) : documentNode();
+		if (node != nullptr)
+			complete = appendPreviewNode(buffer, node, 0, maxBytes, maxDepth);
+	}
+
+	if (!complete || buffer.size() > maxBytes)
+	{
+		// NOTE: Don't cut a UTF-8 sequence in half
+		int size = qMax(0, maxBytes);
+		while ( size > 0 && (static_cast<uchar>(buffer.at(size)) & 0xC0) == 0x80 )
+			--size;
+		buffer.truncate(size);
+		buffer.append("\n... (truncated)\n");
+	}
+	return buffer;
+}
+
+/*!
+	\brief Writes the rows under the given \a parent to \a device as comma-separated values.
+
+	Each row contains the given \a columns (all columns if \a columns is empty), formatted like
+	the cells of a table view: column 0 contains the array index or member name, column 1 the
+	scalar elements of arrays, and the named scalar columns the scalar members of objects.
+	Only the rows from \a firstRow to \a lastRow (the last row if \a lastRow is -1) are written.
+
+	The following \a options are supported:
+
+	- \c TabSeparated writes tab-separated values instead. Tabs, line breaks and backslashes
+	  within fields are escaped as \c \\t, \c \\n, \c \\r and \c \\\\.
+	- \c OmitHeader leaves out the first line, which contains the names of the columns.
+	- \c Recursive also writes the descendants of each row, right after the row, in the order
+	  that an expanded tree view shows them.
+
+	The nodes are read directly, without creating a QVariant for each cell, and the text is
+	formatted into a buffer that is written out in blocks of 64 KiB. The memory use does not
+	depend on the number of rows. CSV fields are quoted as described in RFC 4180.
+
+	In branch column mode, the \a columns are those of the rows under \a parent, and the
+	descendants of the rows are written under the columns with the same names.
+
+	Returns \c false if the \a device is not writable, a column does not exist, or a write fails.
+
+	\sa headerData(), scalarColumns()
+*/
+bool
+JsonTreeModel::exportDelimited(QIODevice* device, const QModelIndex& parent, const QVector<int>& columns, ExportOptions options, int firstRow, int lastRow) const
+{
+	if (device == nullptr || !device->isWritable())
+		return false;
+
+	// NOTE: In branch column mode, the descendants of the rows are matched by the names of these columns
+	auto parentNode = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : m_rootNode;
+	const QStringList headers = columnsFor(parentNode);
+
+	QVector<int> exportedColumns = columns;
+	if (exportedColumns.isEmpty())
+	{
+		for (int column = 0; column < headers.count(); ++column)
+			exportedColumns << column;
+	}
+	for (int column : qAsConst(exportedColumns))
+	{
+		if (column < 0 || column >= headers.count())
+			return false;
+	}
+
+	const bool tabSeparated = options.testFlag(TabSeparated);
+	const char delimiter = tabSeparated ? '\t' : ',';
+	const char* const lineEnd = tabSeparated ? "\n" : "\r\n";
+	const int blockSize = 64 * 1024;
+
+	QByteArray buffer;
+	buffer.reserve(2 * blockSize); // NOTE: A reserved buffer keeps its capacity when it is emptied
+
+	if (!options.testFlag(OmitHeader))
+	{
+		for (int i = 0; i < exportedColumns.count(); ++i)
+		{
+			if (i > 0)
+				buffer.append(delimiter);
+			appendDelimitedText(buffer, headers[exportedColumns[i]], tabSeparated);
+		}
+		buffer.append(lineEnd);
+	}
+
+	if (parentNode != nullptr && parentNode->type() != JsonTreeModelNode::Scalar)
+	{
+		auto parentListNode = static_cast<const JsonTreeModelListNode*>(parentNode);
+		const int endRow = (lastRow < 0) ? parentListNode->childCount() : qMin(lastRow + 1, parentListNode->childCount());
+
+		// Depth-first, with the next row of each level on the stack
+		QVector<QPair<const JsonTreeModelListNode*, int>> stack{qMakePair(parentListNode, qMax(0, firstRow))};
+		while (!stack.isEmpty())
+		{
+			const auto listNode = stack.last().first;
+			const int row = stack.last().second;
+			if ( row >= ((stack.count() == 1) ? endRow : listNode->childCount()) )
+			{
+				stack.removeLast();
+				continue;
+			}
+			++stack.last().second;
+
+			auto node = listNode->childAt(row);
+			for (int i = 0; i < exportedColumns.count(); ++i)
+			{
+				if (i > 0)
+					buffer.append(delimiter);
+
+				const int column = exportedColumns[i];
+				if (column == 0)
+				{
+					if (listNode->type() == JsonTreeModelNode::Array)
+						appendDelimitedNumber(buffer, row);
+					else
+						appendDelimitedText(buffer, static_cast<const JsonTreeModelNamedListNode*>(listNode)->childListNodeName(node), tabSeparated);
+				}
+				else if (column == 1)
+				{
+					if (node->type() == JsonTreeModelNode::Scalar)
+						appendDelimitedValue(buffer, static_cast<JsonTreeModelScalarNode*>(node)->value(), tabSeparated);
+				}
+				else if (node->type() == JsonTreeModelNode::Object)
+					appendDelimitedValue(buffer, static_cast<JsonTreeModelNamedListNode*>(node)->namedScalarValue(headers[column]), tabSeparated);
+			}
+			buffer.append(lineEnd);
+
+			if (options.testFlag(Recursive) && node->type() != JsonTreeModelNode::Scalar)
+				stack << qMakePair(static_cast<const JsonTreeModelListNode*>(node), 0);
+
+			if (buffer.size() >= blockSize)
+			{
+				if (device->write(buffer) != buffer.size())
+					return false;
+				buffer.resize(0);
+			}
+		}
+	}
+
+	return device->write(buffer) == buffer.size();
+}
+
+/*!
+	\fn int JsonTreeModel::snapshot
+	\brief Returns the revision number of the model's current data.
+
+	Every edit (e.g. via setData()) creates a new revision. Taking a snapshot is free: it only
+	records where the model is in its undo history. Pass the revision number to restore() to
+	return to this state later.
+
+	setJson() and loadSnapshot() start a new history, so older revisions cannot be restored.
+
+	\sa restore(), setUndoLimit()
+*/
+
+/*!
+	\brief Undoes or redoes edits until the model's data matches the given \a revision.
+
+	Only the cells that change are updated, and the \c dataChanged() signals are merged into as few
+	ranges as possible. Returns \c false if the \a revision is no longer in the undo history, e.g. because it
+	is older than undoLimit() edits, or because it was undone and then replaced by new edits. It also
+	returns \c false if an edit cannot be undone or redone because the undo history does not match
+	the data; the edits before it stay undone or redone.
+
+	To look at an older revision without changing the model, use readSnapshot(int) instead.
+
+	\sa snapshot(), undo(), redo()
+*/
+bool
+JsonTreeModel::restore(int revision)
+{
+	if (revision < m_journalBase || revision > m_journalBase + m_journal.count())
+		return false;
+
+	// NOTE: Like undo() and redo(), this stops at the first edit that does not match the data
+	DirtyCells dirty;
+	bool ok = true;
+	while (ok && snapshot() > revision)
+		ok = stepJournal(false, &dirty);
+	while (ok && snapshot() < revision)
+		ok = stepJournal(true, &dirty);
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return ok;
+}
+
+/*!
+	\fn bool JsonTreeModel::canUndo
+	\brief Returns \c true if there is an edit that undo() can revert.
+*/
+/*!
+	\fn bool JsonTreeModel::canRedo
+	\brief Returns \c true if there is an undone edit that redo() can reapply.
+*/
+
+/*!
+	\brief Reverts the most recent edit. Returns \c false if there is nothing to undo.
+
+	\sa redo(), restore()
+*/
+bool
+JsonTreeModel::undo()
+{
+	if (!canUndo())
+		return false;
+
+	DirtyCells dirty;
+	bool ok = stepJournal(false, &dirty);
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return ok;
+}
+
+/*!
+	\brief Reapplies the most recently undone edit. Returns \c false if there is nothing to redo.
+
+	\sa undo(), restore()
+*/
+bool
+JsonTreeModel::redo()
+{
+	if (!canRedo())
+		return false;
+
+	DirtyCells dirty;
+	bool ok = stepJournal(true, &dirty);
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return ok;
+}
+
+/*!
+	\brief Keeps up to \a limit edits in the undo history.
+
+	The default limit is 0, which disables the undo history. Each kept edit stores the location
+	of the edited value and its old and new values, not a copy of the document.
+
+	\sa undoLimit(), snapshot()
+*/
+void
+JsonTreeModel::setUndoLimit(int limit)
+{
+	m_undoLimit = qMax(0, limit);
+	while (m_journal.count() > m_undoLimit)
+	{
+		if (m_journalPosition > 0)
+		{
+			m_journal.removeFirst();
+			++m_journalBase;
+			--m_journalPosition;
+		}
+		else
+			m_journal.removeLast(); // Only redoable edits are left; drop the newest ones
+	}
+}
+
+/*!
+	\fn int JsonTreeModel::undoLimit
+	\brief Returns the maximum number of edits kept in the undo history.
+
+	\sa setUndoLimit()
+*/
+
+/*!
+	\brief Returns an immutable view of the model's data as it is now.
+
+	The snapshot can be read from any thread while the model keeps changing, because it does
+	not refer to the model's nodes: it holds an immutable, implicitly shared copy of each array
+	and object. The model keeps these copies, and only copies the arrays and objects that
+	changed since the last snapshot was taken. Thus, taking a snapshot after an edit only costs
+	as much as copying the edited array or object and its ancestors, and the snapshots of
+	different revisions share everything else.
+
+	\note The copies are not counted towards the memory budget, and the rows that were paged out
+		  are read back the first time that they are copied.
+
+	\note Like all other functions of the model, readSnapshot() itself must be called from
+		  the model's thread.
+
+	\sa JsonTreeReadSnapshot, json()
+*/
+JsonTreeReadSnapshot
+JsonTreeModel::readSnapshot() const
+{
+	if (!m_readCacheValid)
+	{
+		const auto node = documentNode();
+		m_readCache = (node != nullptr) ? readSnapshotNode(node) : JsonTreeReadSnapshotNodePointer();
+		m_readCacheValid = true;
+	}
+	return JsonTreeReadSnapshot(m_readCache, snapshot());
+}
+
+/*!
+	\brief Returns an immutable view of the model's data as it was at the given \a revision,
+	without changing the model. Returns a null snapshot if the \a revision is not in the undo
+	history.
+
+	Unlike restore(), this neither changes the data nor notifies the views. The view starts from
+	readSnapshot() and replays the undo history on it, so it only copies the arrays and objects
+	that differ between the two revisions, and shares everything else with the current data.
+	Revisions that were undone can be viewed too, until new edits replace them.
+
+	\sa restore(), snapshot()
+*/
+JsonTreeReadSnapshot
+JsonTreeModel::readSnapshot(int revision) const
+{
+	if (revision < m_journalBase || revision > m_journalBase + m_journal.count())
+		return JsonTreeReadSnapshot();
+
+	JsonTreeReadSnapshot view = readSnapshot();
+	bool wrapped = (m_rootNode != nullptr && m_rootNode->isWrapper());
+	for (int position = m_journalPosition; m_journalBase + position != revision; )
+	{
+		const bool forward = (m_journalBase + position < revision);
+		const Edit& edit = m_journal.at(forward ? position++ : --position);
+
+		bool ok;
+		if (!edit.patch.isEmpty())
+			ok = view.applyPatch(forward ? edit.patch : edit.inversePatch, &wrapped);
+		else
+			ok = view.applyScalarEdit(edit.path, edit.column, forward ? edit.newValue : edit.oldValue, wrapped);
+		if (!ok)
+		{
+			qWarning("JsonTreeModel: The undo history does not match the data");
+			return JsonTreeReadSnapshot();
+		}
+	}
+	view.m_revision = revision;
+	return view;
+}
+
+/*
+	Returns the immutable copy of the given array or object. The copy that was made for an
+	earlier snapshot is reused if the node's subtree hash did not change since; edits clear the
+	hashes of the edited node's ancestors, so only the copies along the edited paths are redone.
+*/
+JsonTreeReadSnapshotNodePointer
+JsonTreeModel::readSnapshotNode(const JsonTreeModelListNode* node) const
+{
+	const quint64 hash = subtreeHash(node);
+	auto cached = m_readSnapshotNodes.constFind(node);
+	if (cached != m_readSnapshotNodes.constEnd() && cached->hash == hash)
+		return cached->node;
+
+	JsonTreeReadSnapshotNodePointer copy(new JsonTreeReadSnapshotNode);
+	copy->isObject = (node->type() == JsonTreeModelNode::Object);
+	if (!copy->isObject)
+	{
+		copy->members.resize(node->childCount());
+		for (int i = 0; i < node->childCount(); ++i)
+		{
+			auto child = node->childAt(i);
+			if (child->type() == JsonTreeModelNode::Scalar)
+				copy->members[i].scalar = child->value();
+			else
+				copy->members[i].node = readSnapshotNode(static_cast<const JsonTreeModelListNode*>(child));
+		}
+	}
+	else
+	{
+		// NOTE: The scalars and the child rows are both sorted by name, so they are merged
+		auto object = static_cast<const JsonTreeModelNamedListNode*>(node);
+		const auto& scalars = object->namedScalars();
+		copy->members.reserve(scalars.count() + object->childCount());
+		auto scalar = scalars.constBegin();
+		for (int i = 0; i <= object->childCount(); ++i)
+		{
+			auto child = (i < object->childCount()) ? object->childAt(i) : nullptr;
+			const QString name = (child != nullptr) ? object->childListNodeName(child) : QString();
+			for ( ; scalar != scalars.constEnd() && (child == nullptr || scalar.key() < name); ++scalar)
+				copy->members << JsonTreeReadSnapshotNode::Member{scalar.key(), scalar.value(), JsonTreeReadSnapshotNodePointer()};
+			if (child != nullptr)
+				copy->members << JsonTreeReadSnapshotNode::Member{name, QJsonValue(), readSnapshotNode(static_cast<const JsonTreeModelListNode*>(child))};
+		}
+	}
+
+	m_readSnapshotNodes.insert(node, ReadSnapshotEntry{hash, copy});
+	return copy;
+}
+
+/*
+	Forgets the immutable copies of the given node (unless descendantsOnly is true) and of its
+	descendants. The snapshots that were already taken keep their own references to the copies.
+*/
+void
+JsonTreeModel::forgetReadSnapshotNodes(const JsonTreeModelNode* node, bool descendantsOnly)
+{
+	if (m_readSnapshotNodes.isEmpty() || node->type() == JsonTreeModelNode::Scalar)
+		return;
+
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	if (!descendantsOnly)
+		m_readSnapshotNodes.remove(listNode);
+	if (!listNode->isLoaded())
+		return; // NOTE: Its descendants were forgotten when it was paged out
+
+	for (int i = 0; i < listNode->childCount(); ++i)
+		forgetReadSnapshotNodes(listNode->childAt(i), false);
+}
+
+/*!
+	\brief Returns the JSON Pointers (RFC 6901) of the values that differ between this model's
+	document and the \a other model's document.
+
+	Each pointer refers to this model's document. It names the deepest value that differs: a
+	scalar that was changed, an array element or object member that exists in only one of the
+	documents, or a value whose type changed. Array elements are compared by position, and object
+	members by name.
+
+	Every node caches a 64-bit hash of its contents, which is cleared along the path to the root
+	when the node is edited. Identical subtrees are skipped by comparing their hashes, so after the
+	first comparison, comparing two large documents with few differences only visits the nodes
+	along the changed paths (and their siblings).
+
+	\note The scalar columns are irrelevant: all members are compared, whether they are shown or not.
+
+	\sa applyPatch()
+*/
+QStringList
+JsonTreeModel::diff(const JsonTreeModel& other) const
+{
+	QStringList paths;
+	auto document = documentNode();
+	auto otherDocument = other.documentNode();
+	if (document == nullptr || otherDocument == nullptr)
+	{
+		if (document != otherDocument)
+			paths << QString();
+		return paths;
+	}
+
+	diffNodes(document, otherDocument, QString(), &paths);
+	return paths;
+}
+
+/*!
+	\brief Returns the indexes of the cells that match the given \a query.
+
+	A matching array or object is returned as its cell in column 0, a matching array element
+	that is a scalar as its cell in column 1, and a matching named scalar as its cell in the
+	named scalar column. Matches that have no cell (the top-level array or object, and named
+	scalars that are not in scalarColumns()) are left out; use queryValues() to get them.
+
+	Returns an empty list if the \a query is invalid.
+
+	\sa queryValues(), JsonTreeQuery
+*/
+QModelIndexList
+JsonTreeModel::query(const JsonTreeQuery& query) const
+{
+	QModelIndexList indexes;
+	for (const auto& match : query.evaluate(documentNode(), m_dictionary))
+	{
+		const auto index = nodeIndex(match.node);
+		if (!index.isValid())
+			continue;
+
+		if (!match.scalarName.isNull())
+		{
+			const int column = columnsFor(match.node->parent()).indexOf(match.scalarName, 2);
+			if (column >= 0)
+				indexes << createIndex(index.row(), column, match.node);
+		}
+		else if (match.node->type() == JsonTreeModelNode::Scalar)
+			indexes << createIndex(index.row(), 1, match.node);
+		else
+			indexes << index;
+	}
+	return indexes;
+}
+
+/*!
+	\brief Returns the values that match the given \a query, in document order.
+
+	Unlike query(), this includes every match, whether or not it is shown in a cell.
+
+	\sa query(), JsonTreeQuery
+*/
+QJsonArray
+JsonTreeModel::queryValues(const JsonTreeQuery& query) const
+{
+	QJsonArray values;
+	for (const auto& match : query.evaluate(documentNode(), m_dictionary))
+	{
+		if (match.scalarName.isNull())
+			values << match.node->value();
+		else
+			values << static_cast<JsonTreeModelNamedListNode*>(match.node)->namedScalarValue(match.scalarName);
+	}
+	return values;
+}
+
+/*!
+	\brief Applies a JSON Patch (RFC 6902) to the model's data, and returns \c true if successful.
+
+	The \a patch is an array of operations (\c add, \c remove, \c replace, \c move, \c copy
+	and \c test), which are applied in order. Each operation only updates the nodes along its
+	path, so the cost of a patch depends on the number of operations and the depth of their paths
+	rather than on the size of the document. The views are notified with row insertion, row
+	removal and \c dataChanged() signals for the affected rows and cells only.
+
+	A patch is applied completely or not at all: if any operation fails (e.g. a \c test
+	operation does not match, or a path does not exist), the operations that were already
+	applied are reverted and this function returns \c false. If they cannot be reverted either,
+	the model keeps the partly patched document, and its undo history is cleared because it no
+	longer matches the document.
+
+	\note Replacing the whole document (the empty path), or adding the first scalar member to a
+		  top-level object that has none, resets the model.
+
+	A successful patch is a single step in the undo history.
+
+	\sa setData(), undo()
+*/
+bool
+JsonTreeModel::applyPatch(const QJsonArray& patch)
+{
+	if (m_rootNode == nullptr)
+		return false;
+	if (patch.isEmpty())
+		return true;
+
+	const QVector<int> roles{Qt::DisplayRole, Qt::EditRole};
+	DirtyCells dirty;
+	QJsonArray inverse;
+	if ( !applyPatchOperations(patch, &inverse, dirty) )
+	{
+		// NOTE: The inverse operations of the applied operations are the rollback, so no copy of the document is kept
+		const bool reverted = applyPatchOperations(inverse, nullptr, dirty);
+		notifyDataChanged(dirty, roles);
+		if (!reverted)
+		{
+			qWarning("JsonTreeModel: Failed to revert a partially applied patch; clearing the undo history");
+			clearJournal();
+		}
+		return false;
+	}
+	notifyDataChanged(dirty, roles);
+
+	Edit edit;
+	if (m_undoLimit > 0)
+	{
+		edit.patch = patch;
+		edit.inversePatch = inverse;
+	}
+	appendJournal(edit);
+	return true;
+}
+
+/*
+	Returns a hashable form of a row key. The type is encoded too, so that 1 and "1" are different keys.
+*/
+static QString
+rowKeyString(const QJsonValue& value)
+{
+	switch (value.type())
+	{
+	case QJsonValue::String: return QLatin1Char('s') + value.toString();
+	case QJsonValue::Double: return QLatin1Char('d') + QString::number(value.toDouble(), 'g', 17);
+	case QJsonValue::Bool:   return value.toBool() ? QStringLiteral("t") : QStringLiteral("f");
+	default:                 return QStringLiteral("n");
+	}
+}
+
+/*!
+	\brief Uses the named scalar \a column as the key of the rows under the JSON array at \a parent.
+
+	An invalid \a parent refers to the top-level array. Afterwards, indexForKey() and upsertRow()
+	find a row by its key in constant time. The model keeps the keys up to date as rows are edited,
+	added and removed. Pass an empty \a column to stop indexing the array.
+
+	Returns \c false if \a parent is not an array.
+
+	\note Keys should be unique within an array. If several rows share a key, the one that was
+		  indexed most recently is found.
+
+	\sa rowKey(), indexForKey(), upsertRow()
+*/
+bool
+JsonTreeModel::setRowKey(const QModelIndex& parent, const QString& column)
+{
+	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : documentNode();
+	if (node == nullptr || node->type() != JsonTreeModelNode::Array)
+		return false;
+
+	auto array = static_cast<JsonTreeModelListNode*>(node);
+	if (column.isEmpty())
+	{
+		m_rowKeys.remove(array);
+		return true;
+	}
+
+	auto& keys = m_rowKeys[array];
+	keys.column = column;
+	keys.rows.clear();
+	for (int i = 0; i < array->childCount(); ++i)
+		indexRowKey(array, array->childAt(i));
+	return true;
+}
+
+/*!
+	\brief Returns the name of the named scalar that keys the rows under \a parent, or an empty
+	string if the rows are not keyed.
+
+	\sa setRowKey()
+*/
+QString
+JsonTreeModel::rowKey(const QModelIndex& parent) const
+{
+	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : documentNode();
+	return m_rowKeys.value(static_cast<JsonTreeModelListNode*>(node)).column;
+}
+
+/*!
+	\brief Returns the index (in column 0) of the row under \a parent whose key equals \a key, or
+	an invalid index if there is no such row.
+
+	The rows must have been keyed with setRowKey().
+
+	\sa upsertRow()
+*/
+QModelIndex
+JsonTreeModel::indexForKey(const QModelIndex& parent, const QJsonValue& key) const
+{
+	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : documentNode();
+	auto keys = m_rowKeys.constFind(static_cast<JsonTreeModelListNode*>(node));
+	if (keys == m_rowKeys.constEnd())
+		return QModelIndex();
+
+	auto row = keys.value().rows.value(rowKeyString(key), nullptr);
+	if (row == nullptr)
+		return QModelIndex();
+	return nodeIndex(row);
+}
+
+/*!
+	\brief Updates the row under \a parent that has the same key as \a object, or appends
+	\a object as a new row if there is no such row. Returns the index of the row, or an invalid
+	index if \a object has no key or the rows are not keyed.
+
+	Only the members of \a object are written; other members of an existing row are kept, and
+	members whose values are unchanged are neither signalled nor replaced. Unchanged arrays and
+	objects are found by comparing their hashes, so their rows are kept too. The cost depends on
+	the size of \a object, not on the number of rows. Like a JSON Patch, the update is a single
+	step in the undo history.
+
+	\sa setRowKey(), indexForKey(), applyPatch()
+*/
+QModelIndex
+JsonTreeModel::upsertRow(const QModelIndex& parent, const QJsonObject& object)
+{
+	auto node = parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : documentNode();
+	auto keys = m_rowKeys.constFind(static_cast<JsonTreeModelListNode*>(node));
+	if ( keys == m_rowKeys.constEnd() || !object.contains(keys.value().column) )
+		return QModelIndex();
+
+	const QJsonValue key = object.value(keys.value().column);
+	auto row = keys.value().rows.value(rowKeyString(key), nullptr);
+	auto array = static_cast<JsonTreeModelListNode*>(node);
+	invalidateReadCache();
+
+	// NOTE: The row is written directly rather than through applyPatch(), so only the operations are built for the journal
+	DirtyCells dirty;
+	Edit edit;
+	if (row == nullptr)
+	{
+		const int newRow = array->childCount();
+		array->invalidateCachedHash();
+		insertElement(array, newRow, object, dirty);
+		if (m_undoLimit > 0)
+		{
+			const QString arrayPointer = nodePointer(array);
+			edit.patch << QJsonObject{{"op", "add"}, {"path", arrayPointer + "/-"}, {"value", object}};
+			edit.inversePatch << QJsonObject{{"op", "remove"}, {"path", arrayPointer + '/' + QString::number(newRow)}};
+		}
+		appendJournal(edit);
+		return nodeIndex(array->childAt(newRow));
+	}
+
+	const QString rowPointer = nodePointer(row);
+	auto namedRow = static_cast<JsonTreeModelNamedListNode*>(row);
+	const auto& scalars = namedRow->namedScalars();
+	bool changed = false;
+	QVector<QJsonObject> inverseOperations;
+	for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+	{
+		if (JsonTreeModelNode::Traits::isScalar(i.value()))
+		{
+			auto oldScalar = scalars.constFind(i.key());
+			if (oldScalar != scalars.constEnd() && oldScalar.value() == i.value())
+				continue;
+		}
+		else
+		{
+			// NOTE: Arrays and objects are compared by hash, so unchanged ones keep their rows
+			auto child = namedRow->namedChild(i.key());
+			if ( child != nullptr && subtreeHash(child) == valueHash(i.value()) )
+				continue;
+		}
+
+		QString token = i.key();
+		const QString path = rowPointer + '/' + token.replace('~', QLatin1String("~0")).replace('/', QLatin1String("~1"));
+		QJsonObject inverse;
+		addMember(namedRow, path, i.key(), i.value(), false, &inverse, dirty);
+		changed = true;
+		if (m_undoLimit > 0)
+		{
+			edit.patch << QJsonObject{{"op", "add"}, {"path", path}, {"value", i.value()}};
+			inverseOperations << inverse;
+		}
+	}
+	notifyDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+
+	// NOTE: Like a patch, the update is a single revision
+	if (changed)
+	{
+		for (int i = inverseOperations.count() - 1; i >= 0; --i)
+			edit.inversePatch.append(inverseOperations[i]);
+		appendJournal(edit);
+	}
+	return nodeIndex(row);
+}
+
+/*!
+	\brief Limits the memory that the model's nodes may use to roughly the given number of \a bytes.
+
+	When the model's residentBytes() exceed the budget, the rows under collapsed arrays and objects
+	that have not been used for the longest time are written to a temporary file and freed. They
+	are read back transparently when index() (or anything that calls it, like a view or data())
+	reaches them again; rowCount() does not need to read them back. Rows are never evicted while
+	they (or their descendants) are referred to by persistent indexes, are expanded in a
+	JsonTreeFlatModel, are shown by a filtered JsonTreeFilterModel, or are part of a keyed array.
+
+	Evictions are deferred to the event loop, so the budget can be exceeded temporarily. A
+	\a bytes value of 0 (the default) disables the budget.
+
+	\sa memoryBudget(), residentBytes(), trimMemory(), setPageCompression()
+*/
+void
+JsonTreeModel::setMemoryBudget(qint64 bytes)
+{
+	m_memoryBudget = qMax(Q_INT64_C(0), bytes);
+	resetPaging(false);
+	scheduleTrim();
+}
+
+/*!
+	\fn qint64 JsonTreeModel::memoryBudget
+	\brief Returns the memory budget in bytes, or 0 if there is no budget.
+
+	\sa setMemoryBudget()
+*/
+
+/*!
+	\fn qint64 JsonTreeModel::residentBytes
+	\brief Returns an estimate of the memory used by the nodes that are in memory.
+
+	The estimate is only kept while a memory budget is set; otherwise, this function returns 0.
+
+	\sa setMemoryBudget()
+*/
+
+/*!
+	\fn void JsonTreeModel::setPageCompression
+	\brief Enables or disables the compression of evicted rows in memory.
+
+	By default, the rows that are evicted to stay within the memory budget are written to a
+	temporary file. With compression enabled, they are compressed with qCompress() and kept in
+	memory instead, for systems that have spare CPU time but no disk to page to. They are
+	decompressed transparently when they are reached again. The compressed pages count towards
+	residentBytes(), so the rows are still chosen by when they were last used, and the budget
+	still applies.
+
+	The setting applies to the rows that are evicted afterwards. Compression is disabled by
+	default.
+
+	\sa pageCompression(), compressionStatistics(), setMemoryBudget()
+*/
+
+/*!
+	\fn bool JsonTreeModel::pageCompression
+	\brief Returns \c true if evicted rows are compressed in memory instead of written to a file.
+
+	\sa setPageCompression()
+*/
+
+/*!
+	\fn JsonTreeModel::CompressionStatistics JsonTreeModel::compressionStatistics
+	\brief Returns the number and sizes of the pages that were compressed, and the number of
+	pages that were decompressed and the time that it took, since the model was created or
+	resetCompressionStatistics() was last called.
+
+	CompressionStatistics::ratio() is the total size of the compressed pages before compression,
+	divided by their total size after compression.
+
+	\sa setPageCompression()
+*/
+
+/*!
+	\fn void JsonTreeModel::resetCompressionStatistics
+	\brief Sets all compressionStatistics() back to 0.
+*/
+
+/*!
+	\brief Evicts the least recently used rows until the model is well within its memory budget.
+
+	This is called automatically after the budget is exceeded. Evicting more than necessary
+	leaves room for the next rows to be read back without another eviction.
+
+	\sa setMemoryBudget()
+*/
+void
+JsonTreeModel::trimMemory()
+{
+	m_trimScheduled = false;
+	auto document = documentNode();
+	if (m_memoryBudget <= 0 || document == nullptr)
+		return;
+
+	// NOTE: Pending notifications refer to nodes, which may be evicted
+	flushChanges();
+
+	QVector<const JsonTreeModelNode*> referencedNodes;
+	for (const auto& index : persistentIndexList())
+		referencedNodes << static_cast<JsonTreeModelNode*>(index.internalPointer());
+	for (const auto& pinner : qAsConst(m_nodePinners))
+		pinner(&referencedNodes);
+
+	QSet<const JsonTreeModelNode*> pinned;
+	for (auto referencedNode : qAsConst(referencedNodes))
+	{
+		for (auto node = referencedNode; node != nullptr && !pinned.contains(node); node = node->parent())
+			pinned.insert(node);
+	}
+
+	// Re-estimate the resident bytes and collect every list node whose rows are in memory
+	struct Candidate
+	{
+		quint64 stamp;
+		int depth;
+		JsonTreeModelListNode* node;
+	};
+	QVector<Candidate> candidates;
+	QVector<QPair<JsonTreeModelListNode*, int>> stack{qMakePair(document, 0)};
+	QHash<const JsonTreeModelListNode*, quint64> stamps;
+	m_residentBytes = residentEstimate(m_rootNode) + m_compressedBytes;
+	while (!stack.isEmpty())
+	{
+		const auto entry = stack.takeLast();
+		auto node = entry.first;
+		if (!node->isLoaded() || node->childCount() == 0)
+			continue;
+
+		const quint64 stamp = m_pageStamps.value(node, 0);
+		if (stamp > 0)
+			stamps.insert(node, stamp);
+		if (node != document && stamp < m_pageClock)
+			candidates << Candidate{stamp, entry.second, node};
+
+		for (int i = 0; i < node->childCount(); ++i)
+		{
+			auto child = node->childAt(i);
+			if (child->type() != JsonTreeModelNode::Scalar)
+				stack << qMakePair(static_cast<JsonTreeModelListNode*>(child), entry.second + 1);
+		}
+	}
+	m_pageStamps.swap(stamps); // NOTE: Also drops the stamps of deleted nodes
+
+	// NOTE: Using a node also uses its ancestors, so a node's descendants are never more recent than
+	// the node itself. Sorting deeper nodes first ensures that they are evicted before their ancestors
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		return a.stamp != b.stamp ? a.stamp < b.stamp : a.depth > b.depth;
+	});
+	++m_pageClock;
+
+	const qint64 target = m_memoryBudget - m_memoryBudget / 4;
+	for (const auto& candidate : candidates)
+	{
+		if (m_residentBytes <= target)
+			break;
+		evictPage(candidate.node, pinned);
+	}
+}
+
+/*!
+	\fn QStringList JsonTreeModel::scalarColumns
+	\brief Returns the names of the JSON objects' scalar members that are shown by the model.
+
+	\sa setScalarColumns()
+*/
+
+/*!
+	\brief Sets the JSON objects' scalar members that are shown by the model.
+
+	The model's \e named \e scalar \e columns are set to the list of specified \a columns, in the
+	listed order.
+
+	If a scalar member of a JSON object is named after one of these columns, it is shown under that
+	column. Otherwise, the member is hidden.
+
+	\sa scalarColumns(), setJson()
+*/
+void
+JsonTreeModel::setScalarColumns(const QStringList& columns)
+{
+	// TODO: Check if there's anything in common first, before nuking the whole model?
+	beginResetModel();
+	discardPendingChanges(); // NOTE: The reset updates every cell anyway
+	m_headers = QStringList{m_headers[0], m_headers[1]} << columns;
+	endResetModel();
+}
+
+/*!
+	\fn void JsonTreeModel::setColumnProjection
+	\brief Enables or disables column projection for the next call to setJson().
+
+	With projection enabled, the nodes of JSON objects only store the scalar members that are in
+	scalarColumns() when the document is set (with \c NoSearch, these are the columns set via
+	setScalarColumns()). The other scalar members stay in the source document, which the nodes
+	refer to, so json() still returns the whole document. This greatly reduces the memory use
+	and loading time of wide objects of which only a few members are shown.
+
+	Members that were left out are still found by data() if their columns are added later, but
+	they are slower to look up. Queries read them without copying them. Editing a member that
+	was left out (or comparing or saving the object) copies the object's remaining scalars into
+	its node.
+
+	Projection is disabled by default. It does not apply to loadSnapshot().
+
+	\sa columnProjection(), setScalarColumns()
+*/
+
+/*!
+	\fn bool JsonTreeModel::columnProjection
+	\brief Returns \c true if setJson() only stores the scalar members that are in scalarColumns().
+
+	\sa setColumnProjection()
+*/
+
+/*!
+	\brief Enables or disables branch column mode.
+
+	By default, every row has the same named scalar columns, namely scalarColumns(). In documents
+	that contain objects of many different shapes, most of these columns are empty for most rows.
+	In branch column mode, the rows under each array or object only have the named scalar columns
+	that at least one of those rows has a member for, in alphabetical order. columnCount() then
+	depends on the parent, so views only lay out and query the columns that are relevant.
+
+	The columns of a parent are found the first time they are needed. Members that are added
+	later (e.g. by applyPatch()) add columns at the end, but columns are not removed until the
+	document is replaced. The columns are found without loading rows that are deferred (by
+	loadSnapshot() or setMemoryBudget()), and without materializing the members that column
+	projection left out.
+
+	Changing the mode resets the model. JsonTreeFlatModel always shows scalarColumns().
+
+	\sa branchColumns(), scalarColumns(const QModelIndex&) const
+*/
+void
+JsonTreeModel::setBranchColumns(bool enabled)
+{
+	if (enabled == m_branchColumns)
+		return;
+
+	beginResetModel();
+	discardPendingChanges(); // NOTE: The reset updates every cell anyway
+	m_branchColumns = enabled;
+	m_branchColumnCache.clear();
+	endResetModel();
+}
+
+/*!
+	\fn bool JsonTreeModel::branchColumns
+	\brief Returns \c true if the named scalar columns are found separately for each parent.
+
+	\sa setBranchColumns()
+*/
+
+/*!
+	\brief Returns the names of the named scalar columns of the rows under the given \a parent.
+
+	These are the same as scalarColumns(), unless branchColumns() is enabled.
+*/
+QStringList
+JsonTreeModel::scalarColumns(const QModelIndex& parent) const
+{
+	return columnsFor( parent.isValid() ? static_cast<JsonTreeModelNode*>(parent.internalPointer()) : m_rootNode ).mid(2);
+}
+
+/*!
+	\brief Enables dictionary encoding of string values if \a maxCardinality is greater than 0,
+	or disables it otherwise.
+
+	Enum-like string members (such as \c "Country") often repeat across many rows. With dictionary
+	encoding, each named scalar column (and the elements of arrays) gets a JsonTreeStringDictionary
+	of its distinct strings, and every stored occurrence shares the dictionary's copy instead of
+	holding its own. Equal strings are then recognized by their shared data, e.g. by query()
+	filters.
+
+	A column that has more than \a maxCardinality distinct strings falls back to plain storage.
+	The current document is encoded straight away, and the documents and values that are set
+	later are encoded as they are stored. Disabling the encoding leaves the stored values as they
+	are. It is disabled by default.
+
+	\sa dictionaryEncoding()
+*/
+void
+JsonTreeModel::setDictionaryEncoding(int maxCardinality)
+{
+	delete m_dictionary;
+	m_dictionary = (maxCardinality > 0) ? new JsonTreeStringDictionary(maxCardinality) : nullptr;
+	encodeStrings(m_rootNode);
+}
+
+/*!
+	\brief Returns the highest number of distinct strings that a column can have while its strings
+	are deduplicated, or 0 if dictionary encoding is disabled.
+
+	\sa setDictionaryEncoding()
+*/
+int
+JsonTreeModel::dictionaryEncoding() const
+{
+	return (m_dictionary != nullptr) ? m_dictionary->maxCardinality() : 0;
+}
+
+/*!
+	\fn void JsonTreeModel::setSubtreeSharing
+	\brief Enables or disables subtree sharing for the next call to setJson() or loadNdjson().
+
+	Generated documents often repeat the same array or object many times (e.g. a calibration
+	block that is copied into every record). With sharing enabled, only the first occurrence of
+	each repeated subtree is stored as nodes. Every other occurrence keeps its own row, but
+	shares the first one's scalars, and its rows are only created from one shared copy of its
+	contents when they are first accessed. The memory used by a document then drops roughly by
+	the factor by which its subtrees are repeated.
+
+	Sharing is transparent: a shared subtree is copied as soon as it is edited or its rows are
+	accessed, so its copies never change together. Queries and comparisons access the rows of
+	every shared subtree that they visit.
+
+	Sharing is disabled by default. It does not apply to loadSnapshot().
+
+	\sa subtreeSharing(), setColumnProjection()
+*/
+
+/*!
+	\fn bool JsonTreeModel::subtreeSharing
+	\brief Returns \c true if setJson() and loadNdjson() share the storage of repeated subtrees.
+
+	\sa setSubtreeSharing()
+*/
+
+/*
+	Finds the arrays and objects that are identical to an earlier one in the document, and
+	shares the earlier one's contents with them. The document is visited in order from the top,
+	so the largest repeated subtrees are shared as a whole.
+*/
+void
+JsonTreeModel::shareIdenticalSubtrees()
+{
+	if (!m_subtreeSharing || m_rootNode == nullptr)
+		return;
+
+	QHash<quint64, QVector<const JsonTreeModelListNode*>> originals;
+	QHash<const JsonTreeModelListNode*, QByteArray> pages;
+	QVector<JsonTreeModelListNode*> stack;
+
+	// NOTE: The root node is never repeated; its children are pushed in reverse, so that they are visited in order
+	auto pushChildren = [&stack](JsonTreeModelListNode* node)
+	{
+		for (int i = node->childCount() - 1; i >= 0; --i)
+		{
+			auto child = node->childAt(i);
+			if (child->type() != JsonTreeModelNode::Scalar)
+				stack << static_cast<JsonTreeModelListNode*>(child);
+		}
+	};
+	pushChildren(m_rootNode);
+
+	while (!stack.isEmpty())
+	{
+		auto node = stack.takeLast();
+		const bool hasScalars = (node->type() == JsonTreeModelNode::Object)
+				&& static_cast<JsonTreeModelNamedListNode*>(node)->namedScalarCount() > 0;
+		if (node->childCount() == 0 && !hasScalars)
+			continue; // NOTE: Nothing to share
+
+		const quint64 hash = subtreeHash(node);
+		auto& candidates = originals[hash];
+		const JsonTreeModelListNode* original = nullptr;
+		for (auto candidate : candidates)
+		{
+			if (identicalSubtrees(candidate, node))
+			{
+				original = candidate;
+				break;
+			}
+		}
+		if (original == nullptr)
+		{
+			candidates << node;
+			pushChildren(node);
+			continue;
+		}
+
+		if (hasScalars)
+		{
+			static_cast<JsonTreeModelNamedListNode*>(node)->shareNamedScalars(
+					*static_cast<const JsonTreeModelNamedListNode*>(original) );
+		}
+		if (node->childCount() > 0)
+		{
+			int childCount = original->childCount();
+			QHash<const JsonTreeModelListNode*, QByteArray>::const_iterator page = pages.constFind(original);
+			if (page == pages.constEnd())
+				page = pages.insert(original, JsonTreePageLoader::encode(original, &childCount));
+			node->releaseChildren( new JsonTreePageLoader(this, *page, childCount) );
+			node->setCachedHash(hash);
+		}
+	}
+}
+
+/*!
+	Returns \e true if the data under the given \a index is editable.
+
+	Only scalar elements of JSON arrays or scalar members of JSON objects are editable.
+*/
+bool
+JsonTreeModel::isEditable(const QModelIndex& index) const
+{
+	return JsonTreeModelCore::isEditable(index);
+}
+
+/*
+	Returns the row numbers that lead from the root node to the given node.
+*/
+QVector<int>
+JsonTreeModel::nodePath(const JsonTreeModelNode* node) const
+{
+	QVector<int> path;
+	for (auto parentNode = node->parent(); parentNode != nullptr; parentNode = parentNode->parent())
+	{
+		path << static_cast<const JsonTreeModelListNode*>(parentNode)->childPosition(const_cast<JsonTreeModelNode*>(node));
+		node = parentNode;
+	}
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+/*
+	Returns the node at the end of the given path, or nullptr if the path does not exist.
+*/
+JsonTreeModelNode*
+JsonTreeModel::nodeAtPath(const QVector<int>& path) const
+{
+	JsonTreeModelNode* node = m_rootNode;
+	for (int row : path)
+	{
+		if (node == nullptr || node->type() == JsonTreeModelNode::Scalar)
+			return nullptr;
+
+		auto listNode = static_cast<JsonTreeModelListNode*>(node);
+		if (row < 0 || row >= listNode->childCount())
+			return nullptr;
+		node = listNode->childAt(row);
+	}
+	return node;
+}
+
+/*
+	Stores a scalar value and records the change in the undo history.
+	If column is a null string, node must be a scalar node; otherwise node must be an object.
+*/
+void
+JsonTreeModel::writeScalar(JsonTreeModelNode* node, const QString& column, const QJsonValue& value)
+{
+	if (m_undoLimit > 0)
+	{
+		Edit edit;
+		edit.path = nodePath(node);
+		edit.column = column;
+		edit.newValue = value;
+		edit.oldValue = storedScalar(node, column);
+		appendJournal(edit);
+	}
+	else
+		appendJournal(Edit());
+
+	storeScalar(node, column, value);
+}
+
+/*
+	Records an edit in the undo history, which creates a new revision.
+*/
+void
+JsonTreeModel::appendJournal(const Edit& edit)
+{
+	if (m_undoLimit <= 0)
+	{
+		++m_journalBase; // Still create a new revision, so that older revisions cannot be restored
+		return;
+	}
+
+	// New edits replace any undone edits
+	while (m_journal.count() > m_journalPosition)
+		m_journal.removeLast();
+
+	m_journal << edit;
+	++m_journalPosition;
+	if (m_journal.count() > m_undoLimit)
+	{
+		m_journal.removeFirst();
+		++m_journalBase;
+		--m_journalPosition;
+	}
+}
+
+/*
+	Stores a scalar value without recording it. For named scalars, an undefined value removes the member.
+*/
+void
+JsonTreeModel::storeScalar(JsonTreeModelNode* node, const QString& column, const QJsonValue& value)
+{
+	invalidateReadCache();
+	node->invalidateCachedHash();
+	if (column.isNull())
+	{
+		Q_ASSERT(node->type() == JsonTreeModelNode::Scalar);
+		static_cast<JsonTreeModelScalarNode*>(node)->setValue( encodedValue(column, value) );
+	}
+	else
+	{
+		Q_ASSERT(node->type() == JsonTreeModelNode::Object);
+		auto namedNode = static_cast<JsonTreeModelNamedListNode*>(node);
+		const QJsonValue oldValue = storedScalar(node, column);
+		if (value.isUndefined())
+			namedNode->removeNamedScalarValue(column);
+		else
+			namedNode->setNamedScalarValue(column, encodedValue(column, value));
+		updateRowKey(namedNode, column, oldValue, value);
+	}
+}
+
+/*
+	Moves one step forward (redo) or backward (undo) through the journal, and marks the
+	affected cell as dirty if it is shown.
+*/
+bool
+JsonTreeModel::stepJournal(bool forward, DirtyCells* dirty)
+{
+	if (!forward)
+		--m_journalPosition;
+	const Edit& edit = m_journal[m_journalPosition];
+	if (forward)
+		++m_journalPosition;
+
+	if (!edit.patch.isEmpty())
+	{
+		if ( applyPatchOperations(forward ? edit.patch : edit.inversePatch, nullptr, *dirty) )
+			return true;
+
+		qWarning("JsonTreeModel: The undo history does not match the data");
+		return false;
+	}
+
+	auto node = nodeAtPath(edit.path);
+	if ( node == nullptr || edit.path.isEmpty()
+			|| node->type() != (edit.column.isNull() ? JsonTreeModelNode::Scalar : JsonTreeModelNode::Object) )
+	{
+		qWarning("JsonTreeModel: The undo history does not match the data");
+		return false;
+	}
+
+	storeScalar(node, edit.column, forward ? edit.newValue : edit.oldValue);
+
+	const int column = edit.column.isNull() ? 1 : columnsFor(node->parent()).indexOf(edit.column, 2);
+	if (column >= 0)
+		markDirty(*dirty, node, edit.path.last(), column);
+	return true;
+}
+
+/*
+	Discards the undo history. Called when the whole document is replaced.
+*/
+void
+JsonTreeModel::clearJournal()
+{
+	m_journalBase += m_journalPosition + 1;
+	m_journalPosition = 0;
+	m_journal.clear();
+}
+
+/*
+	Forgets everything that belongs to the current document and deletes its nodes, before the
+	model is reset to a new document. The journal is kept if the reset can be undone.
+*/
+void
+JsonTreeModel::resetDocumentState(bool keepJournal)
+{
+	if (!keepJournal)
+		clearJournal();
+	discardPendingChanges();
+	m_rowKeys.clear();
+	m_branchColumnCache.clear();
+	if (m_dictionary != nullptr)
+		m_dictionary->clear();
+	m_readSnapshotNodes.clear();
+	invalidateReadCache();
+
+	delete m_rootNode;
+	m_rootNode = nullptr;
+}
+
+/*
+	Converts and stores the value of an editable cell, without notifying the views.
+	Returns true if the stored value changed.
+*/
+bool
+JsonTreeModel::writeData(const QModelIndex& index, const QVariant& value)
+{
+	if (!isEditable(index)) // NOTE: isEditable() checks for index validity
+		return false;
+
+	QJsonValue newData;
+	if ( !JsonTreeModelNode::Traits::fromVariant(value, &newData) )
+		return false;
+
+	// NOTE: isEditable() only accepts scalar nodes in the "Scalar" column, and objects in the named scalar columns
+	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
+	const QString column = (index.column() == 1) ? QString() : columnsFor(node->parent()).value(index.column());
+
+	// NOTE: Compare the stored values directly, rather than converting them via data()
+	if (storedScalar(node, column) == newData)
+		return false;
+
+	writeScalar(node, column, newData);
+	return true;
+}
+
+/*
+	Returns the stored scalar value, or an undefined value if the named scalar does not exist.
+	If column is a null string, node must be a scalar node; otherwise node must be an object.
+*/
+QJsonValue
+JsonTreeModel::storedScalar(const JsonTreeModelNode* node, const QString& column) const
+{
+	if (column.isNull())
+		return static_cast<const JsonTreeModelScalarNode*>(node)->value();
+	return static_cast<const JsonTreeModelNamedListNode*>(node)->namedScalars().value(column, QJsonValue(QJsonValue::Undefined));
+}
+
+/*
+	Records that the given cell of node changed. The views are notified by emitDataChanged().
+*/
+void
+JsonTreeModel::markDirty(DirtyCells& dirty, JsonTreeModelNode* node, int row, int column)
+{
+	auto parentNode = static_cast<JsonTreeModelListNode*>(node->parent());
+	dirty[parentNode] << ( (quint64(row) << 32) | quint32(column) );
+}
+
+/*
+	Emits dataChanged() for the dirty cells right away, or adds them to the pending cells if the
+	notifications are throttled. Clears dirty either way.
+*/
+void
+JsonTreeModel::notifyDataChanged(DirtyCells& dirty, const QVector<int>& roles)
+{
+	if (m_notificationTimer->interval() <= 0)
+	{
+		emitDataChanged(dirty, roles);
+		return;
+	}
+	if (dirty.isEmpty())
+		return;
+
+	for (auto i = dirty.constBegin(); i != dirty.constEnd(); ++i)
+		m_pendingChanges[i.key()] += i.value();
+	for (int role : roles)
+	{
+		if (!m_pendingRoles.contains(role))
+			m_pendingRoles << role;
+	}
+	dirty.clear();
+
+	// NOTE: Don't restart an active timer, or a steady stream of edits would postpone the flush forever
+	if (!m_notificationTimer->isActive())
+		m_notificationTimer->start();
+}
+
+/*
+	Drops the pending cells without signalling them. Must be called whenever nodes are deleted or
+	rows are moved, because the pending cells refer to nodes and rows.
+*/
+void
+JsonTreeModel::discardPendingChanges()
+{
+	m_notificationTimer->stop();
+	m_pendingChanges.clear();
+	m_pendingRoles.clear();
+}
+
+/*
+	Emits dataChanged() for the dirty cells and clears them.
+
+	For each parent, cells in the same row and adjacent columns are merged into runs, and then
+	runs that span the same columns in adjacent rows are merged into rectangles. Only the changed
+	cells are covered, so the result is exact, and a fully changed block becomes a single signal.
+*/
+void
+JsonTreeModel::emitDataChanged(DirtyCells& dirty, const QVector<int>& roles)
+{
+	for (auto i = dirty.begin(); i != dirty.end(); ++i)
+	{
+		auto parentNode = i.key();
+		auto& cells = i.value();
+		std::sort(cells.begin(), cells.end());
+		cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+		QHash<quint64, QPair<int, int>> openRanges; // {top, bottom} rows, keyed by the first and last columns
+
+		auto emitRange = [=](int top, int bottom, int left, int right)
+		{
+			emit dataChanged( createIndex(top, left, parentNode->childAt(top)),
+					createIndex(bottom, right, parentNode->childAt(bottom)),
+					itemRoles(parentNode, roles, left, right) );
+		};
+
+		int k = 0;
+		while (k < cells.count())
+		{
+			const int row = int(cells[k] >> 32);
+			const int left = int(cells[k] & 0xFFFFFFFF);
+			int right = left;
+			++k;
+			while ( k < cells.count() && int(cells[k] >> 32) == row && int(cells[k] & 0xFFFFFFFF) == right + 1 )
+			{
+				++right;
+				++k;
+			}
+
+			const quint64 span = (quint64(left) << 32) | quint32(right);
+			auto open = openRanges.find(span);
+			if (open != openRanges.end() && open.value().second == row - 1)
+				open.value().second = row;
+			else
+			{
+				if (open != openRanges.end())
+					emitRange(open.value().first, open.value().second, left, right);
+				openRanges.insert(span, qMakePair(row, row));
+			}
+		}
+		for (auto j = openRanges.constBegin(); j != openRanges.constEnd(); ++j)
+			emitRange(j.value().first, j.value().second, int(j.key() >> 32), int(j.key() & 0xFFFFFFFF));
+	}
+	dirty.clear();
+}
+
+/*
+	Adds the roles of the given columns of the rows under the given node to the roles of a
+	dataChanged() signal, so that QML delegates (which use roles instead of columns) are updated.
+*/
+QVector<int>
+JsonTreeModel::itemRoles(const JsonTreeModelListNode* parentNode, const QVector<int>& roles, int left, int right) const
+{
+	if (roles.isEmpty()) // NOTE: No roles means that all roles changed
+		return roles;
+
+	QVector<int> allRoles = roles;
+	const QStringList headers = columnsFor(parentNode);
+	for (int column = qMax(1, left); column <= right; ++column)
+	{
+		if (column == 1)
+		{
+			allRoles << ValueRole;
+			continue;
+		}
+		const int modelColumn = m_branchColumns ? m_headers.indexOf(headers.value(column), 2) : column;
+		if (modelColumn >= 2)
+			allRoles << ScalarColumnRole + modelColumn - 2;
+	}
+	return allRoles;
+}
+
+/*
+	Returns the cell that a role of a row refers to, or an invalid index if the row has no such cell.
+*/
+QModelIndex
+JsonTreeModel::roleIndex(const QModelIndex& index, int role) const
+{
+	if (!index.isValid())
+		return QModelIndex();
+
+	auto node = static_cast<JsonTreeModelNode*>(index.internalPointer());
+	const int column = (role == ValueRole) ? 1 : branchColumn(node, role - ScalarColumnRole + 2);
+	if ( column < 0 || column >= columnsFor(node->parent()).count() )
+		return QModelIndex();
+	return createIndex(index.row(), column, node);
+}
+
+/*
+	Creates the nodes of a new document and, unless the search mode is NoSearch, finds its scalar
+	columns. Without projection, the columns are collected while the nodes are created, so the
+	document is only walked once.
+*/
+void
+JsonTreeModel::buildDocument(const QJsonValue& value, ScalarColumnSearchMode searchMode)
+{
+	const bool search = (searchMode != NoSearch);
+	DataTreeScalarNameCollector collector(searchMode == ComprehensiveSearch);
+
+	// NOTE: With projection, the columns are found first, so that they can be used as the projection
+	if (search && m_columnProjection)
+		setFoundColumns( dataTreeScalarNames(value, collector.comprehensive) );
+	m_projectedColumns = scalarColumns().toSet();
+
+	const bool collect = (search && !m_columnProjection);
+	m_rootNode = createRootNode(value, projection(), collect ? &collector : nullptr);
+	if (collect)
+	{
+		setFoundColumns(collector.names);
+		m_projectedColumns = collector.names;
+	}
+}
+
+/*
+	Replaces the named scalar columns with the given names, in alphabetical order.
+*/
+void
+JsonTreeModel::setFoundColumns(const QSet<QString>& names)
+{
+	auto scalarCols = names.toList();
+	std::sort(scalarCols.begin(), scalarCols.end());
+	m_headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
+	// TODO: Implement QList::resize() upstream to discard all columns except the first two? See QTBUG-42732
+	// TODO: Check if it's safe to call setScalarColumns() here, which causes nested beginResetModel() calls
+}
+
+/*
+	Creates the root node for a top-level array or object. A top-level object with scalar
+	members is wrapped, so that its scalars can be shown in a row. The projection (if any) only
+	keeps the listed scalar members in memory, and the collector (if any) collects the names of
+	the scalar columns.
+*/
+JsonTreeModelListNode*
+JsonTreeModel::createRootNode(const QJsonValue& value, const QSet<QString>* projection, DataTreeScalarNameCollector* collector)
+{
+	if (value.isArray())
+		return new JsonTreeModelListNode(value.toArray(), nullptr, projection, collector);
+
+	auto namedListNode = new JsonTreeModelNamedListNode(value.toObject(), nullptr, projection, collector);
+	if (namedListNode->namedScalarCount() > 0)
+		return new JsonTreeModelWrapperNode(namedListNode);
+	return namedListNode;
+}
+
+/*
+	Deduplicates the string values of the given node and its descendants, if dictionary encoding
+	is enabled.
+*/
+void
+JsonTreeModel::encodeStrings(JsonTreeModelNode* node)
+{
+	if (m_dictionary != nullptr)
+		m_dictionary->encodeTree(node);
+}
+
+/*
+	Returns the value to store for a scalar of the given column (or of an array, for a null
+	column), which shares the dictionary's copy of a repeated string.
+*/
+QJsonValue
+JsonTreeModel::encodedValue(const QString& column, const QJsonValue& value)
+{
+	if (m_dictionary == nullptr)
+		return value;
+	return m_dictionary->encodeValue(column, value);
+}
+
+/*
+	Returns the headers of the rows under the given node. In branch column mode, these only
+	contain the named scalar columns that the rows actually have.
+*/
+QStringList
+JsonTreeModel::columnsFor(const JsonTreeModelNode* parentNode) const
+{
+	if (!m_branchColumns || parentNode == nullptr || parentNode->type() == JsonTreeModelNode::Scalar)
+		return m_headers;
+
+	auto listNode = static_cast<const JsonTreeModelListNode*>(parentNode);
+	auto cached = m_branchColumnCache.constFind(listNode);
+	if (cached != m_branchColumnCache.constEnd())
+		return cached.value();
+
+	// NOTE: The names are collected without loading deferred rows or materializing projected-out members
+	QSet<QString> names;
+	for (int i = 0; i < listNode->childCount(); ++i)
+	{
+		auto child = listNode->childAt(i);
+		if (child->type() == JsonTreeModelNode::Object)
+			static_cast<const JsonTreeModelNamedListNode*>(child)->collectNamedScalarNames(&names);
+	}
+	auto scalarCols = names.toList();
+	std::sort(scalarCols.begin(), scalarCols.end());
+
+	const QStringList headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
+	m_branchColumnCache.insert(listNode, headers);
+	return headers;
+}
+
+/*
+	Converts a column of the model-wide headers to the matching column of the given row, or -1 if
+	its parent does not have that column. Used by JsonTreeFlatModel.
+*/
+int
+JsonTreeModel::branchColumn(const JsonTreeModelNode* node, int column) const
+{
+	if (!m_branchColumns || column < 2)
+		return column;
+	return columnsFor(node->parent()).indexOf(m_headers.value(column), 2);
+}
+
+/*
+	Converts a column of the given row to the matching column of the model-wide headers, or -1 if
+	there is no such column. The reverse of branchColumn().
+*/
+int
+JsonTreeModel::modelColumn(const JsonTreeModelNode* node, int column) const
+{
+	if (!m_branchColumns || column < 2)
+		return column;
+	return m_headers.indexOf(columnsFor(node->parent()).value(column), 2);
+}
+
+/*
+	Adds the named scalar columns that the given rows have, but their parent does not have yet.
+	The parent's columns are left alone if they have not been found yet.
+*/
+void
+JsonTreeModel::extendBranchColumns(JsonTreeModelListNode* parentNode, int first, int last)
+{
+	auto cached = m_branchColumnCache.constFind(parentNode);
+	if (cached == m_branchColumnCache.constEnd())
+		return;
+
+	const QStringList headers = cached.value();
+	QStringList added;
+	for (int i = first; i <= last; ++i)
+	{
+		auto child = parentNode->childAt(i);
+		if (child->type() != JsonTreeModelNode::Object)
+			continue;
+
+		QSet<QString> names;
+		static_cast<const JsonTreeModelNamedListNode*>(child)->collectNamedScalarNames(&names);
+		for (const auto& name : qAsConst(names))
+		{
+			if (headers.indexOf(name, 2) < 0 && !added.contains(name))
+				added << name;
+		}
+	}
+	std::sort(added.begin(), added.end()); // NOTE: QSet has no order
+	if (added.isEmpty())
+		return;
+
+	beginInsertColumns(nodeIndex(parentNode), headers.count(), headers.count() + added.count() - 1);
+	m_branchColumnCache[parentNode] = headers + added;
+	endInsertColumns();
+}
+
+/*
+	Forgets everything that is cached for the given node (unless descendantsOnly is true) and for
+	its descendants, which are about to be deleted.
+*/
+void
+JsonTreeModel::forgetDeletedNodes(const JsonTreeModelNode* node, bool descendantsOnly)
+{
+	forgetBranchColumns(node, descendantsOnly);
+	forgetReadSnapshotNodes(node, descendantsOnly);
+}
+
+/*
+	Forgets the branch columns of the given node (unless descendantsOnly is true) and of its
+	descendants.
+*/
+void
+JsonTreeModel::forgetBranchColumns(const JsonTreeModelNode* node, bool descendantsOnly)
+{
+	// NOTE: Only the parents whose columns were requested are cached, so there are few entries to check
+	for (auto i = m_branchColumnCache.begin(); i != m_branchColumnCache.end(); )
+	{
+		const JsonTreeModelNode* ancestor = i.key();
+		if (descendantsOnly && ancestor == node)
+		{
+			++i;
+			continue;
+		}
+		while (ancestor != nullptr && ancestor != node)
+			ancestor = ancestor->parent();
+
+		if (ancestor == node)
+			i = m_branchColumnCache.erase(i);
+		else
+			++i;
+	}
+}
+
+/*
+	Returns the node that represents the top-level array or object, looking through the wrapper.
+*/
+JsonTreeModelListNode*
+JsonTreeModel::documentNode() const
+{
+	if (m_rootNode != nullptr && m_rootNode->isWrapper())
+		return static_cast<JsonTreeModelListNode*>(m_rootNode->childAt(0));
+	return m_rootNode;
+}
+
+/*
+	Returns the index of the given node in column 0, or an invalid index for the root node.
+*/
+QModelIndex
+JsonTreeModel::nodeIndex(const JsonTreeModelNode* node) const
+{
+	if (node == nullptr || node == m_rootNode)
+		return QModelIndex();
+
+	auto parentNode = static_cast<const JsonTreeModelListNode*>(node->parent());
+	auto mutableNode = const_cast<JsonTreeModelNode*>(node);
+	return createIndex(parentNode->childPosition(mutableNode), 0, mutableNode);
+}
+
+/*
+	Emits the pending dataChanged() signals before rows are inserted or removed, because the
+	dirty cells are addressed by row.
+*/
+void
+JsonTreeModel::flushBeforeRowChange(DirtyCells& dirty)
+{
+	emitDataChanged(dirty, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	flushChanges();
+}
+
+/*
+	Marks the cell of a named scalar as dirty, if it is shown.
+*/
+void
+JsonTreeModel::markNamedScalarDirty(DirtyCells& dirty, JsonTreeModelNamedListNode* object, const QString& name)
+{
+	if (object->parent() == nullptr)
+		return;
+	const int column = columnsFor(object->parent()).indexOf(name, 2);
+	if (column < 0)
+		return;
+
+	auto parentNode = static_cast<JsonTreeModelListNode*>(object->parent());
+	markDirty(dirty, object, parentNode->childPosition(object), column);
+}
+
+/*
+	Parses an array index from a JSON Pointer reference token. Returns -1 if the token is not a
+	valid index, or if it is greater than maxIndex. If allowEnd is true, "-" refers to maxIndex.
+*/
+static int
+arrayIndexFromToken(const QString& token, int maxIndex, bool allowEnd)
+{
+	if (token == QLatin1String("-"))
+		return allowEnd ? maxIndex : -1;
+
+	// NOTE: RFC 6901 forbids leading zeros and signs
+	if ( token.isEmpty() || (token.length() > 1 && token[0].unicode() == '0') )
+		return -1;
+	for (const QChar c : token)
+	{
+		if (c.unicode() < '0' || c.unicode() > '9')
+			return -1;
+	}
+
+	bool ok;
+	int index = token.toInt(&ok);
+	return (ok && index <= maxIndex) ? index : -1;
+}
+
+/*
+	Splits a non-empty JSON Pointer (RFC 6901) into its unescaped reference tokens.
+	Returns false if the pointer is malformed.
+*/
+static bool
+splitPointer(const QString& pointer, QStringList* tokens)
+{
+	if (!pointer.startsWith('/'))
+		return false;
+
+	*tokens = pointer.mid(1).split('/');
+	for (auto& token : *tokens)
+		token.replace(QLatin1String("~1"), QLatin1String("/")).replace(QLatin1String("~0"), QLatin1String("~"));
+	return true;
+}
+
+/*
+	Resolves all but the last reference token of a non-empty JSON Pointer (RFC 6901).
+	Returns the array or object that should contain the last token, or nullptr if the pointer
+	is malformed or does not lead to a structure.
+*/
+JsonTreeModelListNode*
+JsonTreeModel::resolvePointer(const QString& pointer, QString* lastToken) const
+{
+	QStringList tokens;
+	if (m_rootNode == nullptr || !splitPointer(pointer, &tokens))
+		return nullptr;
+	*lastToken = tokens.takeLast();
+
+	JsonTreeModelNode* node = documentNode();
+	for (const auto& token : qAsConst(tokens))
+	{
+		if (node->type() == JsonTreeModelNode::Array)
+		{
+			auto listNode = static_cast<JsonTreeModelListNode*>(node);
+			int row = arrayIndexFromToken(token, listNode->childCount() - 1, false);
+			if (row < 0)
+				return nullptr;
+			node = listNode->childAt(row);
+		}
+		else if (node->type() == JsonTreeModelNode::Object)
+		{
+			node = static_cast<JsonTreeModelNamedListNode*>(node)->namedChild(token);
+			if (node == nullptr)
+				return nullptr; // Also true if the member is a scalar, which cannot contain anything
+		}
+		else
+			return nullptr;
+	}
+
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return nullptr;
+	return static_cast<JsonTreeModelListNode*>(node);
+}
+
+/*
+	Reads the value at a JSON Pointer. Returns false if it does not exist.
+*/
+bool
+JsonTreeModel::pointerValue(const QString& pointer, QJsonValue* value) const
+{
+	if (pointer.isEmpty())
+	{
+		*value = json();
+		return m_rootNode != nullptr;
+	}
+
+	QString token;
+	auto container = resolvePointer(pointer, &token);
+	if (container == nullptr)
+		return false;
+
+	if (container->type() == JsonTreeModelNode::Array)
+	{
+		int row = arrayIndexFromToken(token, container->childCount() - 1, false);
+		if (row < 0)
+			return false;
+		*value = container->childAt(row)->value();
+		return true;
+	}
+
+	auto object = static_cast<JsonTreeModelNamedListNode*>(container);
+	if (auto child = object->namedChild(token))
+	{
+		*value = child->value();
+		return true;
+	}
+	const auto& scalars = object->namedScalars();
+	auto i = scalars.constFind(token);
+	if (i == scalars.constEnd())
+		return false;
+	*value = i.value();
+	return true;
+}
+
+/*
+	Applies patch operations in order, and stops at the first one that fails. If inverse is
+	not null, it receives the operations that revert the successfully applied ones, in the
+	order that they must be applied.
+*/
+bool
+JsonTreeModel::applyPatchOperations(const QJsonArray& operations, QJsonArray* inverse, DirtyCells& dirty)
+{
+	QVector<QJsonObject> inverseOperations;
+	auto recordInverse = [&]()
+	{
+		if (inverse == nullptr)
+			return;
+		*inverse = QJsonArray();
+		for (int i = inverseOperations.count() - 1; i >= 0; --i)
+			inverse->append(inverseOperations[i]);
+	};
+
+	for (const auto& operationValue : operations)
+	{
+		const auto operation = operationValue.toObject();
+		const auto op = operation.value(QLatin1String("op")).toString();
+		const auto pathValue = operation.value(QLatin1String("path"));
+		if (!pathValue.isString())
+		{
+			recordInverse();
+			return false;
+		}
+		const QString path = pathValue.toString();
+
+		bool ok = false;
+		QJsonObject undoAdd, undoRemove;
+		if (op == QLatin1String("add") || op == QLatin1String("replace"))
+		{
+			ok = operation.contains(QLatin1String("value"))
+					&& patchAdd(path, operation.value(QLatin1String("value")), op == QLatin1String("replace"), &undoAdd, dirty);
+		}
+		else if (op == QLatin1String("remove"))
+			ok = patchRemove(path, &undoRemove, dirty);
+
+		else if (op == QLatin1String("move") || op == QLatin1String("copy"))
+		{
+			const QString from = operation.value(QLatin1String("from")).toString();
+			QJsonValue value;
+			ok = operation.value(QLatin1String("from")).isString() && pointerValue(from, &value);
+
+			if (ok && op == QLatin1String("move"))
+			{
+				// NOTE: A value cannot be moved into one of its own descendants
+				ok = !(path.startsWith(from) && path.length() > from.length() && path[from.length()] == '/')
+						&& patchRemove(from, &undoRemove, dirty);
+			}
+			if (ok)
+			{
+				ok = patchAdd(path, value, false, &undoAdd, dirty);
+				if (!ok && !undoRemove.isEmpty())
+					inverseOperations << undoRemove; // The removal already took place
+			}
+		}
+		else if (op == QLatin1String("test"))
+		{
+			QJsonValue value;
+			ok = pointerValue(path, &value) && value == operation.value(QLatin1String("value"));
+		}
+
+		if (!ok)
+		{
+			recordInverse();
+			return false;
+		}
+		if (!undoRemove.isEmpty())
+			inverseOperations << undoRemove;
+		if (!undoAdd.isEmpty())
+			inverseOperations << undoAdd;
+	}
+
+	recordInverse();
+	return true;
+}
+
+/*
+	Performs the "add" operation, or the "replace" operation if replace is true, and emits the
+	matching signals. On success, inverse receives the operation that reverts it.
+*/
+bool
+JsonTreeModel::patchAdd(const QString& path, const QJsonValue& value, bool replace, QJsonObject* inverse, DirtyCells& dirty)
+{
+	if (value.isUndefined())
+		return false;
+
+	invalidateReadCache();
+
+	// The whole document
+	if (path.isEmpty())
+	{
+		if ( m_rootNode == nullptr || !(value.isArray() || value.isObject()) )
+			return false;
+
+		*inverse = QJsonObject{{"op", "replace"}, {"path", path}, {"value", json()}};
+		flushBeforeRowChange(dirty);
+		replaceDocument(value);
+		return true;
+	}
+
+	QString token;
+	auto container = resolvePointer(path, &token);
+	if (container == nullptr)
+		return false;
+	container->invalidateCachedHash();
+
+	if (container->type() == JsonTreeModelNode::Array)
+	{
+		const int count = container->childCount();
+		const int row = arrayIndexFromToken(token, replace ? count - 1 : count, !replace);
+		if (row < 0)
+			return false;
+
+		if (!replace)
+		{
+			// NOTE: Record the actual row, in case the path ends with "-"
+			*inverse = QJsonObject{{"op", "remove"}, {"path", path.left(path.lastIndexOf('/') + 1) + QString::number(row)}};
+		}
+		else
+		{
+			auto child = container->childAt(row);
+			*inverse = QJsonObject{{"op", "replace"}, {"path", path}, {"value", child->value()}};
+
+			if ( child->type() == JsonTreeModelNode::Scalar && JsonTreeModelNode::Traits::isScalar(value) )
+			{
+				storeScalar(child, QString(), value);
+				markDirty(dirty, child, row, 1);
+				return true;
+			}
+
+			flushBeforeRowChange(dirty);
+			beginRemoveRows(nodeIndex(container), row, row);
+			forgetRowKeys(container, child);
+			forgetDeletedNodes(child);
+			accountResidentBytes(child, -1);
+			delete container->takeChild(row);
+			endRemoveRows();
+		}
+
+		insertElement(container, row, value, dirty);
+		return true;
+	}
+	return addMember(static_cast<JsonTreeModelNamedListNode*>(container), path, token, value, replace, inverse, dirty);
+}
+
+/*
+	Inserts an element into an array and emits the matching signals.
+*/
+void
+JsonTreeModel::insertElement(JsonTreeModelListNode* array, int row, const QJsonValue& value, DirtyCells& dirty)
+{
+	flushBeforeRowChange(dirty);
+	beginInsertRows(nodeIndex(array), row, row);
+	auto child = array->insertChild(row, value);
+	encodeStrings(child);
+	indexRowKey(array, child);
+	accountResidentBytes(child, 1);
+	endInsertRows();
+	extendBranchColumns(array, row, row);
+}
+
+/*
+	Adds or replaces the member of an object that the given path and token refer to, and emits the
+	matching signals. On success, inverse receives the operation that reverts it.
+*/
+bool
+JsonTreeModel::addMember(JsonTreeModelNamedListNode* object, const QString& path, const QString& token, const QJsonValue& value,
+		bool replace, QJsonObject* inverse, DirtyCells& dirty)
+{
+	object->invalidateCachedHash();
+	auto child = object->namedChild(token);
+	const QJsonValue oldScalar = object->namedScalars().value(token, QJsonValue(QJsonValue::Undefined));
+	const bool hasScalar = !oldScalar.isUndefined();
+
+	if (child != nullptr)
+		*inverse = QJsonObject{{"op", "replace"}, {"path", path}, {"value", child->value()}};
+	else if (hasScalar)
+		*inverse = QJsonObject{{"op", "replace"}, {"path", path}, {"value", oldScalar}};
+	else if (replace)
+		return false;
+	else
+		*inverse = QJsonObject{{"op", "remove"}, {"path", path}};
+
+	if (child != nullptr)
+	{
+		flushBeforeRowChange(dirty);
+		const int row = object->childPosition(child);
+		beginRemoveRows(nodeIndex(object), row, row);
+		forgetRowKeys(object, child);
+		forgetDeletedNodes(child);
+		accountResidentBytes(child, -1);
+		delete object->takeNamedChild(token);
+		endRemoveRows();
+	}
+
+	if ( JsonTreeModelNode::Traits::isScalar(value) )
+	{
+		if (object == m_rootNode)
+		{
+			// NOTE: A top-level object needs a wrapper to show its scalars, which changes every row
+			flushBeforeRowChange(dirty);
+			beginResetModel();
+			discardPendingChanges();
+			m_rootNode = new JsonTreeModelWrapperNode(object);
+			storeScalar(object, token, value);
+			endResetModel();
+		}
+		else
+		{
+			storeScalar(object, token, value);
+			markNamedScalarDirty(dirty, object, token);
+			if (!hasScalar)
+			{
+				auto parentNode = static_cast<JsonTreeModelListNode*>(object->parent());
+				const int row = parentNode->childPosition(object);
+				extendBranchColumns(parentNode, row, row);
+			}
+		}
+		return true;
+	}
+
+	if (hasScalar)
+	{
+		storeScalar(object, token, QJsonValue(QJsonValue::Undefined));
+		markNamedScalarDirty(dirty, object, token);
+	}
+
+	flushBeforeRowChange(dirty);
+	const int row = object->namedChildInsertionPoint(token);
+	beginInsertRows(nodeIndex(object), row, row);
+	child = object->insertNamedChild(token, value);
+	encodeStrings(child);
+	accountResidentBytes(child, 1);
+	endInsertRows();
+	extendBranchColumns(object, row, row);
+	return true;
+}
+
+/*
+	Resets the model to a new document, without discarding the undo history. Used by patches
+	that replace the whole document.
+*/
+void
+JsonTreeModel::replaceDocument(const QJsonValue& value)
+{
+	beginResetModel();
+	resetDocumentState(true);
+	m_rootNode = createRootNode(value, projection());
+	encodeStrings(m_rootNode);
+	shareIdenticalSubtrees();
+	resetPaging(true);
+	endResetModel();
+}
+
+/*
+	Performs the "remove" operation and emits the matching signals. On success, inverse
+	receives the operation that reverts it.
+*/
+bool
+JsonTreeModel::patchRemove(const QString& path, QJsonObject* inverse, DirtyCells& dirty)
+{
+	invalidateReadCache();
+	QString token;
+	auto container = resolvePointer(path, &token); // NOTE: The whole document cannot be removed
+	if (container == nullptr)
+		return false;
+	container->invalidateCachedHash();
+
+	if (container->type() == JsonTreeModelNode::Array)
+	{
+		const int row = arrayIndexFromToken(token, container->childCount() - 1, false);
+		if (row < 0)
+			return false;
+
+		*inverse = QJsonObject{{"op", "add"}, {"path", path}, {"value", container->childAt(row)->value()}};
+		flushBeforeRowChange(dirty);
+		beginRemoveRows(nodeIndex(container), row, row);
+		forgetRowKeys(container, container->childAt(row));
+		forgetDeletedNodes(container->childAt(row));
+		accountResidentBytes(container->childAt(row), -1);
+		delete container->takeChild(row);
+		endRemoveRows();
+		return true;
+	}
+
+	auto object = static_cast<JsonTreeModelNamedListNode*>(container);
+	if (auto child = object->namedChild(token))
+	{
+		*inverse = QJsonObject{{"op", "add"}, {"path", path}, {"value", child->value()}};
+		flushBeforeRowChange(dirty);
+		const int row = object->childPosition(child);
+		beginRemoveRows(nodeIndex(object), row, row);
+		forgetRowKeys(object, child);
+		forgetDeletedNodes(child);
+		accountResidentBytes(child, -1);
+		delete object->takeNamedChild(token);
+		endRemoveRows();
+		return true;
+	}
+
+	const QJsonValue oldScalar = object->namedScalars().value(token, QJsonValue(QJsonValue::Undefined));
+	if (oldScalar.isUndefined())
+		return false;
+
+	*inverse = QJsonObject{{"op", "add"}, {"path", path}, {"value", oldScalar}};
+	storeScalar(object, token, QJsonValue(QJsonValue::Undefined));
+	markNamedScalarDirty(dirty, object, token);
+	return true;
+}
+
+/*
+	Writes a scalar that was posted by postUpdate(), and marks its cell as dirty. Returns false if
+	the pointer does not refer to a scalar. If the value changed, operation and inverse receive the
+	patch operations that redo and revert the update.
+*/
+bool
+JsonTreeModel::applyUpdate(const QString& pointer, const QJsonValue& value, DirtyCells& dirty,
+		QJsonObject* operation, QJsonObject* inverse)
+{
+	QString token;
+	auto container = pointer.isEmpty() ? nullptr : resolvePointer(pointer, &token);
+	if ( container == nullptr || !JsonTreeModelNode::Traits::isScalar(value) )
+		return false;
+
+	if (container->type() == JsonTreeModelNode::Array)
+	{
+		const int row = arrayIndexFromToken(token, container->childCount() - 1, false);
+		auto child = (row < 0) ? nullptr : container->childAt(row);
+		if (child == nullptr || child->type() != JsonTreeModelNode::Scalar)
+			return false;
+
+		// NOTE: Unchanged values are not signalled
+		const QJsonValue oldValue = storedScalar(child, QString());
+		if (oldValue != value)
+		{
+			*operation = QJsonObject{{"op", "replace"}, {"path", pointer}, {"value", value}};
+			*inverse = QJsonObject{{"op", "replace"}, {"path", pointer}, {"value", oldValue}};
+			storeScalar(child, QString(), value);
+			markDirty(dirty, child, row, 1);
+		}
+		return true;
+	}
+
+	// NOTE: A top-level object would need a wrapper to show a new scalar, which resets the model
+	auto object = static_cast<JsonTreeModelNamedListNode*>(container);
+	const QJsonValue oldValue = storedScalar(object, token);
+	const bool isNew = oldValue.isUndefined();
+	if ( object->namedChild(token) != nullptr || (isNew && object == m_rootNode) )
+		return false;
+	if (oldValue == value)
+		return true;
+
+	*operation = QJsonObject{{"op", "add"}, {"path", pointer}, {"value", value}};
+	if (isNew)
+		*inverse = QJsonObject{{"op", "remove"}, {"path", pointer}};
+	else
+		*inverse = QJsonObject{{"op", "replace"}, {"path", pointer}, {"value", oldValue}};
+	storeScalar(object, token, value);
+	markNamedScalarDirty(dirty, object, token);
+	if (isNew)
+	{
+		auto parentNode = static_cast<JsonTreeModelListNode*>(object->parent());
+		const int row = parentNode->childPosition(object);
+		extendBranchColumns(parentNode, row, row);
+	}
+	return true;
+}
+
+/*
+	Returns the JSON Pointer (RFC 6901) of the given node.
+*/
+QString
+JsonTreeModel::nodePointer(const JsonTreeModelNode* node) const
+{
+	QStringList tokens;
+	for (; node != documentNode(); node = node->parent())
+	{
+		auto parentNode = static_cast<const JsonTreeModelListNode*>(node->parent());
+		auto mutableNode = const_cast<JsonTreeModelNode*>(node);
+		if (parentNode->type() == JsonTreeModelNode::Object)
+		{
+			QString token = static_cast<const JsonTreeModelNamedListNode*>(parentNode)->childListNodeName(mutableNode);
+			tokens << token.replace('~', QLatin1String("~0")).replace('/', QLatin1String("~1"));
+		}
+		else
+			tokens << QString::number( parentNode->childPosition(mutableNode) );
+	}
+	std::reverse(tokens.begin(), tokens.end());
+	return tokens.isEmpty() ? QString() : '/' + tokens.join('/');
+}
+
+/*
+	Adds a new child of a keyed array to the array's key index.
+*/
+void
+JsonTreeModel::indexRowKey(JsonTreeModelListNode* array, JsonTreeModelNode* child)
+{
+	auto keys = m_rowKeys.find(array);
+	if (keys == m_rowKeys.end() || child == nullptr || child->type() != JsonTreeModelNode::Object)
+		return;
+
+	const auto& scalars = static_cast<JsonTreeModelNamedListNode*>(child)->namedScalars();
+	auto key = scalars.constFind(keys.value().column);
+	if (key != scalars.constEnd())
+		keys.value().rows.insert(rowKeyString(key.value()), child);
+}
+
+/*
+	Removes a child that is about to be deleted from the key index of its parent, and drops the
+	key indexes of any arrays within the child.
+*/
+void
+JsonTreeModel::forgetRowKeys(JsonTreeModelListNode* parentNode, JsonTreeModelNode* child)
+{
+	if (m_rowKeys.isEmpty() || child->type() == JsonTreeModelNode::Scalar)
+		return;
+
+	auto keys = m_rowKeys.find(parentNode);
+	if (keys != m_rowKeys.end() && child->type() == JsonTreeModelNode::Object)
+	{
+		const auto& scalars = static_cast<JsonTreeModelNamedListNode*>(child)->namedScalars();
+		auto key = scalars.constFind(keys.value().column);
+		if (key != scalars.constEnd())
+		{
+			auto& rows = keys.value().rows;
+			const QString keyString = rowKeyString(key.value());
+			if (rows.value(keyString) == child)
+				rows.remove(keyString);
+		}
+	}
+
+	// ASSUMPTION: Only a few arrays are keyed, so checking each of them is cheap
+	auto i = m_rowKeys.begin();
+	while (i != m_rowKeys.end())
+	{
+		bool isInside = false;
+		for (const JsonTreeModelNode* node = i.key(); node != nullptr && !isInside; node = node->parent())
+			isInside = (node == child);
+
+		if (isInside)
+			i = m_rowKeys.erase(i);
+		else
+			++i;
+	}
+}
+
+/*
+	Updates the key index after a named scalar of an object changed. An undefined value means
+	that the scalar does not exist.
+*/
+void
+JsonTreeModel::updateRowKey(JsonTreeModelNamedListNode* object, const QString& name, const QJsonValue& oldValue, const QJsonValue& newValue)
+{
+	if (m_rowKeys.isEmpty() || object->parent() == nullptr)
+		return;
+
+	auto keys = m_rowKeys.find(static_cast<JsonTreeModelListNode*>(object->parent()));
+	if (keys == m_rowKeys.end() || keys.value().column != name)
+		return;
+
+	auto& rows = keys.value().rows;
+	if (!oldValue.isUndefined())
+	{
+		const QString keyString = rowKeyString(oldValue);
+		if (rows.value(keyString) == object)
+			rows.remove(keyString);
+	}
+	if (!newValue.isUndefined())
+		rows.insert(rowKeyString(newValue), object);
+}
+
+/*
+	Appends an unescaped reference token to a JSON Pointer (RFC 6901).
+*/
+static QString
+childPointer(const QString& pointer, QString token)
+{
+	return pointer + '/' + token.replace('~', QLatin1String("~0")).replace('/', QLatin1String("~1"));
+}
+
+/*
+	The hashes are 64-bit, because diff() trusts them: with 32 bits, a collision between two of
+	the millions of subtrees in a large document would be likely enough to hide a difference.
+*/
+static inline quint64
+combineHash(quint64 seed, quint64 value)
+{
+	return seed ^ (value + Q_UINT64_C(0x9e3779b97f4a7c15) + (seed << 6) + (seed >> 2));
+}
+
+static inline quint64
+stringHash(const QString& text)
+{
+	return (quint64(qHash(text, 0x5bd1e995)) << 32) | qHash(text);
+}
+
+/*
+	Hashes a scalar. The type is hashed too, so that e.g. 1 and "1" are different.
+*/
+static quint64
+scalarHash(const QJsonValue& value)
+{
+	const quint64 hash = qHash(static_cast<int>(value.type()));
+	switch (value.type())
+	{
+	case QJsonValue::Bool: return combineHash(hash, value.toBool() ? 1 : 2);
+	case QJsonValue::Double:
+	{
+		// NOTE: 0.0 and -0.0 compare equal, so they must hash equally
+		const double number = value.toDouble();
+		quint64 bits = 0;
+		if (number != 0)
+			std::memcpy(&bits, &number, sizeof(bits));
+		return combineHash(hash, bits);
+	}
+	case QJsonValue::String: return combineHash(hash, stringHash(value.toString()));
+	default: return hash;
+	}
+}
+
+/*
+	Returns the hash of the given node's contents, and caches the hashes of its descendants.
+	Only the nodes whose contents changed since the last call are hashed again.
+*/
+quint64
+JsonTreeModel::subtreeHash(const JsonTreeModelNode* node)
+{
+	if (node->cachedHash() != 0)
+		return node->cachedHash();
+
+	quint64 hash;
+	if (node->type() == JsonTreeModelNode::Scalar)
+		hash = scalarHash( static_cast<const JsonTreeModelScalarNode*>(node)->value() );
+	else
+	{
+		auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+		hash = combineHash( qHash(static_cast<int>(node->type())), qHash(listNode->childCount()) );
+		if (node->type() == JsonTreeModelNode::Object)
+		{
+			auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+			const auto& scalars = namedNode->namedScalars();
+			hash = combineHash(hash, qHash(scalars.count()));
+			for (auto i = scalars.constBegin(); i != scalars.constEnd(); ++i)
+				hash = combineHash( combineHash(hash, stringHash(i.key())), scalarHash(i.value()) );
+		}
+
+		for (int i = 0; i < listNode->childCount(); ++i)
+		{
+			auto child = listNode->childAt(i);
+			if (node->type() == JsonTreeModelNode::Object)
+				hash = combineHash( hash, stringHash(static_cast<const JsonTreeModelNamedListNode*>(node)->childListNodeName(child)) );
+			hash = combineHash(hash, subtreeHash(child));
+		}
+	}
+
+	if (hash == 0) // NOTE: 0 means "not computed"
+		hash = 1;
+	node->setCachedHash(hash);
+	return hash;
+}
+
+/*
+	Returns the hash that subtreeHash() would return for the nodes that are created from the given
+	value, without creating them.
+*/
+quint64
+JsonTreeModel::valueHash(const QJsonValue& value)
+{
+	if (JsonTreeModelNode::Traits::isScalar(value))
+		return scalarHash(value);
+
+	quint64 hash;
+	if (value.isArray())
+	{
+		const QJsonArray array = value.toArray();
+		hash = combineHash( qHash(static_cast<int>(JsonTreeModelNode::Array)), qHash(array.count()) );
+		for (const auto& element : array)
+			hash = combineHash(hash, valueHash(element));
+	}
+	else
+	{
+		// NOTE: Like the nodes, the members are hashed by name: first the scalars, then the children
+		const QJsonObject object = value.toObject();
+		int scalarCount = 0;
+		for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+		{
+			if (JsonTreeModelNode::Traits::isScalar(i.value()))
+				++scalarCount;
+		}
+
+		hash = combineHash( qHash(static_cast<int>(JsonTreeModelNode::Object)), qHash(object.count() - scalarCount) );
+		hash = combineHash(hash, qHash(scalarCount));
+		for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+		{
+			if (JsonTreeModelNode::Traits::isScalar(i.value()))
+				hash = combineHash( combineHash(hash, stringHash(i.key())), scalarHash(i.value()) );
+		}
+		for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+		{
+			if (!JsonTreeModelNode::Traits::isScalar(i.value()))
+				hash = combineHash( combineHash(hash, stringHash(i.key())), valueHash(i.value()) );
+		}
+	}
+
+	if (hash == 0)
+		hash = 1;
+	return hash;
+}
+
+/*
+	Returns true if the two nodes have the same contents. Unlike comparing hashes, this never
+	gives a false positive.
+*/
+bool
+JsonTreeModel::identicalSubtrees(const JsonTreeModelNode* node, const JsonTreeModelNode* otherNode)
+{
+	if (node->type() != otherNode->type())
+		return false;
+	if (node->type() == JsonTreeModelNode::Scalar)
+		return static_cast<const JsonTreeModelScalarNode*>(node)->value() == static_cast<const JsonTreeModelScalarNode*>(otherNode)->value();
+
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	auto otherListNode = static_cast<const JsonTreeModelListNode*>(otherNode);
+	if (listNode->childCount() != otherListNode->childCount())
+		return false;
+
+	auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+	auto otherNamedNode = static_cast<const JsonTreeModelNamedListNode*>(otherNode);
+	if ( node->type() == JsonTreeModelNode::Object && namedNode->namedScalars() != otherNamedNode->namedScalars() )
+		return false;
+
+	for (int i = 0; i < listNode->childCount(); ++i)
+	{
+		auto child = listNode->childAt(i);
+		auto otherChild = otherListNode->childAt(i);
+		if ( node->type() == JsonTreeModelNode::Object && namedNode->childListNodeName(child) != otherNamedNode->childListNodeName(otherChild) )
+			return false;
+		if (!identicalSubtrees(child, otherChild))
+			return false;
+	}
+	return true;
+}
+
+/*
+	Appends the pointers of the differences between two nodes to paths. The pointer refers to
+	the first node.
+*/
+void
+JsonTreeModel::diffNodes(const JsonTreeModelNode* node, const JsonTreeModelNode* otherNode, const QString& pointer, QStringList* paths)
+{
+	if (node->type() != otherNode->type())
+	{
+		*paths << pointer;
+		return;
+	}
+	if (subtreeHash(node) == subtreeHash(otherNode))
+		return;
+
+	if (node->type() == JsonTreeModelNode::Scalar)
+	{
+		*paths << pointer;
+		return;
+	}
+
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	auto otherListNode = static_cast<const JsonTreeModelListNode*>(otherNode);
+	if (node->type() == JsonTreeModelNode::Array)
+	{
+		const int common = qMin(listNode->childCount(), otherListNode->childCount());
+		for (int i = 0; i < common; ++i)
+			diffNodes(listNode->childAt(i), otherListNode->childAt(i), childPointer(pointer, QString::number(i)), paths);
+		for (int i = common; i < qMax(listNode->childCount(), otherListNode->childCount()); ++i)
+			*paths << childPointer(pointer, QString::number(i));
+		return;
+	}
+
+	auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+	auto otherNamedNode = static_cast<const JsonTreeModelNamedListNode*>(otherNode);
+	const auto& scalars = namedNode->namedScalars();
+	const auto& otherScalars = otherNamedNode->namedScalars();
+	for (auto i = scalars.constBegin(); i != scalars.constEnd(); ++i)
+	{
+		if (otherScalars.value(i.key(), QJsonValue(QJsonValue::Undefined)) != i.value())
+			*paths << childPointer(pointer, i.key());
+	}
+	for (auto i = otherScalars.constBegin(); i != otherScalars.constEnd(); ++i)
+	{
+		if (!scalars.contains(i.key()))
+			*paths << childPointer(pointer, i.key());
+	}
+
+	// NOTE: The child rows of both objects are sorted by name, so they can be merged in one pass
+	int row = 0;
+	int otherRow = 0;
+	while (row < namedNode->childCount() || otherRow < otherNamedNode->childCount())
+	{
+		auto child = (row < namedNode->childCount()) ? namedNode->childAt(row) : nullptr;
+		auto otherChild = (otherRow < otherNamedNode->childCount()) ? otherNamedNode->childAt(otherRow) : nullptr;
+		const QString name = child ? namedNode->childListNodeName(child) : QString();
+		const QString otherName = otherChild ? otherNamedNode->childListNodeName(otherChild) : QString();
+
+		if (child != nullptr && otherChild != nullptr && name == otherName)
+		{
+			diffNodes(child, otherChild, childPointer(pointer, name), paths);
+			++row;
+			++otherRow;
+		}
+		else if ( otherChild == nullptr || (child != nullptr && name < otherName) )
+		{
+			// NOTE: A member that is a scalar in the other object was reported above
+			if (!otherScalars.contains(name))
+				*paths << childPointer(pointer, name);
+			++row;
+		}
+		else
+		{
+			if (!scalars.contains(otherName))
+				*paths << childPointer(pointer, otherName);
+			++otherRow;
+		}
+	}
+}
+
+/*
+	Marks the rows of the given node, and of its ancestors, as used.
+*/
+void
+JsonTreeModel::touchPage(const JsonTreeModelListNode* node) const
+{
+	auto document = documentNode();
+	for (; node != nullptr && node != document && node != m_rootNode; node = static_cast<const JsonTreeModelListNode*>(node->parent()))
+	{
+		// NOTE: The walk goes up from the node, so a node that already has the current stamp got it in an
+		// earlier walk that also stamped all of its ancestors. The walk can stop there.
+		auto& stamp = m_pageStamps[node];
+		if (stamp == m_pageClock)
+			break;
+		stamp = m_pageClock;
+	}
+}
+
+/*
+	Forgets the usage history, and re-estimates the resident bytes. If the document was replaced,
+	the old pages are discarded too.
+*/
+void
+JsonTreeModel::resetPaging(bool documentReplaced)
+{
+	m_pageStamps.clear();
+	m_residentBytes = (m_memoryBudget > 0) ? residentEstimate(m_rootNode) + m_compressedBytes : 0;
+	if (documentReplaced && m_pageFile != nullptr)
+		m_pageFile->resize(0);
+}
+
+/*
+	Makes trimMemory() keep the nodes that pinner appends, and their ancestors, in memory until
+	owner is destroyed. Models that store pointers to this model's nodes must attach a pinner.
+*/
+void
+JsonTreeModel::attachNodePinner(QObject* owner, const NodePinner& pinner)
+{
+	m_nodePinners.insert(owner, pinner);
+	connect(owner, &QObject::destroyed, this, [this, owner]()
+	{
+		m_nodePinners.remove(owner);
+	});
+}
+
+/*
+	Schedules trimMemory() if the model is over its budget. Evictions are deferred, so that nodes
+	are never freed while the caller (e.g. a view that called index()) may still be using them.
+*/
+void
+JsonTreeModel::scheduleTrim()
+{
+	if (m_trimScheduled || m_memoryBudget <= 0 || m_residentBytes <= m_memoryBudget)
+		return;
+
+	m_trimScheduled = true;
+	QTimer::singleShot(0, this, &JsonTreeModel::trimMemory);
+}
+
+/*
+	Writes the rows under the given node to the page file and frees them. Returns false if the
+	rows must stay in memory.
+*/
+bool
+JsonTreeModel::evictPage(JsonTreeModelListNode* node, const QSet<const JsonTreeModelNode*>& pinned)
+{
+	if (pinned.contains(node) || !node->isLoaded() || node->childCount() == 0)
+		return false;
+
+	// Expansion states and keyed arrays are attached to nodes, so they would be lost
+	QVector<const JsonTreeModelListNode*> stack{node};
+	while (!stack.isEmpty())
+	{
+		auto listNode = stack.takeLast();
+		if (listNode->isExpanded() || m_rowKeys.contains(const_cast<JsonTreeModelListNode*>(listNode)))
+			return false;
+		if (!listNode->isLoaded())
+			continue;
+
+		for (int i = 0; i < listNode->childCount(); ++i)
+		{
+			auto child = listNode->childAt(i);
+			if (child->type() != JsonTreeModelNode::Scalar)
+				stack << static_cast<const JsonTreeModelListNode*>(child);
+		}
+	}
+
+	int childCount = 0;
+	const QByteArray page = JsonTreePageLoader::encode(node, &childCount);
+	if (m_pageCompression)
+	{
+		const QByteArray compressed = qCompress(page);
+		m_compressedBytes += compressed.size();
+		m_residentBytes += compressed.size() - pageEstimate(node);
+		++m_compressionStatistics.compressedPages;
+		m_compressionStatistics.uncompressedBytes += page.size();
+		m_compressionStatistics.compressedBytes += compressed.size();
+
+		forgetDeletedNodes(node, true);
+		node->releaseChildren( new JsonTreePageLoader(this, compressed, childCount, true) );
+		return true;
+	}
+
+	if (m_pageFile == nullptr)
+	{
+		m_pageFile = new QTemporaryFile(this);
+		if (!m_pageFile->open())
+		{
+			qWarning("JsonTreeModel: Failed to create a page file");
+			delete m_pageFile;
+			m_pageFile = nullptr;
+			m_memoryBudget = 0; // NOTE: Don't retry on every trim
+			return false;
+		}
+	}
+
+	const qint64 offset = m_pageFile->size();
+	if ( !m_pageFile->seek(offset) || m_pageFile->write(page) != page.size() )
+		return false;
+
+	m_residentBytes -= pageEstimate(node);
+	forgetDeletedNodes(node, true);
+	node->releaseChildren( new JsonTreePageLoader(this, offset, page.size(), childCount) );
+	return true;
+}
+
+/*
+	Reads a page that was written by evictPage().
+*/
+QByteArray
+JsonTreeModel::readPage(qint64 offset, int length)
+{
+	if ( m_pageFile == nullptr || !m_pageFile->seek(offset) )
+		return QByteArray();
+	return m_pageFile->read(length);
+}
+
+/*
+	Called by JsonTreePageLoader after the rows under the given node were read back.
+*/
+void
+JsonTreeModel::pagedIn(JsonTreeModelListNode* node)
+{
+	encodeStrings(node);
+	if (m_memoryBudget <= 0)
+		return;
+
+	m_residentBytes += pageEstimate(node);
+	touchPage(node);
+	scheduleTrim();
+}
+
+/*
+	Called by JsonTreePageLoader after it decompressed a page, which took the given time.
+*/
+void
+JsonTreeModel::decompressedPage(qint64 nsecs)
+{
+	++m_compressionStatistics.decompressedPages;
+	m_compressionStatistics.decompressionTime += nsecs;
+}
+
+/*
+	Called by JsonTreePageLoader when a compressed page is freed, because its rows were
+	decompressed or its node was deleted.
+*/
+void
+JsonTreeModel::releaseCompressedPage(int bytes)
+{
+	m_compressedBytes -= bytes;
+	if (m_memoryBudget > 0)
+		m_residentBytes -= bytes;
+}
+
+/*
+	Adds (if sign is 1) or subtracts (if sign is -1) the estimated size of a node that was
+	inserted or is about to be deleted.
+*/
+void
+JsonTreeModel::accountResidentBytes(const JsonTreeModelNode* node, int sign)
+{
+	if (m_memoryBudget <= 0 || node == nullptr)
+		return;
+
+	m_residentBytes += sign * residentEstimate(node);
+	if (sign > 0)
+		scheduleTrim();
+}
+
+/*
+	Estimates the memory used by the given node and its descendants that are in memory. This is
+	only meant to be proportional to the real usage, which depends on the allocator.
+*/
+qint64
+JsonTreeModel::residentEstimate(const JsonTreeModelNode* node)
+{
+	static const qint64 NodeBytes = 96;
+	static const qint64 NamedScalarBytes = 64;
+
+	if (node == nullptr)
+		return 0;
+
+	if (node->type() == JsonTreeModelNode::Scalar)
+	{
+		const auto& value = static_cast<const JsonTreeModelScalarNode*>(node)->value();
+		return NodeBytes + (value.isString() ? 2 * value.toString().size() : 0);
+	}
+
+	auto listNode = static_cast<const JsonTreeModelListNode*>(node);
+	qint64 bytes = NodeBytes;
+	if (node->type() == JsonTreeModelNode::Object)
+	{
+		const auto& scalars = static_cast<const JsonTreeModelNamedListNode*>(node)->namedScalars();
+		for (auto i = scalars.constBegin(); i != scalars.constEnd(); ++i)
+			bytes += NamedScalarBytes + 2 * i.key().size() + (i.value().isString() ? 2 * i.value().toString().size() : 0);
+	}
+	if (listNode->isLoaded())
+		bytes += pageEstimate(listNode);
+	return bytes;
+}
+
+/*
+	Estimates the memory used by the rows under the given node, which are freed when the node
+	is evicted.
+*/
+qint64
+JsonTreeModel::pageEstimate(const JsonTreeModelListNode* node)
+{
+	qint64 bytes = 0;
+	for (int i = 0; i < node->childCount(); ++i)
+	{
+		auto child = node->childAt(i);
+		bytes += residentEstimate(child);
+		if (node->type() == JsonTreeModelNode::Object)
+			bytes += 2 * static_cast<const JsonTreeModelNamedListNode*>(node)->childListNodeName(child).size();
+	}
+	return bytes;
+}
+
+
+//=================================
+// JsonTreeReadSnapshot
+//=================================
+/*!
+	\class JsonTreeReadSnapshot
+	\brief The JsonTreeReadSnapshot class is an immutable view of a JsonTreeModel's data.
+
+	Snapshots are taken with JsonTreeModel::readSnapshot(). They are cheap to copy, and all of
+	their functions are thread-safe, so worker threads can query them while the model is being
+	edited. Values are addressed by JSON Pointers (RFC 6901), where the empty pointer refers to
+	the whole document.
+
+	\sa JsonTreeModel::readSnapshot()
+*/
+
+/*!
+	\fn JsonTreeReadSnapshot::JsonTreeReadSnapshot
+	\brief Constructs a null snapshot.
+*/
+
+/*!
+	\fn bool JsonTreeReadSnapshot::isNull
+	\brief Returns \c true if this snapshot was not taken from a model.
+*/
+
+/*!
+	\fn int JsonTreeReadSnapshot::revision
+	\brief Returns the model's revision at the time that this snapshot was taken.
+
+	\sa JsonTreeModel::snapshot()
+*/
+
+/*
+	Returns the member of the given object that has the given name, or the element of the given
+	array at the index in the given token; returns nullptr if it does not exist.
+*/
+const JsonTreeReadSnapshotNode::Member*
+JsonTreeReadSnapshotNode::member(const QString& token) const
+{
+	if (!isObject)
+	{
+		int i = arrayIndexFromToken(token, members.count() - 1, false);
+		return (i < 0) ? nullptr : &members.at(i);
+	}
+
+	auto i = std::lower_bound(members.constBegin(), members.constEnd(), token,
+			[](const Member& member, const QString& name) { return member.name < name; });
+	return (i != members.constEnd() && i->name == token) ? i : nullptr;
+}
+
+/*
+	Returns the array or object that this node is a copy of.
+*/
+QJsonValue
+JsonTreeReadSnapshotNode::value() const
+{
+	if (!isObject)
+	{
+		QJsonArray array;
+		for (const auto& member : members)
+			array << (member.node ? member.node->value() : member.scalar);
+		return array;
+	}
+
+	QJsonObject object;
+	for (const auto& member : members)
+		object.insert(member.name, member.node ? member.node->value() : member.scalar);
+	return object;
+}
+
+/*
+	Returns a member with the given name that holds the given value, copying arrays and objects
+	into new nodes.
+*/
+JsonTreeReadSnapshotNode::Member
+JsonTreeReadSnapshotNode::fromValue(const QString& name, const QJsonValue& value)
+{
+	Member member{name, QJsonValue(), JsonTreeReadSnapshotNodePointer()};
+	if (!value.isArray() && !value.isObject())
+	{
+		member.scalar = value;
+		return member;
+	}
+
+	member.node = JsonTreeReadSnapshotNodePointer(new JsonTreeReadSnapshotNode);
+	member.node->isObject = value.isObject();
+	auto& members = member.node->members;
+	if (value.isArray())
+	{
+		for (const auto& element : value.toArray())
+			members << fromValue(QString(), element);
+	}
+	else
+	{
+		const auto object = value.toObject();
+		for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+			members << fromValue(i.key(), i.value());
+		std::sort(members.begin(), members.end(),
+				[](const Member& left, const Member& right) { return left.name < right.name; });
+	}
+	return member;
+}
+
+/*
+	Replaces the given node with a copy where the value at the given tokens (starting from depth)
+	is changed. Only the nodes along the path are copied; the copy shares all other nodes with
+	the original. Returns false, and leaves the node untouched, if the path does not exist.
+*/
+bool
+JsonTreeReadSnapshotNode::change(JsonTreeReadSnapshotNodePointer* node, const QStringList& tokens, int depth,
+		Change change, const Member& member)
+{
+	const QString& token = tokens.at(depth);
+	const bool isLast = (depth + 1 == tokens.count());
+	JsonTreeReadSnapshotNodePointer copy(new JsonTreeReadSnapshotNode(**node));
+	auto& members = copy->members;
+
+	int i;
+	bool exists;
+	if (!copy->isObject)
+	{
+		const bool insert = (isLast && change == Add);
+		i = arrayIndexFromToken(token, insert ? members.count() : members.count() - 1, insert);
+		if (i < 0)
+			return false;
+		exists = (i < members.count());
+	}
+	else
+	{
+		auto found = std::lower_bound(members.constBegin(), members.constEnd(), token,
+				[](const Member& member, const QString& name) { return member.name < name; });
+		i = found - members.constBegin();
+		exists = (found != members.constEnd() && found->name == token);
+	}
+
+	if (!isLast)
+	{
+		if (!exists || !members.at(i).node)
+			return false;
+		if ( !JsonTreeReadSnapshotNode::change(&members[i].node, tokens, depth + 1, change, member) )
+			return false;
+	}
+	else if (change == Remove)
+	{
+		if (!exists)
+			return false;
+		members.remove(i);
+	}
+	else
+	{
+		Member named = member;
+		named.name = copy->isObject ? token : QString();
+		if (change == Replace && !exists)
+			return false;
+		if ( change == Replace || (copy->isObject && exists) )
+			members[i] = named;
+		else
+			members.insert(i, named);
+	}
+
+	*node = copy;
+	return true;
+}
+
+/*
+	Finds the value at the given JSON pointer, and copies its member entry to target. Returns
+	false if it does not exist.
+*/
+bool
+JsonTreeReadSnapshot::find(const QString& pointer, JsonTreeReadSnapshotNode::Member* target) const
+{
+	// NOTE: The empty pointer refers to the whole document, and has no tokens
+	QStringList tokens;
+	if ( !m_document || (!pointer.isEmpty() && !splitPointer(pointer, &tokens)) )
+		return false;
+
+	JsonTreeReadSnapshotNode::Member found{QString(), QJsonValue(), m_document};
+	for (const auto& token : qAsConst(tokens))
+	{
+		if (!found.node)
+			return false;
+		auto member = found.node->member(token);
+		if (member == nullptr)
+			return false;
+		found = *member;
+	}
+	*target = found;
+	return true;
+}
+
+/*
+	Changes the value at the given tokens; an empty list refers to the whole document. The
+	document can only be replaced by another array or object, which the model shows under a
+	wrapper if it is an object with scalar members; wrapped receives whether that is the case.
+*/
+bool
+JsonTreeReadSnapshot::changeDocument(const QStringList& tokens, JsonTreeReadSnapshotNode::Change change,
+		const JsonTreeReadSnapshotNode::Member& member, bool* wrapped)
+{
+	if (!tokens.isEmpty())
+		return m_document && JsonTreeReadSnapshotNode::change(&m_document, tokens, 0, change, member);
+
+	if (change == JsonTreeReadSnapshotNode::Remove || !member.node)
+		return false;
+
+	m_document = member.node;
+	*wrapped = m_document->isObject && std::any_of(m_document->members.constBegin(), m_document->members.constEnd(),
+			[](const JsonTreeReadSnapshotNode::Member& member) { return !member.node; });
+	return true;
+}
+
+/*
+	Applies a JSON Patch that the model applied successfully, or the inverse of one, to this
+	snapshot's copy of the document.
+*/
+bool
+JsonTreeReadSnapshot::applyPatch(const QJsonArray& operations, bool* wrapped)
+{
+	for (const auto& operationValue : operations)
+	{
+		const auto operation = operationValue.toObject();
+		const auto op = operation.value(QLatin1String("op")).toString();
+		const QString path = operation.value(QLatin1String("path")).toString();
+		QStringList tokens;
+		if (!splitPointer(path, &tokens))
+			return false;
+
+		JsonTreeReadSnapshotNode::Member member;
+		auto change = JsonTreeReadSnapshotNode::Add;
+		if (op == QLatin1String("add") || op == QLatin1String("replace"))
+		{
+			member = JsonTreeReadSnapshotNode::fromValue(QString(), operation.value(QLatin1String("value")));
+			if (op == QLatin1String("replace"))
+				change = JsonTreeReadSnapshotNode::Replace;
+		}
+		else if (op == QLatin1String("remove"))
+			change = JsonTreeReadSnapshotNode::Remove;
+
+		else if (op == QLatin1String("move") || op == QLatin1String("copy"))
+		{
+			// NOTE: The moved or copied value is shared, not copied
+			const QString from = operation.value(QLatin1String("from")).toString();
+			QStringList fromTokens;
+			if ( !find(from, &member) || !splitPointer(from, &fromTokens) )
+				return false;
+			if ( op == QLatin1String("move") && !changeDocument(fromTokens, JsonTreeReadSnapshotNode::Remove, member, wrapped) )
+				return false;
+		}
+		else if (op == QLatin1String("test"))
+		{
+			if ( value(path) != operation.value(QLatin1String("value")) )
+				return false;
+			continue;
+		}
+		else
+			return false;
+
+		if ( !changeDocument(tokens, change, member, wrapped) )
+			return false;
+	}
+	return true;
+}
+
+/*
+	Applies an edit that JsonTreeModel::stepJournal() would apply, to this snapshot's copy of
+	the document. The path holds row numbers, which start at the wrapper if the document is
+	wrapped; the rows of an object are its array and object members, in order.
+*/
+bool
+JsonTreeReadSnapshot::applyScalarEdit(const QVector<int>& path, const QString& column, const QJsonValue& value, bool wrapped)
+{
+	QStringList tokens;
+	JsonTreeReadSnapshotNodePointer node = m_document;
+	for (int i = wrapped ? 1 : 0; i < path.count(); ++i)
+	{
+		if (!node)
+			return false;
+
+		const int row = path.at(i);
+		const JsonTreeReadSnapshotNode::Member* member = nullptr;
+		if (!node->isObject)
+		{
+			if (row >= 0 && row < node->members.count())
+				member = &node->members.at(row);
+			tokens << QString::number(row);
+		}
+		else
+		{
+			int childRow = 0;
+			for (const auto& objectMember : qAsConst(node->members))
+			{
+				if (objectMember.node && childRow++ == row)
+				{
+					member = &objectMember;
+					break;
+				}
+			}
+			if (member != nullptr)
+				tokens << member->name;
+		}
+		if (member == nullptr)
+			return false;
+		node = member->node;
+	}
+
+	bool unused;
+	if (column.isNull())
+	{
+		return !tokens.isEmpty() && !node
+				&& changeDocument(tokens, JsonTreeReadSnapshotNode::Replace, JsonTreeReadSnapshotNode::fromValue(QString(), value), &unused);
+	}
+
+	if (!node || !node->isObject)
+		return false;
+	tokens << column;
+	if (value.isUndefined())
+		return changeDocument(tokens, JsonTreeReadSnapshotNode::Remove, JsonTreeReadSnapshotNode::Member(), &unused);
+	return changeDocument(tokens, JsonTreeReadSnapshotNode::Add, JsonTreeReadSnapshotNode::fromValue(QString(), value), &unused);
+}
+
+/*!
+	\brief Returns the value at the given JSON \a pointer, or an undefined value if it does not exist.
+
+	Arrays and objects are assembled from the snapshot's copy when they are requested, so reading
+	a large subtree this way costs as much as calling JsonTreeModel::json() on it. Use childCount()
+	and memberNames() to walk the data without assembling it.
+*/
+QJsonValue
+JsonTreeReadSnapshot::value(const QString& pointer) const
+{
+	if (pointer.isEmpty() && !m_document)
+		return QJsonValue(); // NOTE: Like JsonTreeModel::json() on an empty model
+
+	JsonTreeReadSnapshotNode::Member member;
+	if (!find(pointer, &member))
+		return QJsonValue(QJsonValue::Undefined);
+	return member.node ? member.node->value() : member.scalar;
+}
+
+/*!
+	\brief Returns the number of elements or members of the array or object at the given JSON
+	\a pointer, or 0 if it is a scalar or does not exist.
+
+	Together with value(), this allows the elements of an array to be iterated; use
+	memberNames() to iterate the members of an object.
+*/
+int
+JsonTreeReadSnapshot::childCount(const QString& pointer) const
+{
+	JsonTreeReadSnapshotNode::Member member;
+	if (!find(pointer, &member) || !member.node)
+		return 0;
+	return member.node->members.count();
+}
+
+/*!
+	\brief Returns the member names of the object at the given JSON \a pointer, or an empty
+	list if it is not an object.
+*/
+QStringList
+JsonTreeReadSnapshot::memberNames(const QString& pointer) const
+{
+	JsonTreeReadSnapshotNode::Member member;
+	if (!find(pointer, &member) || !member.node || !member.node->isObject)
+		return QStringList();
+
+	QStringList names;
+	names.reserve(member.node->members.count());
+	for (const auto& objectMember : qAsConst(member.node->members))
+		names << objectMember.name;
+	return names;
 }
@@ -9,9 +9,20 @@
 #ifndef JSONTREEMODEL_H
 #define JSONTREEMODEL_H
 
+#include "datatreemodelcore.h"
 #include <QAbstractItemModel>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QAtomicPointer>
+#include <QExplicitlySharedDataPointer>
+#include <functional>
+
+class QIODevice;
+class QFileSystemWatcher;
+class QTimer;
+class QTemporaryFile;
+class JsonTreeQuery;
+class JsonTreeStringDictionary;
 
 //=================================
 // JsonTreeModelNode and subclasses
@@ -25,123 +36,68 @@
 	TODO: Support user-defined icons for different datatypes in Structure column???
 	TODO: Support user-defined font for Array indices in Structure column???
 */
-class JsonTreeModelNode
-{
-public:
-	enum Type {
-		Scalar, ///< Represents scalar JSON values (nulls, Booleans, numbers, and strings).
-		Object, ///< Represents JSON objects.
-		Array   ///< Represents JSON arrays.
-	};
-
-	JsonTreeModelNode(JsonTreeModelNode* parent) : m_parent(parent) {}
-	virtual ~JsonTreeModelNode() {}
-
-	inline JsonTreeModelNode* parent() const
-	{ return m_parent; }
+typedef DataTreeModelNode<QJsonValue>          JsonTreeModelNode;
+typedef DataTreeModelScalarNode<QJsonValue>    JsonTreeModelScalarNode;
+typedef DataTreeModelListNode<QJsonValue>      JsonTreeModelListNode;
+typedef DataTreeModelNamedListNode<QJsonValue> JsonTreeModelNamedListNode;
+typedef DataTreeModelWrapperNode<QJsonValue>   JsonTreeModelWrapperNode;
+typedef DataTreeModelCore<QJsonValue>          JsonTreeModelCore;
 
-	inline void setParent(JsonTreeModelNode* parent)
-	{ Q_ASSERT(parent->type() != Scalar); m_parent = parent; }
 
-	virtual Type type() const = 0;
-	virtual QJsonValue value() const = 0;
-
-private:
-	// NOTE: Only JsonTreeModelListNode can be a parent, but I don't want to introduce a dependency to a subclass
-	JsonTreeModelNode* m_parent;
-};
-
-class JsonTreeModelScalarNode : public JsonTreeModelNode
-{
-public:
-	JsonTreeModelScalarNode(const QJsonValue& value, JsonTreeModelNode* parent);
-
-	QJsonValue value() const override
-	{ return m_value; }
-
-	void setValue(const QJsonValue& value)
-	{ m_value = value; }
-
-	Type type() const override
-	{ return Scalar; }
-
-private:
-	QJsonValue m_value;
-};
-
-class JsonTreeModelListNode : public JsonTreeModelNode
+//=================================
+// JsonTreeReadSnapshot
+//=================================
+/*
+	An immutable copy of an array or object. The snapshots of different revisions share the
+	copies of the arrays and objects that did not change between them.
+*/
+struct JsonTreeReadSnapshotNode : public QSharedData
 {
-public:
-	JsonTreeModelListNode(JsonTreeModelNode* parent) : JsonTreeModelNode(parent) {}
-	JsonTreeModelListNode(const QJsonArray& array, JsonTreeModelNode* parent);
-
-	~JsonTreeModelListNode() override
+	struct Member
 	{
-		// TODO: Tell parent to remove this child from its list? Only if we do partial deletions
-		qDeleteAll(m_childList);
-	}
-
-	inline JsonTreeModelNode* childAt(int i) const
-	{ return m_childList[i]; }
-
-	inline int childCount() const
-	{ return m_childList.count(); }
-
-	inline int childPosition(JsonTreeModelNode* child) const
-	{ return m_childPositions.value(child, -1); }
+		QString name; // NOTE: Empty for array elements
+		QJsonValue scalar;
+		QExplicitlySharedDataPointer<JsonTreeReadSnapshotNode> node; // NOTE: Null for scalars
+	};
 
-	Type type() const override
-	{ return Array; }
+	enum Change { Add, Remove, Replace };
 
-	QJsonValue value() const override;
+	bool isObject;
+	QVector<Member> members; // NOTE: Object members are sorted by name
 
-protected:
-	void registerChild(JsonTreeModelNode* child);
-	void deregisterChild(JsonTreeModelNode* child);
+	const Member* member(const QString& token) const;
+	QJsonValue value() const;
 
-private:
-	QVector<JsonTreeModelNode*> m_childList;
-	QMap<JsonTreeModelNode*, int> m_childPositions;
+	static Member fromValue(const QString& name, const QJsonValue& value);
+	static bool change(QExplicitlySharedDataPointer<JsonTreeReadSnapshotNode>* node, const QStringList& tokens, int depth,
+			Change change, const Member& member);
 };
+typedef QExplicitlySharedDataPointer<JsonTreeReadSnapshotNode> JsonTreeReadSnapshotNodePointer;
 
-class JsonTreeModelNamedListNode : public JsonTreeModelListNode
+class JsonTreeReadSnapshot
 {
 public:
-	JsonTreeModelNamedListNode(const QJsonObject& object, JsonTreeModelNode* parent);
-
-	inline QString childListNodeName(JsonTreeModelNode* child) const
-	{ return m_childListNodeNames[child]; }
-
-	inline int namedScalarCount() const
-	{ return m_namedScalarMap.size(); }
-
-	inline QJsonValue namedScalarValue(const QString& name) const
-	{ return m_namedScalarMap[name]; }
-
-	inline void setNamedScalarValue(const QString& name, const QJsonValue& value)
-	{
-		Q_ASSERT(value.type() != QJsonValue::Undefined && value.type() != QJsonValue::Array && value.type() != QJsonValue::Object);
-		m_namedScalarMap[name] = value;
-	}
+	JsonTreeReadSnapshot() : m_revision(-1) {}
 
-	Type type() const override
-	{ return Object; }
+	bool isNull() const { return m_revision < 0; }
+	int revision() const { return m_revision; }
 
-	QJsonValue value() const override;
+	QJsonValue value(const QString& pointer = QString()) const;
+	int childCount(const QString& pointer = QString()) const;
+	QStringList memberNames(const QString& pointer = QString()) const;
 
 private:
-	// TODO: Use JsonTreeModelListNode::childPosition() for indexing; not need for map with m_childListNodeNames
-	QMap<JsonTreeModelNode*, QString> m_childListNodeNames;
-	QMap<QString, QJsonValue> m_namedScalarMap;
-};
+	JsonTreeReadSnapshot(const JsonTreeReadSnapshotNodePointer& document, int revision) : m_document(document), m_revision(revision) {}
 
-class JsonTreeModelWrapperNode : public JsonTreeModelListNode
-{
-public:
-	JsonTreeModelWrapperNode(JsonTreeModelNamedListNode* realNode);
+	bool find(const QString& pointer, JsonTreeReadSnapshotNode::Member* target) const;
+	bool changeDocument(const QStringList& tokens, JsonTreeReadSnapshotNode::Change change, const JsonTreeReadSnapshotNode::Member& member, bool* wrapped);
+	bool applyPatch(const QJsonArray& operations, bool* wrapped);
+	bool applyScalarEdit(const QVector<int>& path, const QString& column, const QJsonValue& value, bool wrapped);
+
+	JsonTreeReadSnapshotNodePointer m_document; // NOTE: Null if the model has no document
+	int m_revision;
 
-	QJsonValue value() const override
-	{ return childAt(0)->value(); } // ASSUMPTION: A wrapper node will always have exactly 1 child JsonTreeModelNamedListNode
+	friend class JsonTreeModel;
 };
 
 
@@ -161,8 +117,39 @@ public:
 		ComprehensiveSearch
 	};
 
+	enum ExportOption
+	{
+		NoExportOptions = 0x0,
+		TabSeparated = 0x1,
+		OmitHeader = 0x2,
+		Recursive = 0x4
+	};
+	Q_DECLARE_FLAGS(ExportOptions, ExportOption)
+
+	// NOTE: These start well above Qt::UserRole, so that they don't clash with the roles of JsonTreeFlatModel
+	enum Roles
+	{
+		KeyRole = Qt::UserRole + 0x100,
+		ValueRole,
+		TypeRole,
+		ScalarColumnRole // The first of the roles of the named scalar columns
+	};
+
+	struct CompressionStatistics
+	{
+		CompressionStatistics() : compressedPages(0), uncompressedBytes(0), compressedBytes(0), decompressedPages(0), decompressionTime(0) {}
+
+		double ratio() const { return (compressedBytes > 0) ? double(uncompressedBytes) / compressedBytes : 0.0; }
+
+		int compressedPages;
+		qint64 uncompressedBytes;
+		qint64 compressedBytes;
+		int decompressedPages;
+		qint64 decompressionTime; // In nanoseconds
+	};
+
 	explicit JsonTreeModel(QObject* parent = nullptr);
-	~JsonTreeModel() override { delete m_rootNode; }
+	~JsonTreeModel() override;
 
 	// Header:
 	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
@@ -175,26 +162,286 @@ public:
 	int columnCount(const QModelIndex& parent = QModelIndex()) const override;
 
 	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QHash<int, QByteArray> roleNames() const override;
 
 	// Editable:
 	bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
 	Qt::ItemFlags flags(const QModelIndex& index) const override;
 
+	int setDataBatch(const QVector<QPair<QModelIndex, QVariant>>& cells, int role = Qt::EditRole);
+	int setDataBatch(const QModelIndex& topLeft, int columnCount, const QVariantList& values, int role = Qt::EditRole);
+
+	// Change notifications:
+	void setNotificationInterval(int msec);
+	int notificationInterval() const;
+	void flushChanges();
+
+	// Updates from other threads:
+	void postUpdate(const QString& pointer, const QJsonValue& value);
+	int applyPostedUpdates();
+	void setUpdateInterval(int msec);
+	int updateInterval() const;
+
 	// API specific to JsonTreeModel:
 	void setJson(const QJsonArray& array, ScalarColumnSearchMode searchMode = QuickSearch);
 	void setJson(const QJsonObject& object, ScalarColumnSearchMode searchMode = QuickSearch);
 	QJsonValue json(const QModelIndex& index = QModelIndex()) const;
+	QByteArray preview(const QModelIndex& index = QModelIndex(), int maxBytes = 64 * 1024, int maxDepth = 64) const;
 
 	// TODO: Decide if the json()/setJson() API should be symmetrical or not
 
+	bool saveSnapshot(QIODevice* device) const;
+	bool loadSnapshot(QIODevice* device);
+
+	bool loadNdjson(QIODevice* device, ScalarColumnSearchMode searchMode = QuickSearch);
+	bool followNdjson(const QString& fileName, ScalarColumnSearchMode searchMode = QuickSearch);
+	void stopFollowing();
+	bool isFollowing() const { return m_followWatcher != nullptr; }
+
+	bool exportDelimited(QIODevice* device, const QModelIndex& parent = QModelIndex(), const QVector<int>& columns = QVector<int>(),
+			ExportOptions options = NoExportOptions, int firstRow = 0, int lastRow = -1) const;
+
 	void setScalarColumns(const QStringList& columns);
 	QStringList scalarColumns() const { return m_headers.mid(2); }
 
+	void setColumnProjection(bool enabled) { m_columnProjection = enabled; }
+	bool columnProjection() const { return m_columnProjection; }
+
+	void setBranchColumns(bool enabled);
+	bool branchColumns() const { return m_branchColumns; }
+	QStringList scalarColumns(const QModelIndex& parent) const;
+
+	void setDictionaryEncoding(int maxCardinality);
+	int dictionaryEncoding() const;
+
+	void setSubtreeSharing(bool enabled) { m_subtreeSharing = enabled; }
+	bool subtreeSharing() const { return m_subtreeSharing; }
+
+	// Revisions:
+	int snapshot() const { return m_journalBase + m_journalPosition; }
+	bool restore(int revision);
+
+	bool canUndo() const { return m_journalPosition > 0; }
+	bool canRedo() const { return m_journalPosition < m_journal.count(); }
+	bool undo();
+	bool redo();
+
+	void setUndoLimit(int limit);
+	int undoLimit() const { return m_undoLimit; }
+
+	JsonTreeReadSnapshot readSnapshot() const;
+	JsonTreeReadSnapshot readSnapshot(int revision) const;
+
+	// Comparison:
+	QStringList diff(const JsonTreeModel& other) const;
+
+	// Queries:
+	QModelIndexList query(const JsonTreeQuery& query) const;
+	QJsonArray queryValues(const JsonTreeQuery& query) const;
+
+	// Patches:
+	bool applyPatch(const QJsonArray& patch);
+
+	// Keyed rows:
+	bool setRowKey(const QModelIndex& parent, const QString& column);
+	QString rowKey(const QModelIndex& parent = QModelIndex()) const;
+	QModelIndex indexForKey(const QModelIndex& parent, const QJsonValue& key) const;
+	QModelIndex upsertRow(const QModelIndex& parent, const QJsonObject& object);
+
+	// Memory budget:
+	void setMemoryBudget(qint64 bytes);
+	qint64 memoryBudget() const { return m_memoryBudget; }
+	qint64 residentBytes() const { return m_residentBytes; }
+	void trimMemory();
+
+	void setPageCompression(bool enabled) { m_pageCompression = enabled; }
+	bool pageCompression() const { return m_pageCompression; }
+	CompressionStatistics compressionStatistics() const { return m_compressionStatistics; }
+	void resetCompressionStatistics() { m_compressionStatistics = CompressionStatistics(); }
+
 private:
+	// A reversible change to a single scalar, addressed by its location rather than by its node
+	struct Edit
+	{
+		QVector<int> path;    // Row numbers from the root node to the edited node
+		QString column;       // Named scalar column, or a null string for the "Scalar" column
+		QJsonValue oldValue;  // Undefined if the named scalar did not exist
+		QJsonValue newValue;
+
+		// For patches, the fields above are unused
+		QJsonArray patch;
+		QJsonArray inversePatch;
+	};
+
+	// The rows of a keyed array, looked up by the string form of their keys
+	struct RowKeyIndex
+	{
+		QString column;
+		QHash<QString, JsonTreeModelNode*> rows;
+	};
+
+	// An update from postUpdate(), in a lock-free stack that the model's thread takes over as a whole
+	struct PostedUpdate
+	{
+		QString pointer;
+		QJsonValue value;
+		PostedUpdate* next;
+	};
+
+	// Packed (row << 32 | column) cells whose dataChanged() signals are pending, grouped by parent node
+	typedef QHash<JsonTreeModelListNode*, QVector<quint64>> DirtyCells;
+
 	bool isEditable(const QModelIndex& index) const;
 
+	bool writeData(const QModelIndex& index, const QVariant& value);
+	QJsonValue storedScalar(const JsonTreeModelNode* node, const QString& column) const;
+	void markDirty(DirtyCells& dirty, JsonTreeModelNode* node, int row, int column);
+	void notifyDataChanged(DirtyCells& dirty, const QVector<int>& roles);
+	void emitDataChanged(DirtyCells& dirty, const QVector<int>& roles);
+	QVector<int> itemRoles(const JsonTreeModelListNode* parentNode, const QVector<int>& roles, int left, int right) const;
+	QModelIndex roleIndex(const QModelIndex& index, int role) const;
+	void discardPendingChanges();
+	void invalidateReadCache() { m_readCacheValid = false; m_readCache.reset(); }
+	JsonTreeReadSnapshotNodePointer readSnapshotNode(const JsonTreeModelListNode* node) const;
+	void forgetReadSnapshotNodes(const JsonTreeModelNode* node, bool descendantsOnly);
+	void flushBeforeRowChange(DirtyCells& dirty);
+	void markNamedScalarDirty(DirtyCells& dirty, JsonTreeModelNamedListNode* object, const QString& name);
+
+	JsonTreeModelListNode* resolvePointer(const QString& pointer, QString* lastToken) const;
+	bool pointerValue(const QString& pointer, QJsonValue* value) const;
+	bool applyPatchOperations(const QJsonArray& operations, QJsonArray* inverse, DirtyCells& dirty);
+	bool patchAdd(const QString& path, const QJsonValue& value, bool replace, QJsonObject* inverse, DirtyCells& dirty);
+	void insertElement(JsonTreeModelListNode* array, int row, const QJsonValue& value, DirtyCells& dirty);
+	bool addMember(JsonTreeModelNamedListNode* object, const QString& path, const QString& token, const QJsonValue& value,
+			bool replace, QJsonObject* inverse, DirtyCells& dirty);
+	bool patchRemove(const QString& path, QJsonObject* inverse, DirtyCells& dirty);
+	void replaceDocument(const QJsonValue& value);
+	bool applyUpdate(const QString& pointer, const QJsonValue& value, DirtyCells& dirty, QJsonObject* operation, QJsonObject* inverse);
+
+	void indexRowKey(JsonTreeModelListNode* array, JsonTreeModelNode* child);
+	void forgetRowKeys(JsonTreeModelListNode* parentNode, JsonTreeModelNode* child);
+	void updateRowKey(JsonTreeModelNamedListNode* object, const QString& name, const QJsonValue& oldValue, const QJsonValue& newValue);
+
+	// Appends the nodes that a model which is attached to this model refers to
+	typedef std::function<void(QVector<const JsonTreeModelNode*>* nodes)> NodePinner;
+	void attachNodePinner(QObject* owner, const NodePinner& pinner);
+
+	void touchPage(const JsonTreeModelListNode* node) const;
+	void resetPaging(bool documentReplaced);
+	void scheduleTrim();
+	bool evictPage(JsonTreeModelListNode* node, const QSet<const JsonTreeModelNode*>& pinned);
+	QByteArray readPage(qint64 offset, int length);
+	void pagedIn(JsonTreeModelListNode* node);
+	void decompressedPage(qint64 nsecs);
+	void releaseCompressedPage(int bytes);
+	void accountResidentBytes(const JsonTreeModelNode* node, int sign);
+	static qint64 residentEstimate(const JsonTreeModelNode* node);
+	static qint64 pageEstimate(const JsonTreeModelListNode* node);
+
+	QVector<JsonTreeModelNode*> parseNdjson(const QByteArray& data, ScalarColumnSearchMode searchMode);
+	void resetNdjson(const QByteArray& data, ScalarColumnSearchMode searchMode);
+	void readFollowedFile();
+
+	static quint64 subtreeHash(const JsonTreeModelNode* node);
+	static quint64 valueHash(const QJsonValue& value);
+	static bool identicalSubtrees(const JsonTreeModelNode* node, const JsonTreeModelNode* otherNode);
+	static void diffNodes(const JsonTreeModelNode* node, const JsonTreeModelNode* otherNode, const QString& pointer, QStringList* paths);
+
+	void encodeStrings(JsonTreeModelNode* node);
+	QJsonValue encodedValue(const QString& column, const QJsonValue& value);
+	void shareIdenticalSubtrees();
+
+	QStringList columnsFor(const JsonTreeModelNode* parentNode) const;
+	int branchColumn(const JsonTreeModelNode* node, int column) const;
+	int modelColumn(const JsonTreeModelNode* node, int column) const;
+	void extendBranchColumns(JsonTreeModelListNode* parentNode, int first, int last);
+	void forgetBranchColumns(const JsonTreeModelNode* node, bool descendantsOnly);
+	void forgetDeletedNodes(const JsonTreeModelNode* node, bool descendantsOnly = false);
+
+	void buildDocument(const QJsonValue& value, ScalarColumnSearchMode searchMode);
+	void setFoundColumns(const QSet<QString>& names);
+	static JsonTreeModelListNode* createRootNode(const QJsonValue& value, const QSet<QString>* projection = nullptr,
+			DataTreeScalarNameCollector* collector = nullptr);
+	const QSet<QString>* projection() const { return m_columnProjection ? &m_projectedColumns : nullptr; }
+	JsonTreeModelListNode* documentNode() const;
+	QModelIndex nodeIndex(const JsonTreeModelNode* node) const;
+	QString nodePointer(const JsonTreeModelNode* node) const;
+
+	QVector<int> nodePath(const JsonTreeModelNode* node) const;
+	JsonTreeModelNode* nodeAtPath(const QVector<int>& path) const;
+
+	void writeScalar(JsonTreeModelNode* node, const QString& column, const QJsonValue& value);
+	void storeScalar(JsonTreeModelNode* node, const QString& column, const QJsonValue& value);
+	void appendJournal(const Edit& edit);
+	bool stepJournal(bool forward, DirtyCells* dirty);
+	void clearJournal();
+	void resetDocumentState(bool keepJournal = false);
+
 	JsonTreeModelListNode* m_rootNode;
 	QStringList m_headers;
+	bool m_columnProjection;
+	QSet<QString> m_projectedColumns;
+
+	// NOTE: In branch column mode, the headers of the rows under each array or object are found on demand
+	bool m_branchColumns;
+	mutable QHash<const JsonTreeModelListNode*, QStringList> m_branchColumnCache;
+
+	QList<Edit> m_journal;
+	int m_journalBase;
+	int m_journalPosition;
+	int m_undoLimit;
+
+	QTimer* m_notificationTimer;
+	DirtyCells m_pendingChanges;
+	QVector<int> m_pendingRoles;
+
+	QAtomicPointer<PostedUpdate> m_postedUpdates;
+	QTimer* m_updateTimer;
+
+	QHash<JsonTreeModelListNode*, RowKeyIndex> m_rowKeys;
+
+	// NOTE: Built on demand by readSnapshot(), and shared by all snapshots until the data changes. The copy of each
+	// array or object is kept with the subtree hash that it was built for, and is reused while the hash is unchanged.
+	struct ReadSnapshotEntry
+	{
+		quint64 hash;
+		JsonTreeReadSnapshotNodePointer node;
+	};
+	mutable QHash<const JsonTreeModelListNode*, ReadSnapshotEntry> m_readSnapshotNodes;
+	mutable JsonTreeReadSnapshotNodePointer m_readCache;
+	mutable bool m_readCacheValid;
+
+	// NOTE: Evicted rows are appended to m_pageFile, which is only truncated when the document is replaced
+	qint64 m_memoryBudget;
+	qint64 m_residentBytes;
+	quint64 m_pageClock;
+	mutable QHash<const JsonTreeModelListNode*, quint64> m_pageStamps;
+	QTemporaryFile* m_pageFile;
+	bool m_trimScheduled;
+
+	// NOTE: The nodes that attached models refer to are never evicted, like the nodes of persistent indexes
+	QHash<QObject*, NodePinner> m_nodePinners;
+
+	// NOTE: With page compression, evicted rows are kept in memory; m_compressedBytes is included in m_residentBytes
+	bool m_pageCompression;
+	qint64 m_compressedBytes;
+	CompressionStatistics m_compressionStatistics;
+
+	JsonTreeStringDictionary* m_dictionary;
+	bool m_subtreeSharing;
+
+	// NOTE: m_followOffset is the end of the data that was read; m_followTail is the incomplete last line within it
+	QFileSystemWatcher* m_followWatcher;
+	QString m_followPath;
+	qint64 m_followOffset;
+	QByteArray m_followTail;
+	ScalarColumnSearchMode m_followSearchMode;
+
+	friend class JsonTreeFlatModel;
+	friend class JsonTreeFilterModel;
+	friend class JsonTreePageLoader;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(JsonTreeModel::ExportOptions)
+
 #endif // JSONTREEMODEL_H
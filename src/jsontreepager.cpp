@@ -0,0 +1,102 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreepager.h"
+#include <QJsonDocument>
+#include <QElapsedTimer>
+
+/*
+	Page format
+	===========
+	A page holds the child rows of one array or object in Qt's binary JSON format, which can be
+	loaded without parsing:
+
+	- For an array, the page is the whole array.
+	- For an object, the page is an object that only contains the non-scalar members. The named
+	  scalars are shown in the object's own row, so they are never paged out.
+
+	With page compression, the page is compressed with qCompress() and kept in the loader instead
+	of the page file.
+*/
+
+JsonTreePageLoader::~JsonTreePageLoader()
+{
+	if (m_compressed)
+		m_model->releaseCompressedPage(m_page.size());
+}
+
+/*
+	Returns the page that holds the child rows of the given node, and the number of rows.
+*/
+QByteArray
+JsonTreePageLoader::encode(const JsonTreeModelListNode* node, int* childCount)
+{
+	*childCount = node->childCount();
+	if (node->type() == JsonTreeModelNode::Array)
+		return QJsonDocument(node->value().toArray()).toBinaryData();
+
+	auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+	QJsonObject children;
+	for (int i = 0; i < *childCount; ++i)
+	{
+		auto child = namedNode->childAt(i);
+		children.insert(namedNode->childListNodeName(child), child->value());
+	}
+	return QJsonDocument(children).toBinaryData();
+}
+
+/*
+	Re-creates the child rows from the page file or the page in memory.
+*/
+void
+JsonTreePageLoader::load(JsonTreeModelListNode* node)
+{
+	QByteArray page;
+	if (m_compressed)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		page = qUncompress(m_page);
+		m_model->decompressedPage(timer.nsecsElapsed());
+	}
+	else
+		page = m_page.isNull() ? m_model->readPage(m_offset, m_length) : m_page;
+
+	const auto document = QJsonDocument::fromBinaryData(page);
+	if (document.isNull())
+		qWarning("JsonTreeModel: Failed to read a page of evicted rows");
+
+	int count = 0;
+	if (node->type() == JsonTreeModelNode::Array)
+	{
+		const auto array = document.array();
+		for (const auto& element : array)
+		{
+			appendChild(node, createChild(node, element, m_model->projection()));
+			++count;
+		}
+
+		// NOTE: The views were already told how many rows to expect, so a page that could not be read is padded
+		for (; count < m_childCount; ++count)
+			appendChild(node, createChild(node, QJsonValue()));
+	}
+	else
+	{
+		auto namedNode = static_cast<JsonTreeModelNamedListNode*>(node);
+		const auto object = document.object();
+		for (auto i = object.constBegin(); i != object.constEnd(); ++i)
+		{
+			appendNamedChild(namedNode, i.key(), createChild(node, i.value(), m_model->projection()));
+			++count;
+		}
+		for (; count < m_childCount; ++count)
+			appendNamedChild(namedNode, QString::number(count), createChild(node, QJsonObject()));
+	}
+
+	m_model->pagedIn(node);
+}
@@ -0,0 +1,56 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREEPAGER_H
+#define JSONTREEPAGER_H
+
+#include "jsontreemodel.h"
+
+//=================================
+// Page loader
+//=================================
+class JsonTreePageLoader : public DataTreeModelNodeLoader<QJsonValue>
+{
+public:
+	JsonTreePageLoader(JsonTreeModel* model, qint64 offset, int length, int childCount) :
+		m_model(model),
+		m_offset(offset),
+		m_length(length),
+		m_childCount(childCount),
+		m_compressed(false)
+	{}
+
+	// A page that is kept in memory instead of the page file
+	JsonTreePageLoader(JsonTreeModel* model, const QByteArray& page, int childCount, bool compressed = false) :
+		m_model(model),
+		m_offset(-1),
+		m_length(page.size()),
+		m_childCount(childCount),
+		m_page(page),
+		m_compressed(compressed)
+	{}
+
+	~JsonTreePageLoader() override;
+
+	int childCount() const override
+	{ return m_childCount; }
+
+	void load(JsonTreeModelListNode* node) override;
+
+	static QByteArray encode(const JsonTreeModelListNode* node, int* childCount);
+
+private:
+	JsonTreeModel* m_model;
+	qint64 m_offset;
+	int m_length;
+	int m_childCount;
+	QByteArray m_page; // Implicitly shared by the loaders of identical subtrees
+	bool m_compressed;
+};
+
+#endif // JSONTREEPAGER_H
@@ -0,0 +1,561 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreequery.h"
+#include "jsontreedictionary.h"
+#include <algorithm>
+
+/*!
+	\class JsonTreeQuery
+	\brief The JsonTreeQuery class is a compiled JSONPath-like expression, which can be evaluated
+	by JsonTreeModel::query() and JsonTreeModel::queryValues().
+
+	The expression is parsed once, when the query is constructed. Evaluating the query walks the
+	model's nodes directly: members are looked up by name, and filters compare the stored
+	QJsonValues of the named scalars without going through \c data() or QVariant. The members
+	that column projection left out are read without being materialized.
+
+	The following subset of JSONPath is supported:
+
+	- \c $ is the whole document. Every expression starts with it.
+	- \c .name or \c ['name'] selects a member of an object. A name that follows a dot ends at
+	  the next \c . or \c [, so it may contain spaces.
+	- \c [n] selects an element of an array. A negative \c n counts from the end.
+	- \c .* or \c [*] selects all elements of an array, or all members of an object.
+	- \c ..name, \c ..* or \c ..[n] applies the next step to the current node and to all of its
+	  descendants.
+	- \c [?(condition)] selects the elements of an array (or the members of an object) that match
+	  the condition. A condition compares \c @ (the element itself) or \c @.name (a scalar member
+	  of the element) with a number, a quoted string, \c true, \c false or \c null, using \c ==,
+	  \c !=, \c <, \c <=, \c > or \c >=. A condition without a comparison checks that the member
+	  exists. Conditions can be combined with \c && and \c ||, where \c && binds more tightly.
+
+	For example, \c "$.Analog Inputs[?(@.Scale > 2)].Channel Name" selects the channel names of
+	the analog inputs whose scale is greater than 2.
+
+	Numbers are compared numerically and strings are compared by their UTF-16 code units. Values
+	of different types are never equal, and are never less or greater than each other.
+
+	\sa JsonTreeModel::query()
+*/
+
+/*
+	Returns the names of the scalar members of an object in alphabetical order, which is the
+	order of its named scalar columns.
+*/
+static QStringList
+sortedScalarNames(const JsonTreeModelNamedListNode* node)
+{
+	QSet<QString> names;
+	node->collectNamedScalarNames(&names);
+	QStringList sorted = names.values();
+	std::sort(sorted.begin(), sorted.end());
+	return sorted;
+}
+
+/*!
+	\brief Compiles the given JSONPath-like \a expression.
+
+	If the expression is malformed, the query is invalid and errorString() describes the problem.
+
+	\sa isValid()
+*/
+JsonTreeQuery::JsonTreeQuery(const QString& expression) :
+	m_expression(expression),
+	m_isValid(false)
+{
+	m_isValid = parse();
+	if (!m_isValid)
+		m_steps.clear();
+}
+
+/*!
+	\fn bool JsonTreeQuery::isValid
+	\brief Returns \c true if the expression was compiled successfully.
+*/
+
+/*!
+	\fn QString JsonTreeQuery::errorString
+	\brief Returns a description of the problem if the expression is malformed.
+*/
+
+/*!
+	\brief Returns the nodes (and named scalars) under the given \a document node that match
+	the query, in document order.
+
+	If the document's strings were deduplicated by a \a dictionary, the string operands of the
+	filters are replaced by the dictionary's copies first, so that equal strings are recognized
+	without comparing them.
+*/
+QVector<JsonTreeQuery::Match>
+JsonTreeQuery::evaluate(JsonTreeModelListNode* document, const JsonTreeStringDictionary* dictionary) const
+{
+	QVector<Match> current;
+	if (!m_isValid || document == nullptr)
+		return current;
+
+	QVector<Step> steps = m_steps;
+	if (dictionary != nullptr)
+	{
+		for (auto& step : steps)
+		{
+			for (auto& term : step.terms)
+			{
+				for (auto& condition : term)
+					condition.operand = dictionary->shared(condition.member, condition.operand);
+			}
+		}
+	}
+
+	current << Match{document, QString()};
+	for (const auto& step : qAsConst(steps))
+	{
+		QVector<Match> next;
+		for (const auto& match : qAsConst(current))
+		{
+			// NOTE: Named scalars have no members or elements
+			if (!match.scalarName.isNull() || match.node->type() == JsonTreeModelNode::Scalar)
+				continue;
+
+			auto listNode = static_cast<JsonTreeModelListNode*>(match.node);
+			const bool isObject = (listNode->type() == JsonTreeModelNode::Object);
+			switch (step.type)
+			{
+			case Member:
+				if (isObject)
+				{
+					auto namedNode = static_cast<JsonTreeModelNamedListNode*>(listNode);
+					if (namedNode->hasNamedScalar(step.name))
+						next << Match{namedNode, step.name};
+					else if (auto child = namedNode->namedChild(step.name))
+						next << Match{child, QString()};
+				}
+				break;
+
+			case Element:
+				if (!isObject)
+				{
+					const int row = (step.index < 0) ? listNode->childCount() + step.index : step.index;
+					if (row >= 0 && row < listNode->childCount())
+						next << Match{listNode->childAt(row), QString()};
+				}
+				break;
+
+			case Wildcard:
+				if (isObject)
+				{
+					for (const auto& name : sortedScalarNames(static_cast<JsonTreeModelNamedListNode*>(listNode)))
+						next << Match{listNode, name};
+				}
+				for (int i = 0; i < listNode->childCount(); ++i)
+					next << Match{listNode->childAt(i), QString()};
+				break;
+
+			case Descendants:
+				{
+					// Depth-first, so that the matches stay in document order
+					QVector<JsonTreeModelListNode*> stack{listNode};
+					while (!stack.isEmpty())
+					{
+						auto node = stack.takeLast();
+						next << Match{node, QString()};
+						for (int i = node->childCount() - 1; i >= 0; --i)
+						{
+							auto child = node->childAt(i);
+							if (child->type() != JsonTreeModelNode::Scalar)
+								stack << static_cast<JsonTreeModelListNode*>(child);
+						}
+					}
+				}
+				break;
+
+			case Filter:
+				// NOTE: Like the wildcard, the filter visits the scalar members of an object before its other members
+				if (isObject)
+				{
+					auto namedNode = static_cast<JsonTreeModelNamedListNode*>(listNode);
+					for (const auto& name : sortedScalarNames(namedNode))
+					{
+						const QJsonValue scalar = namedNode->namedScalarValue(name);
+						if (matches(nullptr, &scalar, step))
+							next << Match{namedNode, name};
+					}
+				}
+				for (int i = 0; i < listNode->childCount(); ++i)
+				{
+					auto child = listNode->childAt(i);
+					if (matches(child, nullptr, step))
+						next << Match{child, QString()};
+				}
+				break;
+			}
+		}
+		current.swap(next);
+	}
+	return current;
+}
+
+/*
+	Returns true if the element satisfies any term of the filter step. The element is either a
+	node, or the scalar member of an object if scalar is not null.
+*/
+bool
+JsonTreeQuery::matches(const JsonTreeModelNode* node, const QJsonValue* scalar, const Step& step)
+{
+	for (const auto& term : step.terms)
+	{
+		bool isMatch = true;
+		for (const auto& condition : term)
+		{
+			if (!matches(node, scalar, condition))
+			{
+				isMatch = false;
+				break;
+			}
+		}
+		if (isMatch)
+			return true;
+	}
+	return false;
+}
+
+/*
+	Evaluates a single condition, directly on the stored value. The element is either a node, or
+	the scalar member of an object if scalar is not null; scalars have no members.
+*/
+bool
+JsonTreeQuery::matches(const JsonTreeModelNode* node, const QJsonValue* scalar, const Condition& condition)
+{
+	if (condition.member.isNull() && scalar == nullptr && node->type() == JsonTreeModelNode::Scalar)
+		scalar = &static_cast<const JsonTreeModelScalarNode*>(node)->value();
+
+	QJsonValue memberValue;
+	const QJsonValue* value = condition.member.isNull() ? scalar : nullptr;
+	if (!condition.member.isNull() && node != nullptr && node->type() == JsonTreeModelNode::Object)
+	{
+		// NOTE: Members that column projection left out are read without materializing them
+		auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+		if (namedNode->hasNamedScalar(condition.member))
+		{
+			memberValue = namedNode->namedScalarValue(condition.member);
+			value = &memberValue;
+		}
+		else if (condition.comparison == Exists)
+			return namedNode->namedChild(condition.member) != nullptr;
+	}
+
+	if (condition.comparison == Exists)
+		return value != nullptr || condition.member.isNull(); // NOTE: The element itself always exists
+	if (value == nullptr)
+		return false;
+
+	const QJsonValue& operand = condition.operand;
+	int order;
+	if (value->isDouble() && operand.isDouble())
+	{
+		const double a = value->toDouble();
+		const double b = operand.toDouble();
+		order = (a < b) ? -1 : (a > b) ? 1 : 0;
+	}
+	else if (value->isString() && operand.isString())
+	{
+		// NOTE: Strings that share their data (see JsonTreeStringDictionary) are equal
+		const QString text = value->toString();
+		const QString operandText = operand.toString();
+		order = (text.constData() == operandText.constData()) ? 0 : text.compare(operandText);
+	}
+	else if (value->type() == operand.type() && (value->isBool() || value->isNull()))
+	{
+		if (condition.comparison != Equal && condition.comparison != NotEqual)
+			return false;
+		order = (*value == operand) ? 0 : 1;
+	}
+	else
+		return condition.comparison == NotEqual;
+
+	switch (condition.comparison)
+	{
+	case Equal: return order == 0;
+	case NotEqual: return order != 0;
+	case Less: return order < 0;
+	case LessOrEqual: return order <= 0;
+	case Greater: return order > 0;
+	case GreaterOrEqual: return order >= 0;
+	default: return false;
+	}
+}
+
+
+//=================================
+// Parser
+//=================================
+/*
+	Parses m_expression into m_steps. Returns false and sets m_errorString if it is malformed.
+*/
+bool
+JsonTreeQuery::parse()
+{
+	const QString& e = m_expression;
+	int position = 0;
+	if (!e.startsWith('$'))
+		return fail(0, "An expression must start with \"$\"");
+	++position;
+
+	while (position < e.size())
+	{
+		if (e.midRef(position, 2) == QLatin1String(".."))
+		{
+			position += 2;
+			m_steps << Step{Descendants, QString(), 0, {}};
+			if (position < e.size() && e[position] == '[')
+				continue; // The bracket is the next step
+		}
+		else if (e[position] == '.')
+			++position;
+		else if (e[position] == '[')
+		{
+			if (!parseBracket(&position))
+				return false;
+			continue;
+		}
+		else
+			return fail(position, "Expected \".\" or \"[\"");
+
+		// A step that follows a dot
+		if (position < e.size() && e[position] == '*')
+		{
+			++position;
+			m_steps << Step{Wildcard, QString(), 0, {}};
+			continue;
+		}
+
+		const QString name = readName(&position, ".[");
+		if (name.isEmpty())
+			return fail(position, "Expected a member name");
+		m_steps << Step{Member, name, 0, {}};
+	}
+	return true;
+}
+
+/*
+	Parses a step in brackets, starting at the '['.
+*/
+bool
+JsonTreeQuery::parseBracket(int* position)
+{
+	const QString& e = m_expression;
+	++*position; // '['
+
+	Step step{Member, QString(), 0, {}};
+	if (*position < e.size() && e[*position] == '*')
+	{
+		++*position;
+		step.type = Wildcard;
+	}
+	else if (*position < e.size() && (e[*position] == '\'' || e[*position] == '"'))
+	{
+		if (!parseQuoted(position, &step.name))
+			return false;
+	}
+	else if (*position < e.size() && e[*position] == '?')
+	{
+		++*position;
+		step.type = Filter;
+		if (!parseFilter(position, &step))
+			return false;
+	}
+	else
+	{
+		const QString number = readName(position, "]");
+		bool ok = false;
+		step.type = Element;
+		step.index = number.trimmed().toInt(&ok);
+		if (!ok)
+			return fail(*position, "Expected an array index, \"*\", a quoted name or a filter");
+	}
+
+	if (*position >= e.size() || e[*position] != ']')
+		return fail(*position, "Expected \"]\"");
+	++*position;
+
+	m_steps << step;
+	return true;
+}
+
+/*
+	Parses "(condition && condition || ...)", starting at the '('.
+*/
+bool
+JsonTreeQuery::parseFilter(int* position, Step* step)
+{
+	const QString& e = m_expression;
+	if (*position >= e.size() || e[*position] != '(')
+		return fail(*position, "Expected \"(\"");
+	++*position;
+
+	step->terms << QVector<Condition>();
+	while (true)
+	{
+		Condition condition;
+		if (!parseCondition(position, &condition))
+			return false;
+		step->terms.last() << condition;
+
+		while (*position < e.size() && e[*position].isSpace())
+			++*position;
+
+		if (e.midRef(*position, 2) == QLatin1String("&&"))
+			*position += 2;
+		else if (e.midRef(*position, 2) == QLatin1String("||"))
+		{
+			*position += 2;
+			step->terms << QVector<Condition>();
+		}
+		else if (*position < e.size() && e[*position] == ')')
+		{
+			++*position;
+			return true;
+		}
+		else
+			return fail(*position, "Expected \"&&\", \"||\" or \")\"");
+	}
+}
+
+/*
+	Parses "@", "@.name" or "@['name']", optionally followed by a comparison and a literal.
+*/
+bool
+JsonTreeQuery::parseCondition(int* position, Condition* condition)
+{
+	const QString& e = m_expression;
+	while (*position < e.size() && e[*position].isSpace())
+		++*position;
+
+	if (*position >= e.size() || e[*position] != '@')
+		return fail(*position, "Expected \"@\"");
+	++*position;
+
+	condition->comparison = Exists;
+	if (*position < e.size() && e[*position] == '.')
+	{
+		++*position;
+		condition->member = readName(position, " \t=!<>&|)");
+		if (condition->member.isEmpty())
+			return fail(*position, "Expected a member name");
+	}
+	else if (e.midRef(*position, 2) == QLatin1String("['") || e.midRef(*position, 2) == QLatin1String("[\""))
+	{
+		++*position;
+		if (!parseQuoted(position, &condition->member))
+			return false;
+		if (*position >= e.size() || e[*position] != ']')
+			return fail(*position, "Expected \"]\"");
+		++*position;
+	}
+
+	while (*position < e.size() && e[*position].isSpace())
+		++*position;
+
+	static const struct { const char* token; Comparison comparison; } comparisons[] =
+	{
+		// NOTE: Two-character operators first
+		{"==", Equal}, {"!=", NotEqual}, {"<=", LessOrEqual}, {">=", GreaterOrEqual}, {"<", Less}, {">", Greater}
+	};
+	for (const auto& c : comparisons)
+	{
+		const QString token = QString::fromLatin1(c.token);
+		if (e.midRef(*position, token.size()) == token)
+		{
+			*position += token.size();
+			condition->comparison = c.comparison;
+			return parseLiteral(position, &condition->operand);
+		}
+	}
+	return true;
+}
+
+/*
+	Parses a number, a quoted string, true, false or null.
+*/
+bool
+JsonTreeQuery::parseLiteral(int* position, QJsonValue* literal)
+{
+	const QString& e = m_expression;
+	while (*position < e.size() && e[*position].isSpace())
+		++*position;
+
+	if (*position < e.size() && (e[*position] == '\'' || e[*position] == '"'))
+	{
+		QString text;
+		if (!parseQuoted(position, &text))
+			return false;
+		*literal = text;
+		return true;
+	}
+
+	const int start = *position;
+	const QString word = readName(position, " \t&|)");
+	if (word == QLatin1String("true"))
+		*literal = true;
+	else if (word == QLatin1String("false"))
+		*literal = false;
+	else if (word == QLatin1String("null"))
+		*literal = QJsonValue(QJsonValue::Null);
+	else
+	{
+		bool ok = false;
+		*literal = word.toDouble(&ok);
+		if (!ok)
+			return fail(start, "Expected a number, a quoted string, true, false or null");
+	}
+	return true;
+}
+
+/*
+	Parses a string in single or double quotes, where "\" escapes the next character.
+*/
+bool
+JsonTreeQuery::parseQuoted(int* position, QString* text)
+{
+	const QString& e = m_expression;
+	const QChar quote = e[*position];
+	const int start = *position;
+	++*position;
+
+	text->clear();
+	while (*position < e.size() && e[*position] != quote)
+	{
+		if (e[*position] == '\\' && *position + 1 < e.size())
+			++*position;
+		*text += e[*position];
+		++*position;
+	}
+	if (*position >= e.size())
+		return fail(start, "Unterminated string");
+	++*position;
+	return true;
+}
+
+/*
+	Reads up to (but not including) the next terminator character, or to the end.
+*/
+QString
+JsonTreeQuery::readName(int* position, const QString& terminators) const
+{
+	const int start = *position;
+	while (*position < m_expression.size() && !terminators.contains(m_expression[*position]))
+		++*position;
+	return m_expression.mid(start, *position - start);
+}
+
+bool
+JsonTreeQuery::fail(int position, const QString& message)
+{
+	m_errorString = QStringLiteral("%1 at position %2").arg(message).arg(position);
+	return false;
+}
@@ -0,0 +1,76 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREEQUERY_H
+#define JSONTREEQUERY_H
+
+#include "jsontreemodel.h"
+#include <QVector>
+
+class JsonTreeStringDictionary;
+
+//=================================
+// JsonTreeQuery
+//=================================
+class JsonTreeQuery
+{
+public:
+	JsonTreeQuery() : m_isValid(false) {}
+	explicit JsonTreeQuery(const QString& expression);
+
+	bool isValid() const { return m_isValid; }
+	QString errorString() const { return m_errorString; }
+	QString expression() const { return m_expression; }
+
+	// A matching node, or a named scalar of a matching object if scalarName is not null
+	struct Match
+	{
+		JsonTreeModelNode* node;
+		QString scalarName;
+	};
+	QVector<Match> evaluate(JsonTreeModelListNode* document, const JsonTreeStringDictionary* dictionary = nullptr) const;
+
+private:
+	enum Comparison { Exists, Equal, NotEqual, Less, LessOrEqual, Greater, GreaterOrEqual };
+
+	struct Condition
+	{
+		QString member;      // A null string refers to the element itself
+		Comparison comparison;
+		QJsonValue operand;
+	};
+
+	enum StepType { Member, Element, Wildcard, Descendants, Filter };
+
+	struct Step
+	{
+		StepType type;
+		QString name;                      // Member
+		int index;                         // Element
+		QVector<QVector<Condition>> terms; // Filter: the conditions of each term are combined with &&, and the terms with ||
+	};
+
+	bool parse();
+	bool parseBracket(int* position);
+	bool parseFilter(int* position, Step* step);
+	bool parseCondition(int* position, Condition* condition);
+	bool parseLiteral(int* position, QJsonValue* literal);
+	bool parseQuoted(int* position, QString* text);
+	QString readName(int* position, const QString& terminators) const;
+	bool fail(int position, const QString& message);
+
+	static bool matches(const JsonTreeModelNode* node, const QJsonValue* scalar, const Step& step);
+	static bool matches(const JsonTreeModelNode* node, const QJsonValue* scalar, const Condition& condition);
+
+	QString m_expression;
+	QVector<Step> m_steps;
+	QString m_errorString;
+	bool m_isValid;
+};
+
+#endif // JSONTREEQUERY_H
@@ -0,0 +1,677 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreesnapshot.h"
+#include <QFile>
+#include <QtEndian>
+
+/*
+	Snapshot layout (version 1)
+	===========================
+	All integers are little-endian. All offsets are counted from the start of the snapshot,
+	so the snapshot can be read from any address (e.g. a memory-mapped file).
+
+	Header (40 bytes):
+		char[4]  magic ("JTMS")
+		quint32  version
+		quint32  flags (see SnapshotFlag)
+		quint32  total size in bytes
+		quint32  number of strings
+		quint32  offset of the string index (one quint32 offset per string)
+		quint32  number of scalar column headers
+		quint32  offset of the header list (one quint32 string index per header)
+		quint32  offset of the root record
+		quint32  reserved
+
+	String (4-byte aligned):
+		quint32  length in UTF-16 code units, followed by the UTF-16LE code units
+
+	Record (one per array/object, 8-byte aligned):
+		quint32  kind (EntryArray or EntryObject)
+		quint32  number of named scalars (objects only)
+		quint32  number of child rows
+		quint32  reserved
+		Entry[]  the named scalars, followed by the child rows
+
+	Entry (16 bytes):
+		quint32  string index of the member name (NoKey for array elements)
+		quint32  entry type (see EntryType)
+		quint64  payload: a Boolean, the bits of a double, a string index or a record offset
+*/
+namespace
+{
+const char SnapshotMagic[4] = {'J', 'T', 'M', 'S'};
+const quint32 SnapshotVersion = 1;
+const quint32 HeaderSize = 40;
+const quint32 RecordHeaderSize = 16;
+const quint32 EntrySize = 16;
+const quint32 NoKey = 0xFFFFFFFF;
+
+// NOTE: The snapshot is built in a QByteArray, whose size is an int, so it stays well below 2 GiB
+const qint64 MaxSnapshotSize = Q_INT64_C(0x7FF00000);
+
+enum SnapshotFlag : quint32
+{
+	RootIsObject  = 0x1,
+	RootIsWrapped = 0x2
+};
+
+enum EntryType : quint32
+{
+	EntryNull,
+	EntryBool,
+	EntryDouble,
+	EntryString,
+	EntryArray,
+	EntryObject
+};
+}
+
+
+//=================================
+// Snapshot writer
+//=================================
+/*!
+	\class JsonTreeSnapshotWriter
+	\brief JsonTreeSnapshotWriter serializes a JsonTreeModel's node tree into the binary
+		   snapshot format read by JsonTreeSnapshotSource.
+
+	\sa JsonTreeModel::saveSnapshot()
+*/
+
+/*!
+	\brief Writes the tree under \a rootNode and the scalar column \a headers to \a device.
+
+	Returns \c false if the \a device could not take all the data, or if the snapshot would not
+	fit in a QByteArray (about 2 GiB). Nothing is written in the latter case.
+*/
+bool
+JsonTreeSnapshotWriter::write(QIODevice* device, const JsonTreeModelListNode* rootNode, const QStringList& headers)
+{
+	JsonTreeSnapshotWriter writer;
+	writer.m_buffer.resize(HeaderSize);
+	writer.m_buffer.fill('\0');
+
+	quint32 flags = 0;
+	quint32 rootOffset = 0;
+	if (rootNode != nullptr)
+	{
+		auto realRoot = rootNode;
+		if (rootNode->isWrapper())
+		{
+			flags |= RootIsWrapped;
+			realRoot = static_cast<const JsonTreeModelListNode*>(rootNode->childAt(0));
+		}
+		if (realRoot->type() == JsonTreeModelNode::Object)
+			flags |= RootIsObject;
+		rootOffset = writer.writeRecord(realRoot);
+	}
+
+	QVector<quint32> headerIds;
+	headerIds.reserve(headers.count());
+	for (const auto& header : headers)
+		headerIds << writer.internString(header);
+
+	// String data
+	QVector<quint32> stringOffsets;
+	stringOffsets.reserve(writer.m_strings.count());
+	for (const auto& string : qAsConst(writer.m_strings))
+	{
+		if ( !writer.fits(4 + qint64(string.size()) * 2 + 3) )
+			break;
+		stringOffsets << writer.m_buffer.size();
+		writer.appendUInt32(string.size());
+		for (const QChar c : string)
+		{
+			char units[2];
+			qToLittleEndian<quint16>(c.unicode(), units);
+			writer.m_buffer.append(units, 2);
+		}
+		while (writer.m_buffer.size() % 4 != 0)
+			writer.m_buffer.append('\0');
+	}
+
+	// Tables
+	if ( !writer.fits((qint64(stringOffsets.count()) + headerIds.count()) * 4) )
+	{
+		qWarning("JsonTreeModel: The snapshot would exceed the maximum size of %lld bytes", MaxSnapshotSize);
+		return false;
+	}
+	const quint32 stringIndexOffset = writer.m_buffer.size();
+	for (auto offset : qAsConst(stringOffsets))
+		writer.appendUInt32(offset);
+
+	const quint32 headerOffset = writer.m_buffer.size();
+	for (auto id : qAsConst(headerIds))
+		writer.appendUInt32(id);
+
+	// NOTE: QByteArray sizes are ints, so the 32-bit offsets cannot overflow before the buffer does
+	memcpy(writer.m_buffer.data(), SnapshotMagic, 4);
+	writer.putUInt32(4, SnapshotVersion);
+	writer.putUInt32(8, flags);
+	writer.putUInt32(12, writer.m_buffer.size());
+	writer.putUInt32(16, writer.m_strings.count());
+	writer.putUInt32(20, stringIndexOffset);
+	writer.putUInt32(24, headerIds.count());
+	writer.putUInt32(28, headerOffset);
+	writer.putUInt32(32, rootOffset);
+
+	return device->write(writer.m_buffer) == writer.m_buffer.size();
+}
+
+/*
+	Returns true if the given number of bytes can still be appended to the snapshot. Once this
+	returns false, it keeps returning false, and the snapshot is not written.
+*/
+bool
+JsonTreeSnapshotWriter::fits(qint64 bytes)
+{
+	if (!m_tooLarge && m_buffer.size() + bytes > MaxSnapshotSize)
+		m_tooLarge = true;
+	return !m_tooLarge;
+}
+
+quint32
+JsonTreeSnapshotWriter::internString(const QString& string)
+{
+	auto i = m_stringIds.constFind(string);
+	if (i != m_stringIds.constEnd())
+		return i.value();
+
+	quint32 id = m_strings.count();
+	m_stringIds.insert(string, id);
+	m_strings << string;
+	return id;
+}
+
+/*
+	Writes the record for node and (recursively) the records of its child structures.
+	Returns the offset of node's record.
+*/
+quint32
+JsonTreeSnapshotWriter::writeRecord(const JsonTreeModelListNode* node)
+{
+	const bool isObject = (node->type() == JsonTreeModelNode::Object);
+	auto namedNode = static_cast<const JsonTreeModelNamedListNode*>(node);
+
+	const int scalarCount = isObject ? namedNode->namedScalarCount() : 0;
+	const int childCount = node->childCount();
+	if ( !fits(7 + RecordHeaderSize + (qint64(scalarCount) + childCount) * EntrySize) )
+		return 0;
+
+	while (m_buffer.size() % 8 != 0)
+		m_buffer.append('\0');
+
+	const quint32 offset = m_buffer.size();
+
+	appendUInt32(isObject ? EntryObject : EntryArray);
+	appendUInt32(scalarCount);
+	appendUInt32(childCount);
+	appendUInt32(0);
+
+	// Reserve the entries first; child records are appended after them
+	const int entriesStart = m_buffer.size();
+	m_buffer.append(QByteArray( (scalarCount + childCount) * EntrySize, '\0' ));
+
+	int position = entriesStart;
+	if (isObject)
+	{
+		const auto& scalars = namedNode->namedScalars();
+		for (auto i = scalars.constBegin(); i != scalars.constEnd(); ++i)
+		{
+			writeScalarEntry(position, internString(i.key()), i.value());
+			position += EntrySize;
+		}
+	}
+	for (int row = 0; row < childCount && !m_tooLarge; ++row)
+	{
+		auto child = node->childAt(row);
+		auto keyIndex = isObject ? internString(namedNode->childListNodeName(child)) : NoKey;
+		writeEntry(position, keyIndex, child);
+		position += EntrySize;
+	}
+	return offset;
+}
+
+void
+JsonTreeSnapshotWriter::writeEntry(int position, quint32 keyIndex, const JsonTreeModelNode* node)
+{
+	if (node->type() == JsonTreeModelNode::Scalar)
+	{
+		writeScalarEntry(position, keyIndex, static_cast<const JsonTreeModelScalarNode*>(node)->value());
+		return;
+	}
+
+	auto childOffset = writeRecord(static_cast<const JsonTreeModelListNode*>(node));
+	putUInt32(position, keyIndex);
+	putUInt32(position + 4, node->type() == JsonTreeModelNode::Object ? EntryObject : EntryArray);
+	putUInt64(position + 8, childOffset);
+}
+
+void
+JsonTreeSnapshotWriter::writeScalarEntry(int position, quint32 keyIndex, const QJsonValue& value)
+{
+	quint32 type = EntryNull;
+	quint64 payload = 0;
+	switch (value.type())
+	{
+	case QJsonValue::Bool:
+		type = EntryBool;
+		payload = value.toBool() ? 1 : 0;
+		break;
+
+	case QJsonValue::Double:
+		{
+			type = EntryDouble;
+			const double d = value.toDouble();
+			memcpy(&payload, &d, sizeof(d));
+			break;
+		}
+
+	case QJsonValue::String:
+		type = EntryString;
+		payload = internString(value.toString());
+		break;
+
+	default:
+		break;
+	}
+
+	putUInt32(position, keyIndex);
+	putUInt32(position + 4, type);
+	putUInt64(position + 8, payload);
+}
+
+void
+JsonTreeSnapshotWriter::appendUInt32(quint32 value)
+{
+	char bytes[4];
+	qToLittleEndian<quint32>(value, bytes);
+	m_buffer.append(bytes, 4);
+}
+
+void
+JsonTreeSnapshotWriter::putUInt32(int position, quint32 value)
+{
+	qToLittleEndian<quint32>(value, m_buffer.data() + position);
+}
+
+void
+JsonTreeSnapshotWriter::putUInt64(int position, quint64 value)
+{
+	qToLittleEndian<quint64>(value, m_buffer.data() + position);
+}
+
+
+//=================================
+// Snapshot reader
+//=================================
+/*!
+	\class JsonTreeSnapshotSource
+	\brief JsonTreeSnapshotSource holds the bytes of a snapshot and creates nodes from them
+		   on demand.
+
+	If possible, the snapshot file is memory-mapped instead of read. Each array or object node
+	is created empty, with a JsonTreeSnapshotLoader that decodes its record the first time the
+	node is accessed. The source stays alive for as long as any node is still deferred.
+
+	\sa JsonTreeModel::loadSnapshot()
+*/
+JsonTreeSnapshotSource::JsonTreeSnapshotSource() :
+	m_file(nullptr),
+	m_data(nullptr),
+	m_size(0),
+	m_flags(0),
+	m_stringCount(0),
+	m_stringIndexOffset(0),
+	m_headerCount(0),
+	m_headerOffset(0),
+	m_rootOffset(0)
+{}
+
+JsonTreeSnapshotSource::~JsonTreeSnapshotSource()
+{
+	// NOTE: Destroying the QFile also unmaps it
+	delete m_file;
+}
+
+/*!
+	\brief Opens the snapshot that starts at the current position of \a device.
+
+	Returns a null pointer if the \a device does not contain a valid snapshot.
+*/
+QSharedPointer<JsonTreeSnapshotSource>
+JsonTreeSnapshotSource::open(QIODevice* device)
+{
+	QSharedPointer<JsonTreeSnapshotSource> source(new JsonTreeSnapshotSource);
+
+	// Map the file if possible. A private QFile is used, because the caller's QFile unmaps
+	// everything when it is closed.
+	auto fileDevice = qobject_cast<QFileDevice*>(device);
+	if (fileDevice != nullptr && !fileDevice->fileName().isEmpty() && !device->isSequential())
+	{
+		auto file = new QFile(fileDevice->fileName());
+		const qint64 start = device->pos();
+		const qint64 length = file->size() - start;
+		if (file->open(QIODevice::ReadOnly) && length > 0 && length <= 0xFFFFFFFF)
+		{
+			auto map = file->map(start, length);
+			if (map != nullptr)
+			{
+				source->m_file = file;
+				source->m_data = map;
+				source->m_size = static_cast<quint32>(length);
+			}
+		}
+		if (source->m_file == nullptr)
+			delete file;
+	}
+
+	if (source->m_data == nullptr)
+	{
+		source->m_bytes = device->readAll();
+		source->m_data = reinterpret_cast<const uchar*>(source->m_bytes.constData());
+		source->m_size = source->m_bytes.size();
+	}
+
+	if (!source->validate())
+		return QSharedPointer<JsonTreeSnapshotSource>();
+
+	if (source->m_file != nullptr)
+		device->seek(device->pos() + source->uint32At(12)); // Leave the caller's device after the snapshot
+	return source;
+}
+
+bool
+JsonTreeSnapshotSource::validate()
+{
+	if (m_size < HeaderSize || memcmp(m_data, SnapshotMagic, 4) != 0)
+		return false;
+	if (uint32At(4) != SnapshotVersion)
+		return false;
+
+	const quint32 totalSize = uint32At(12);
+	if (totalSize > m_size)
+		return false;
+	m_size = totalSize;
+
+	m_flags = uint32At(8);
+	m_stringCount = uint32At(16);
+	m_stringIndexOffset = uint32At(20);
+	m_headerCount = uint32At(24);
+	m_headerOffset = uint32At(28);
+	m_rootOffset = uint32At(32);
+
+	if ( quint64(m_stringIndexOffset) + quint64(m_stringCount) * 4 > m_size
+			|| quint64(m_headerOffset) + quint64(m_headerCount) * 4 > m_size )
+	{
+		return false;
+	}
+
+	// NOTE: The root record's row count is reported before the record is decoded, so it must be readable
+	if (m_rootOffset != 0)
+	{
+		quint32 kind, scalarCount, childCount;
+		if ( m_rootOffset < HeaderSize || !recordAt(m_rootOffset, &kind, &scalarCount, &childCount)
+				|| (kind == EntryObject) != bool(m_flags & RootIsObject) )
+		{
+			return false;
+		}
+	}
+
+	m_stringCache.resize(m_stringCount);
+	m_stringCached.fill(false, m_stringCount);
+	return true;
+}
+
+/*!
+	\brief Creates the model's root node. Its contents are created on demand.
+
+	Returns \c nullptr if the snapshot was taken from an empty model.
+*/
+JsonTreeModelListNode*
+JsonTreeSnapshotSource::createRootNode(const QSharedPointer<JsonTreeSnapshotSource>& self)
+{
+	quint32 kind, scalarCount, childCount;
+	if (m_rootOffset == 0 || !recordAt(m_rootOffset, &kind, &scalarCount, &childCount))
+		return nullptr;
+
+	JsonTreeModelListNode* root;
+	if (m_flags & RootIsObject)
+		root = new JsonTreeModelNamedListNode(QJsonObject(), nullptr);
+	else
+		root = new JsonTreeModelListNode(nullptr);
+	root->setLoader(new JsonTreeSnapshotLoader(self, m_rootOffset, childCount));
+
+	if ((m_flags & RootIsWrapped) && root->type() == JsonTreeModelNode::Object)
+		return new JsonTreeModelWrapperNode(static_cast<JsonTreeModelNamedListNode*>(root));
+	return root;
+}
+
+/*!
+	\brief Returns the scalar column headers stored in the snapshot.
+*/
+QStringList
+JsonTreeSnapshotSource::headers()
+{
+	QStringList headers;
+	for (quint32 i = 0; i < m_headerCount; ++i)
+		headers << string(uint32At(m_headerOffset + 4*i));
+	return headers;
+}
+
+/*!
+	\brief Reads the header of the record at \a offset.
+
+	Returns \c false if the record does not fit in the snapshot.
+*/
+bool
+JsonTreeSnapshotSource::recordAt(quint32 offset, quint32* kind, quint32* scalarCount, quint32* childCount) const
+{
+	if (quint64(offset) + RecordHeaderSize > m_size)
+		return false;
+
+	*kind = uint32At(offset);
+	*scalarCount = uint32At(offset + 4);
+	*childCount = uint32At(offset + 8);
+
+	const quint64 end = quint64(offset) + RecordHeaderSize + (quint64(*scalarCount) + *childCount) * EntrySize;
+	return end <= m_size && (*kind == EntryArray || *kind == EntryObject) && *childCount <= 0x7FFFFFFF;
+}
+
+/*!
+	\brief Decodes the record at \a offset into \a node.
+
+	Child arrays and objects are created empty, with their own loaders.
+*/
+void
+JsonTreeSnapshotSource::loadRecord(JsonTreeModelListNode* node, quint32 offset, const QSharedPointer<JsonTreeSnapshotSource>& self)
+{
+	quint32 kind, scalarCount, childCount;
+	if (!recordAt(offset, &kind, &scalarCount, &childCount))
+	{
+		qWarning("JsonTreeModel: Corrupted snapshot record at offset %u", offset);
+		return;
+	}
+
+	const bool isObject = (kind == EntryObject && node->type() == JsonTreeModelNode::Object);
+	auto namedNode = static_cast<JsonTreeModelNamedListNode*>(node);
+
+	quint32 position = offset + RecordHeaderSize;
+	for (quint32 i = 0; i < scalarCount; ++i, position += EntrySize)
+	{
+		QJsonValue value;
+		if (isObject && scalarValue(uint32At(position + 4), uint64At(position + 8), &value))
+			JsonTreeSnapshotLoader::insertNamedScalar(namedNode, string(uint32At(position)), value);
+	}
+	const quint32 entriesEnd = position + childCount * EntrySize;
+	for (quint32 i = 0; i < childCount; ++i, position += EntrySize)
+	{
+		auto child = createNode(uint32At(position + 4), uint64At(position + 8), node, entriesEnd, self);
+		if (isObject && child != nullptr && child->type() == JsonTreeModelNode::Scalar)
+		{
+			delete child; // NOTE: The rows of an object are its arrays and objects
+			child = nullptr;
+		}
+
+		// NOTE: The row count was reported before this record was decoded, so a corrupted row is kept as an empty one
+		if (child == nullptr)
+		{
+			qWarning("JsonTreeModel: Corrupted snapshot entry at offset %u", position);
+			if (isObject)
+				child = new JsonTreeModelNamedListNode(QJsonObject(), node);
+			else
+				child = new JsonTreeModelScalarNode(QJsonValue(), node);
+		}
+
+		if (isObject)
+			JsonTreeSnapshotLoader::appendNamedChild(namedNode, string(uint32At(position)), child);
+		else
+			JsonTreeSnapshotLoader::appendChild(node, child);
+	}
+}
+
+/*!
+	\brief Adds the names of the named scalars in the record at \a offset to \a names, without
+	creating any nodes.
+*/
+void
+JsonTreeSnapshotSource::collectScalarNames(quint32 offset, QSet<QString>* names)
+{
+	quint32 kind, scalarCount, childCount;
+	if (!recordAt(offset, &kind, &scalarCount, &childCount) || kind != EntryObject)
+		return;
+
+	quint32 position = offset + RecordHeaderSize;
+	for (quint32 i = 0; i < scalarCount; ++i, position += EntrySize)
+	{
+		QJsonValue value;
+		if (scalarValue(uint32At(position + 4), uint64At(position + 8), &value))
+			names->insert(string(uint32At(position)));
+	}
+}
+
+bool
+JsonTreeSnapshotSource::scalarValue(quint32 type, quint64 payload, QJsonValue* value)
+{
+	switch (type)
+	{
+	case EntryNull:
+		*value = QJsonValue();
+		return true;
+
+	case EntryBool:
+		*value = (payload != 0);
+		return true;
+
+	case EntryDouble:
+		{
+			double d;
+			memcpy(&d, &payload, sizeof(d));
+			*value = d;
+			return true;
+		}
+
+	case EntryString:
+		*value = (payload < m_stringCount) ? string(static_cast<quint32>(payload)) : QString();
+		return true;
+	}
+	return false;
+}
+
+/*
+	Creates the node of a child entry. The record of a child array or object must start at or
+	after minimumOffset, which the writer always places after its parent's entries; this
+	keeps corrupted offsets from making a record its own descendant.
+*/
+JsonTreeModelNode*
+JsonTreeSnapshotSource::createNode(quint32 type, quint64 payload, JsonTreeModelNode* parent, quint32 minimumOffset,
+		const QSharedPointer<JsonTreeSnapshotSource>& self)
+{
+	switch (type)
+	{
+	case EntryNull:
+	case EntryBool:
+	case EntryDouble:
+	case EntryString:
+		{
+			QJsonValue value;
+			scalarValue(type, payload, &value);
+			return new JsonTreeModelScalarNode(value, parent);
+		}
+
+	case EntryArray:
+	case EntryObject:
+		{
+			quint32 kind, scalarCount, childCount;
+			const quint32 offset = static_cast<quint32>(payload);
+			if ( payload > m_size || offset < minimumOffset
+					|| !recordAt(offset, &kind, &scalarCount, &childCount) || kind != type )
+			{
+				return nullptr;
+			}
+
+			JsonTreeModelListNode* node;
+			if (type == EntryObject)
+				node = new JsonTreeModelNamedListNode(QJsonObject(), parent);
+			else
+				node = new JsonTreeModelListNode(parent);
+			node->setLoader(new JsonTreeSnapshotLoader(self, offset, childCount));
+			return node;
+		}
+	}
+	return nullptr;
+}
+
+QString
+JsonTreeSnapshotSource::string(quint32 index)
+{
+	if (index >= m_stringCount)
+		return QString();
+	if (m_stringCached[index])
+		return m_stringCache[index];
+
+	const quint32 offset = uint32At(m_stringIndexOffset + 4*index);
+	QString decoded;
+	if (quint64(offset) + 4 <= m_size)
+	{
+		const quint32 length = uint32At(offset);
+		if (quint64(offset) + 4 + quint64(length) * 2 <= m_size)
+		{
+			auto units = m_data + offset + 4;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+			decoded = QString::fromUtf16(reinterpret_cast<const ushort*>(units), length);
+#else
+			decoded.resize(length);
+			for (quint32 i = 0; i < length; ++i)
+				decoded[i] = QChar( qFromLittleEndian<quint16>(units + 2*i) );
+#endif
+		}
+	}
+	m_stringCache[index] = decoded;
+	m_stringCached[index] = true;
+	return decoded;
+}
+
+quint32
+JsonTreeSnapshotSource::uint32At(quint32 offset) const
+{
+	return qFromLittleEndian<quint32>(m_data + offset);
+}
+
+quint64
+JsonTreeSnapshotSource::uint64At(quint32 offset) const
+{
+	return qFromLittleEndian<quint64>(m_data + offset);
+}
+
+/*!
+	\class JsonTreeSnapshotLoader
+	\brief JsonTreeSnapshotLoader defers the decoding of a single snapshot record until its
+		   node is accessed.
+*/
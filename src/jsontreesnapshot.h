@@ -0,0 +1,121 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef JSONTREESNAPSHOT_H
+#define JSONTREESNAPSHOT_H
+
+#include "jsontreemodel.h"
+#include <QSharedPointer>
+#include <QHash>
+
+class QIODevice;
+class QFile;
+
+//=================================
+// Snapshot writer
+//=================================
+class JsonTreeSnapshotWriter
+{
+public:
+	static bool write(QIODevice* device, const JsonTreeModelListNode* rootNode, const QStringList& headers);
+
+private:
+	JsonTreeSnapshotWriter() : m_tooLarge(false) {}
+
+	bool fits(qint64 bytes);
+	quint32 internString(const QString& string);
+	quint32 writeRecord(const JsonTreeModelListNode* node);
+	void writeEntry(int position, quint32 keyIndex, const JsonTreeModelNode* node);
+	void writeScalarEntry(int position, quint32 keyIndex, const QJsonValue& value);
+
+	void appendUInt32(quint32 value);
+	void putUInt32(int position, quint32 value);
+	void putUInt64(int position, quint64 value);
+
+	QByteArray m_buffer;
+	QHash<QString, quint32> m_stringIds;
+	QStringList m_strings;
+	bool m_tooLarge;
+};
+
+
+//=================================
+// Snapshot reader
+//=================================
+class JsonTreeSnapshotSource
+{
+public:
+	~JsonTreeSnapshotSource();
+
+	static QSharedPointer<JsonTreeSnapshotSource> open(QIODevice* device);
+
+	JsonTreeModelListNode* createRootNode(const QSharedPointer<JsonTreeSnapshotSource>& self);
+	QStringList headers();
+
+	bool recordAt(quint32 offset, quint32* kind, quint32* scalarCount, quint32* childCount) const;
+	void loadRecord(JsonTreeModelListNode* node, quint32 offset, const QSharedPointer<JsonTreeSnapshotSource>& self);
+	void collectScalarNames(quint32 offset, QSet<QString>* names);
+
+private:
+	JsonTreeSnapshotSource();
+
+	bool validate();
+	QString string(quint32 index);
+	quint32 uint32At(quint32 offset) const;
+	quint64 uint64At(quint32 offset) const;
+	bool scalarValue(quint32 type, quint64 payload, QJsonValue* value);
+	JsonTreeModelNode* createNode(quint32 type, quint64 payload, JsonTreeModelNode* parent, quint32 minimumOffset,
+			const QSharedPointer<JsonTreeSnapshotSource>& self);
+
+	QFile* m_file;
+	QByteArray m_bytes;
+	const uchar* m_data;
+	quint32 m_size;
+
+	quint32 m_flags;
+	quint32 m_stringCount;
+	quint32 m_stringIndexOffset;
+	quint32 m_headerCount;
+	quint32 m_headerOffset;
+	quint32 m_rootOffset;
+
+	// NOTE: Decoded strings are cached, so that repeated keys share the same QString data
+	QVector<QString> m_stringCache;
+	QVector<bool> m_stringCached;
+};
+
+class JsonTreeSnapshotLoader : public DataTreeModelNodeLoader<QJsonValue>
+{
+public:
+	JsonTreeSnapshotLoader(const QSharedPointer<JsonTreeSnapshotSource>& source, quint32 offset, int childCount) :
+		m_source(source),
+		m_offset(offset),
+		m_childCount(childCount)
+	{}
+
+	int childCount() const override
+	{ return m_childCount; }
+
+	void load(JsonTreeModelListNode* node) override
+	{ m_source->loadRecord(node, m_offset, m_source); }
+
+	void collectScalarNames(QSet<QString>* names) const override
+	{ m_source->collectScalarNames(m_offset, names); }
+
+	// NOTE: JsonTreeSnapshotSource fills the nodes through these, on behalf of the loader
+	using DataTreeModelNodeLoader<QJsonValue>::appendChild;
+	using DataTreeModelNodeLoader<QJsonValue>::appendNamedChild;
+	using DataTreeModelNodeLoader<QJsonValue>::insertNamedScalar;
+
+private:
+	QSharedPointer<JsonTreeSnapshotSource> m_source;
+	quint32 m_offset;
+	int m_childCount;
+};
+
+#endif // JSONTREESNAPSHOT_H
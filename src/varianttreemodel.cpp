@@ -0,0 +1,269 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "varianttreemodel.h"
+
+//=================================
+// VariantTreeModel itself
+//=================================
+/*!
+	\class VariantTreeModel
+	\brief The VariantTreeModel class provides a data model for an in-memory tree of
+		   QVariantLists and QVariantMaps.
+
+	VariantTreeModel lays out its data in the same way as JsonTreeModel:
+
+	- Column 0 shows the structure of the tree. It contains list index numbers and map keys.
+	- Column 1 shows the scalar elements of lists.
+	- Columns 2 and above show the scalar members of maps (the \e named \e scalar \e columns).
+
+	The scalar values are stored as QVariants, so data() returns them as-is without converting
+	every cell. QVariantHashes are treated like QVariantMaps, and QStringLists are treated like
+	QVariantLists.
+
+	\sa JsonTreeModel
+*/
+
+/*!
+	\enum VariantTreeModel::ScalarColumnSearchMode
+	\brief This enum controls how setVariant() updates the model's column headers.
+
+	The values have the same meaning as JsonTreeModel::ScalarColumnSearchMode.
+
+	\sa setVariant(), setScalarColumns()
+*/
+
+/*!
+	\brief Constructs an empty VariantTreeModel with the given \a parent.
+*/
+VariantTreeModel::VariantTreeModel(QObject* parent) :
+	QAbstractItemModel(parent),
+	m_rootNode(nullptr),
+	m_headers({"<Structure>", "<Scalar>"})
+{}
+
+/*!
+	Horizontal headers show the text of scalarColumns() for the third column onwards.
+	Vertical headers show the text of column 0.
+*/
+QVariant
+VariantTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (role == Qt::DisplayRole)
+	{
+		if (orientation == Qt::Horizontal && section < m_headers.count())
+			return m_headers[section];
+
+		// ASSUMPTION: Vertical headers are only requested by Table Views
+		return data(index(section, 0));
+	}
+	return QAbstractItemModel::headerData(section, orientation, role);
+}
+
+QModelIndex
+VariantTreeModel::index(int row, int column, const QModelIndex& parent) const
+{
+	// NOTE: m_headers also takes the struct column and scalar column into account
+	if (column >= m_headers.count() || column < 0)
+		return QModelIndex();
+
+	auto childNode = VariantTreeModelCore::child(VariantTreeModelCore::listNode(parent, m_rootNode), row);
+	if (childNode == nullptr)
+		return QModelIndex();
+	return createIndex(row, column, childNode);
+}
+
+QModelIndex
+VariantTreeModel::parent(const QModelIndex& index) const
+{
+	int parentRow;
+	auto parentNode = VariantTreeModelCore::parentNode(index, m_rootNode, &parentRow);
+	if (parentNode == nullptr)
+		return QModelIndex();
+	return createIndex(parentRow, 0, parentNode);
+}
+
+/*!
+	\brief Returns the number of rows under the given \a parent.
+
+	If the \a parent represents a list, then the row count equals the number of list elements.
+	If the \a parent represents a map, then the row count equals the number of child lists and
+	child maps combined.
+
+	\sa columnCount()
+*/
+int
+VariantTreeModel::rowCount(const QModelIndex& parent) const
+{
+	return VariantTreeModelCore::rowCount(parent, m_rootNode);
+}
+
+/*!
+	\brief Returns the number of columns in the model.
+
+	This number is the same for the entire model; the \a parent is irrelevant.
+
+	\sa rowCount(), scalarColumns()
+*/
+int
+VariantTreeModel::columnCount(const QModelIndex& parent) const
+{
+	Q_UNUSED(parent);
+
+	// NOTE: The headers list includes Struct and Scalar columns
+	return m_headers.count();
+}
+
+/*!
+	\brief Returns data under the given \a index for the specified \a role.
+
+	Only valid when \a role is \c Qt::DisplayRole or \c Qt::EditRole.
+
+	\sa setData(), variant()
+*/
+QVariant
+VariantTreeModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+		return QVariant();
+	return VariantTreeModelCore::displayData(index, m_headers);
+}
+
+/*!
+	\brief Stores the given \a value under the given \a index, if the \a role is \c Qt::EditRole.
+
+	Only scalar elements of lists and scalar members of maps can be set. A null QVariant is
+	stored as a null scalar; it does not remove the member.
+
+	\sa data(), setVariant()
+*/
+bool
+VariantTreeModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+	// NOTE: isEditable() checks for index validity
+	QVariant newData;
+	if ( role != Qt::EditRole || !VariantTreeModelCore::isEditable(index)
+			|| !VariantTreeModelNode::Traits::fromVariant(value, &newData) )
+	{
+		return false;
+	}
+
+	// NOTE: isEditable() only accepts scalar nodes in the "Scalar" column, and objects in the named scalar columns
+	auto node = static_cast<VariantTreeModelNode*>(index.internalPointer());
+	if (index.column() == 1)
+	{
+		auto scalarNode = static_cast<VariantTreeModelScalarNode*>(node);
+		if (scalarNode->value() == newData)
+			return false;
+		scalarNode->setValue(newData);
+	}
+	else
+	{
+		// NOTE: A missing member reads as a null QVariant too, so storing a null must still add it
+		auto namedNode = static_cast<VariantTreeModelNamedListNode*>(node);
+		const QString& name = m_headers[index.column()];
+		if ( namedNode->namedScalars().contains(name) && namedNode->namedScalarValue(name) == newData )
+			return false;
+		namedNode->setNamedScalarValue(name, newData);
+	}
+
+	emit dataChanged(index, index, QVector<int>{Qt::DisplayRole, Qt::EditRole});
+	return true;
+}
+
+Qt::ItemFlags
+VariantTreeModel::flags(const QModelIndex& index) const
+{
+	if (VariantTreeModelCore::isEditable(index))
+		return QAbstractItemModel::flags(index) | Qt::ItemIsEditable;
+	return QAbstractItemModel::flags(index);
+}
+
+/*!
+	\brief Returns the value under the given \a index.
+
+	If the \a index is invalid, then this function returns the entire tree stored in the model.
+
+	\sa setVariant(), data()
+*/
+QVariant
+VariantTreeModel::variant(const QModelIndex& index) const
+{
+	return VariantTreeModelCore::value(index, m_rootNode, m_headers);
+}
+
+/*!
+	\brief Sets the whole model's internal data structure to the given \a list.
+
+	If \a searchMode is \c QuickSearch (default) or \c ComprehensiveSearch, this function also
+	updates the column headers.
+
+	\sa variant(), setData()
+*/
+void
+VariantTreeModel::setVariant(const QVariantList& list, ScalarColumnSearchMode searchMode)
+{
+	beginResetModel();
+	if (m_rootNode != nullptr)
+		delete m_rootNode;
+
+	// NOTE: The columns are collected while the nodes are created
+	DataTreeScalarNameCollector collector(searchMode == ComprehensiveSearch);
+	m_rootNode = new VariantTreeModelListNode(list, nullptr, nullptr, (searchMode != NoSearch) ? &collector : nullptr);
+
+	if (searchMode != NoSearch)
+	{
+		auto scalarCols = collector.names.toList();
+		std::sort(scalarCols.begin(), scalarCols.end());
+		m_headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
+	}
+	endResetModel();
+}
+
+/*!
+	\brief Sets the whole model's internal data structure to the given \a map.
+
+	If \a searchMode is \c QuickSearch (default) or \c ComprehensiveSearch, this function also updates the column headers.
+
+	\sa variant(), setData()
+*/
+void
+VariantTreeModel::setVariant(const QVariantMap& map, ScalarColumnSearchMode searchMode)
+{
+	beginResetModel();
+	if (m_rootNode != nullptr)
+		delete m_rootNode;
+
+	DataTreeScalarNameCollector collector(searchMode == ComprehensiveSearch);
+	auto namedListNode = new VariantTreeModelNamedListNode(map, nullptr, nullptr, (searchMode != NoSearch) ? &collector : nullptr);
+	if (namedListNode->namedScalarCount() > 0)
+		m_rootNode = new VariantTreeModelWrapperNode(namedListNode);
+	else
+		m_rootNode = namedListNode;
+
+	if (searchMode != NoSearch)
+	{
+		auto scalarCols = collector.names.toList();
+		std::sort(scalarCols.begin(), scalarCols.end());
+		m_headers = QStringList{m_headers[0], m_headers[1]} << scalarCols;
+	}
+	endResetModel();
+}
+
+/*!
+	\brief Sets the maps' scalar members that are shown by the model.
+
+	\sa scalarColumns(), setVariant()
+*/
+void
+VariantTreeModel::setScalarColumns(const QStringList& columns)
+{
+	beginResetModel();
+	m_headers = QStringList{m_headers[0], m_headers[1]} << columns;
+	endResetModel();
+}
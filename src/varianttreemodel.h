@@ -0,0 +1,74 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef VARIANTTREEMODEL_H
+#define VARIANTTREEMODEL_H
+
+#include "datatreemodelcore.h"
+#include <QAbstractItemModel>
+#include <QStringList>
+
+//=================================
+// VariantTreeModelNode and subclasses
+//=================================
+typedef DataTreeModelNode<QVariant>          VariantTreeModelNode;
+typedef DataTreeModelScalarNode<QVariant>    VariantTreeModelScalarNode;
+typedef DataTreeModelListNode<QVariant>      VariantTreeModelListNode;
+typedef DataTreeModelNamedListNode<QVariant> VariantTreeModelNamedListNode;
+typedef DataTreeModelWrapperNode<QVariant>   VariantTreeModelWrapperNode;
+typedef DataTreeModelCore<QVariant>          VariantTreeModelCore;
+
+
+//=================================
+// VariantTreeModel itself
+//=================================
+class VariantTreeModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+public:
+	enum ScalarColumnSearchMode
+	{
+		NoSearch,
+		QuickSearch,
+		ComprehensiveSearch
+	};
+
+	explicit VariantTreeModel(QObject* parent = nullptr);
+	~VariantTreeModel() override { delete m_rootNode; }
+
+	// Header:
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	// Basic functionality:
+	QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+	QModelIndex parent(const QModelIndex& index) const override;
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+	// Editable:
+	bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+	Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+	// API specific to VariantTreeModel:
+	void setVariant(const QVariantList& list, ScalarColumnSearchMode searchMode = QuickSearch);
+	void setVariant(const QVariantMap& map, ScalarColumnSearchMode searchMode = QuickSearch);
+	QVariant variant(const QModelIndex& index = QModelIndex()) const;
+
+	void setScalarColumns(const QStringList& columns);
+	QStringList scalarColumns() const { return m_headers.mid(2); }
+
+private:
+	VariantTreeModelListNode* m_rootNode;
+	QStringList m_headers;
+};
+
+#endif // VARIANTTREEMODEL_H
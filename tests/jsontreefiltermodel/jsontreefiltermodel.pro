@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_jsontreefiltermodel
+
+SOURCES += \
+    tst_jsontreefiltermodel.cpp
@@ -0,0 +1,241 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreefiltermodel.h"
+#include <QtTest>
+
+class tst_JsonTreeFilterModel : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init();
+	void cleanup();
+
+	void filterKeepsAncestors();
+	void editsRevalidate();
+	void patchesRevalidate();
+	void trimMemoryKeepsShownNodes_data();
+	void trimMemoryKeepsShownNodes();
+
+private:
+	int nameColumn() const { return m_model->scalarColumns().indexOf("name") + 2; }
+	void compareRows(const QModelIndex& parent);
+
+	JsonTreeModel* m_model;
+	JsonTreeFilterModel* m_filterModel;
+};
+
+/*
+	100 objects named "item 0" to "item 99", each with an array of 5 objects named "child 0" to
+	"child 499"
+*/
+static QJsonArray
+sampleDocument()
+{
+	QJsonArray document;
+	for (int i = 0; i < 100; ++i)
+	{
+		QJsonArray children;
+		for (int j = 0; j < 5; ++j)
+			children << QJsonObject{{"name", QString("child %1").arg(i * 5 + j)}, {"tags", QJsonArray{"x", "y"}}};
+		document << QJsonObject{{"name", QString("item %1").arg(i)}, {"group", i % 10}, {"children", children}};
+	}
+	return document;
+}
+
+static bool
+containsSeven(const QJsonValue& value)
+{
+	return value.toString().contains('7');
+}
+
+/*
+	Returns the rows under the given source parent that the filter should show: the rows that
+	match, and the rows that have matching descendants.
+*/
+static QModelIndexList
+expectedRows(const JsonTreeModel& model, const QModelIndex& parent)
+{
+	QModelIndexList rows;
+	for (int row = 0; row < model.rowCount(parent); ++row)
+	{
+		const QModelIndex index = model.index(row, 0, parent);
+		const QJsonValue value = model.json(index);
+		if ( (value.isObject() && value.toObject().contains("name") && containsSeven(value.toObject().value("name")))
+				|| !expectedRows(model, index).isEmpty() )
+			rows << index;
+	}
+	return rows;
+}
+
+void
+tst_JsonTreeFilterModel::init()
+{
+	m_model = new JsonTreeModel(this);
+	m_model->setJson(sampleDocument());
+	m_filterModel = new JsonTreeFilterModel(m_model, m_model);
+}
+
+void
+tst_JsonTreeFilterModel::cleanup()
+{
+	delete m_model;
+	m_model = nullptr;
+	m_filterModel = nullptr;
+}
+
+/*
+	Checks that the rows under the given parent of the filter model, and their descendants, are
+	the rows that a walk of the source model expects.
+*/
+void
+tst_JsonTreeFilterModel::compareRows(const QModelIndex& parent)
+{
+	const QModelIndexList expected = expectedRows(*m_model, m_filterModel->mapToSource(parent));
+	QCOMPARE(m_filterModel->rowCount(parent), expected.count());
+	for (int row = 0; row < expected.count(); ++row)
+	{
+		const QModelIndex index = m_filterModel->index(row, 0, parent);
+		QCOMPARE(m_filterModel->mapToSource(index), expected[row]);
+		QCOMPARE(m_filterModel->mapFromSource(expected[row]), index);
+		QCOMPARE(index.parent(), parent);
+
+		compareRows(index);
+		if (QTest::currentTestFailed())
+			return;
+	}
+}
+
+void
+tst_JsonTreeFilterModel::filterKeepsAncestors()
+{
+	QVERIFY(!m_filterModel->isFiltered());
+	QCOMPARE(m_filterModel->rowCount(), 100);
+
+	m_filterModel->setFilter("name", containsSeven);
+	QVERIFY(m_filterModel->isFiltered());
+	QVERIFY(m_filterModel->rowCount() > 0);
+	QVERIFY(m_filterModel->rowCount() < 100);
+	compareRows(QModelIndex());
+	if (QTest::currentTestFailed())
+		return;
+
+	// "item 1" has no 7, but its child "child 7" does
+	const QModelIndex item1 = m_filterModel->mapFromSource(m_model->index(1, 0));
+	QVERIFY(item1.isValid());
+	QCOMPARE(m_filterModel->rowCount(item1), 1);
+
+	m_filterModel->clearFilter();
+	QCOMPARE(m_filterModel->rowCount(), 100);
+	compareRows(QModelIndex());
+}
+
+void
+tst_JsonTreeFilterModel::editsRevalidate()
+{
+	m_filterModel->setFilter("name", containsSeven);
+	const int shownCount = m_filterModel->rowCount();
+	QSignalSpy inserted(m_filterModel, &QAbstractItemModel::rowsInserted);
+	QSignalSpy reset(m_filterModel, &QAbstractItemModel::modelReset);
+
+	// A hidden row starts to match, so it is inserted
+	QVERIFY(!m_filterModel->mapFromSource(m_model->index(0, 0)).isValid());
+	QVERIFY(m_model->setData(m_model->index(0, nameColumn()), "item 7 (renamed)"));
+	QCOMPARE(m_filterModel->rowCount(), shownCount + 1);
+	QCOMPARE(inserted.count(), 1);
+	QVERIFY(!inserted.first().at(0).value<QModelIndex>().isValid());
+	compareRows(QModelIndex());
+	if (QTest::currentTestFailed())
+		return;
+
+	// The only match under "item 1" stops matching, so "item 1" is removed too
+	const QModelIndex children = m_model->index(0, 0, m_model->index(1, 0));
+	QVERIFY(m_model->setData(m_model->index(2, nameColumn(), children), "renamed"));
+	QVERIFY(!m_filterModel->mapFromSource(m_model->index(1, 0)).isValid());
+	QCOMPARE(m_filterModel->rowCount(), shownCount);
+	compareRows(QModelIndex());
+	if (QTest::currentTestFailed())
+		return;
+
+	// "item 7" stops matching, but stays because "child 37" matches
+	QVERIFY(m_model->setData(m_model->index(7, nameColumn()), "renamed"));
+	QVERIFY(m_filterModel->mapFromSource(m_model->index(7, 0)).isValid());
+	compareRows(QModelIndex());
+	QCOMPARE(reset.count(), 0);
+}
+
+void
+tst_JsonTreeFilterModel::patchesRevalidate()
+{
+	m_model->setUndoLimit(10);
+	m_filterModel->setFilter("name", containsSeven);
+	QSignalSpy reset(m_filterModel, &QAbstractItemModel::modelReset);
+
+	QVERIFY(m_model->applyPatch(QJsonArray{
+		QJsonObject{{"op", "add"}, {"path", "/0"}, {"value", QJsonObject{{"name", "new 7"}}}},
+		QJsonObject{{"op", "add"}, {"path", "/-"}, {"value", QJsonObject{{"name", "new"}}}},
+		QJsonObject{{"op", "remove"}, {"path", "/18"}},          // "item 17"
+		QJsonObject{{"op", "remove"}, {"path", "/2/children/2"}} // "child 7", the only match under "item 1"
+	}));
+	QCOMPARE(reset.count(), 0);
+	compareRows(QModelIndex());
+	if (QTest::currentTestFailed())
+		return;
+
+	QVERIFY(m_model->undo());
+	QCOMPARE(reset.count(), 0);
+	compareRows(QModelIndex());
+}
+
+void
+tst_JsonTreeFilterModel::trimMemoryKeepsShownNodes_data()
+{
+	QTest::addColumn<bool>("compressed");
+
+	QTest::newRow("page file") << false;
+	QTest::newRow("compressed") << true;
+}
+
+/*
+	The filter model refers to the source model's nodes, so the rows that it shows must survive
+	evictions.
+*/
+void
+tst_JsonTreeFilterModel::trimMemoryKeepsShownNodes()
+{
+	QFETCH(bool, compressed);
+	m_model->setPageCompression(compressed);
+	m_filterModel->setFilter("name", containsSeven);
+	const int shownCount = m_filterModel->rowCount();
+	const QPersistentModelIndex shownRow = m_filterModel->index(shownCount - 1, 0);
+
+	m_model->setMemoryBudget(1);
+	const qint64 residentBytes = m_model->residentBytes();
+	m_model->trimMemory();
+	QVERIFY(m_model->residentBytes() < residentBytes);
+	if (compressed)
+		QVERIFY(m_model->compressionStatistics().compressedPages > 0);
+
+	QVERIFY(shownRow.isValid());
+	QCOMPARE(shownRow.row(), shownCount - 1);
+	QCOMPARE(m_filterModel->rowCount(), shownCount);
+	compareRows(QModelIndex());
+	if (QTest::currentTestFailed())
+		return;
+
+	// Rows that were paged out are read back, and still revalidated when they change
+	m_model->trimMemory();
+	const QModelIndex children = m_model->index(0, 0, m_model->index(2, 0));
+	QVERIFY(m_model->setData(m_model->index(0, nameColumn(), children), "child 7 (renamed)"));
+	QVERIFY(m_filterModel->mapFromSource(m_model->index(2, 0)).isValid());
+	compareRows(QModelIndex());
+}
+
+QTEST_GUILESS_MAIN(tst_JsonTreeFilterModel)
+#include "tst_jsontreefiltermodel.moc"
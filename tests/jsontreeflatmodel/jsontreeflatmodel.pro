@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_jsontreeflatmodel
+
+SOURCES += \
+    tst_jsontreeflatmodel.cpp
@@ -0,0 +1,199 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreeflatmodel.h"
+#include <QtTest>
+
+class tst_JsonTreeFlatModel : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init();
+	void cleanup();
+
+	void collapsedRows();
+	void expandAndCollapse();
+	void mappingMatchesTreeWalk();
+	void sourceRowChanges();
+
+private:
+	void expandRow(int row, bool expanded);
+	void compareWithTreeWalk();
+
+	JsonTreeModel m_model;
+	JsonTreeFlatModel* m_flatModel;
+	QSet<QPersistentModelIndex> m_expanded;
+};
+
+/*
+	50 objects, each with an array of 5 objects that each hold an array of 3 numbers
+*/
+static QJsonArray
+sampleDocument()
+{
+	QJsonArray document;
+	for (int i = 0; i < 50; ++i)
+	{
+		QJsonArray children;
+		for (int j = 0; j < 5; ++j)
+			children << QJsonObject{{"name", QString("%1.%2").arg(i).arg(j)}, {"values", QJsonArray{i, j, i + j}}};
+		document << QJsonObject{{"id", i}, {"children", children}};
+	}
+	return document;
+}
+
+/*
+	Appends the rows that a tree view would show, in order, to rows.
+*/
+static void
+appendShownRows(const JsonTreeModel& model, const QModelIndex& parent, const QSet<QPersistentModelIndex>& expanded, QModelIndexList* rows)
+{
+	for (int row = 0; row < model.rowCount(parent); ++row)
+	{
+		const QModelIndex index = model.index(row, 0, parent);
+		*rows << index;
+		if (expanded.contains(index))
+			appendShownRows(model, index, expanded, rows);
+	}
+}
+
+void
+tst_JsonTreeFlatModel::init()
+{
+	m_expanded.clear();
+	m_model.setJson(sampleDocument());
+	m_flatModel = new JsonTreeFlatModel(&m_model, this);
+}
+
+void
+tst_JsonTreeFlatModel::cleanup()
+{
+	delete m_flatModel; // NOTE: Only one flat model may be attached to a JsonTreeModel
+	m_flatModel = nullptr;
+}
+
+/*
+	Expands or collapses a flat row, and records its expansion state for compareWithTreeWalk().
+*/
+void
+tst_JsonTreeFlatModel::expandRow(int row, bool expanded)
+{
+	const QPersistentModelIndex sourceIndex = m_flatModel->mapToSource(m_flatModel->index(row, 0));
+	m_flatModel->setExpanded(row, expanded);
+	if (!m_flatModel->isExpanded(row))
+		m_expanded.remove(sourceIndex);
+	else
+		m_expanded.insert(sourceIndex);
+}
+
+/*
+	Checks that every flat row maps to the source row that a tree walk finds at the same position,
+	and back.
+*/
+void
+tst_JsonTreeFlatModel::compareWithTreeWalk()
+{
+	QModelIndexList expected;
+	appendShownRows(m_model, QModelIndex(), m_expanded, &expected);
+
+	QCOMPARE(m_flatModel->rowCount(), expected.count());
+	for (int row = 0; row < expected.count(); ++row)
+	{
+		const QModelIndex index = m_flatModel->index(row, 0);
+		QCOMPARE(m_flatModel->mapToSource(index), expected[row]);
+		QCOMPARE(m_flatModel->mapFromSource(expected[row]), index);
+
+		int depth = 0;
+		for (QModelIndex parent = expected[row].parent(); parent.isValid(); parent = parent.parent())
+			++depth;
+		QCOMPARE(m_flatModel->data(index, JsonTreeFlatModel::DepthRole).toInt(), depth);
+	}
+}
+
+void
+tst_JsonTreeFlatModel::collapsedRows()
+{
+	QCOMPARE(m_flatModel->rowCount(), 50);
+	QCOMPARE(m_flatModel->columnCount(), m_model.columnCount());
+	QVERIFY(!m_flatModel->isExpanded(0));
+	QVERIFY(m_flatModel->data(m_flatModel->index(0, 0), JsonTreeFlatModel::HasChildrenRole).toBool());
+	compareWithTreeWalk();
+}
+
+void
+tst_JsonTreeFlatModel::expandAndCollapse()
+{
+	QSignalSpy inserted(m_flatModel, &QAbstractItemModel::rowsInserted);
+	QSignalSpy removed(m_flatModel, &QAbstractItemModel::rowsRemoved);
+
+	// Row 0 has one child row ("children"), which has 5 rows
+	expandRow(0, true);
+	QCOMPARE(m_flatModel->rowCount(), 51);
+	expandRow(1, true);
+	QCOMPARE(m_flatModel->rowCount(), 56);
+	QCOMPARE(inserted.count(), 2);
+	compareWithTreeWalk();
+
+	// Collapsing the top row hides its descendants, but keeps their expansion states
+	expandRow(0, false);
+	QCOMPARE(m_flatModel->rowCount(), 50);
+	QCOMPARE(removed.count(), 1);
+	QCOMPARE(removed.first().at(1).toInt(), 1);
+	QCOMPARE(removed.first().at(2).toInt(), 6);
+	compareWithTreeWalk();
+
+	expandRow(0, true);
+	QCOMPARE(m_flatModel->rowCount(), 56);
+	QVERIFY(m_flatModel->isExpanded(1));
+	compareWithTreeWalk();
+}
+
+void
+tst_JsonTreeFlatModel::mappingMatchesTreeWalk()
+{
+	// Expand and collapse pseudo-random rows, so that the Fenwick trees are updated at every level
+	quint32 seed = 12345;
+	for (int step = 0; step < 300; ++step)
+	{
+		seed = seed * 1103515245 + 12345;
+		const int row = int((seed >> 8) % quint32(m_flatModel->rowCount()));
+		expandRow(row, (seed >> 4) % 4 != 0);
+	}
+	compareWithTreeWalk();
+}
+
+void
+tst_JsonTreeFlatModel::sourceRowChanges()
+{
+	for (int row = m_flatModel->rowCount() - 1; row >= 0; row -= 7)
+		expandRow(row, true);
+	compareWithTreeWalk();
+	if (QTest::currentTestFailed())
+		return;
+
+	// Rows are inserted and removed under expanded rows, collapsed rows and the top level
+	QVERIFY(m_model.applyPatch(QJsonArray{
+		QJsonObject{{"op", "remove"}, {"path", "/7"}},
+		QJsonObject{{"op", "add"}, {"path", "/0/children/-"}, {"value", QJsonObject{{"name", "new"}}}},
+		QJsonObject{{"op", "add"}, {"path", "/1/children/0"}, {"value", QJsonObject{{"name", "first"}}}},
+		QJsonObject{{"op", "add"}, {"path", "/3"}, {"value", QJsonObject{{"id", -1}}}},
+		QJsonObject{{"op", "remove"}, {"path", "/42/children/2"}}
+	}));
+	compareWithTreeWalk();
+	if (QTest::currentTestFailed())
+		return;
+
+	m_model.setJson(QJsonArray{1, 2, 3});
+	m_expanded.clear();
+	QCOMPARE(m_flatModel->rowCount(), 3);
+	compareWithTreeWalk();
+}
+
+QTEST_GUILESS_MAIN(tst_JsonTreeFlatModel)
+#include "tst_jsontreeflatmodel.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_jsontreemodel
+
+SOURCES += \
+    tst_jsontreemodel.cpp
@@ -0,0 +1,715 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "jsontreemodel.h"
+#include "jsontreequery.h"
+#include <QtTest>
+
+class tst_JsonTreeModel : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init();
+
+	void revisionSnapshots();
+	void revisionSnapshotsOfWrappedDocument();
+	void snapshotRoundTrip();
+	void corruptSnapshotsAreRejected_data();
+	void corruptSnapshotsAreRejected();
+	void corruptRecordsKeepTheirRows();
+	void batchesCoalesceRanges();
+	void throttledNotifications();
+	void failedPatchesAreReverted_data();
+	void failedPatchesAreReverted();
+	void pagedRowsRoundTrip();
+	void updatesFromManyThreads();
+	void compressedRowsRoundTrip();
+	void upsertKeyedRows();
+	void branchColumnsOfDeferredRows();
+	void queryExpressions_data();
+	void queryExpressions();
+	void queryFiltersObjectMembers();
+	void malformedQueries_data();
+	void malformedQueries();
+	void ndjsonChunksKeepFileOrder();
+	void followedFilesAppendRows();
+
+private:
+	int nameColumn() const { return m_model.scalarColumns().indexOf("name") + 2; }
+
+	JsonTreeModel m_model;
+};
+
+/*
+	Two objects, each with a name and an array of tags
+*/
+static QJsonArray
+sampleDocument()
+{
+	return QJsonArray{
+		QJsonObject{{"name", "first"}, {"tags", QJsonArray{1, 2}}},
+		QJsonObject{{"name", "second"}, {"tags", QJsonArray{3}}}
+	};
+}
+
+/*
+	Returns the snapshot of a model that holds the given document
+*/
+static QByteArray
+snapshotOf(const QJsonArray& document)
+{
+	JsonTreeModel model;
+	model.setJson(document);
+
+	QBuffer buffer;
+	buffer.open(QIODevice::WriteOnly);
+	model.saveSnapshot(&buffer);
+	return buffer.data();
+}
+
+static QByteArray
+patched(QByteArray data, int offset, quint32 value)
+{
+	qToLittleEndian<quint32>(value, data.data() + offset);
+	return data;
+}
+
+static bool
+loadSnapshot(JsonTreeModel* model, const QByteArray& data)
+{
+	QBuffer buffer;
+	buffer.setData(data);
+	buffer.open(QIODevice::ReadOnly);
+	return model->loadSnapshot(&buffer);
+}
+
+/*
+	4 rows with the scalar members "a" and "b"
+*/
+static QJsonArray
+tableDocument()
+{
+	QJsonArray document;
+	for (int i = 0; i < 4; ++i)
+		document << QJsonObject{{"a", i}, {"b", i * 10}};
+	return document;
+}
+
+/*
+	A store of 3 items with scalar members, arrays and a nested object
+*/
+static QJsonObject
+storeDocument()
+{
+	return QJsonObject{{"store", QJsonArray{
+		QJsonObject{{"name", "a"}, {"price", 5}, {"tags", QJsonArray{1, 2}}},
+		QJsonObject{{"name", "b c"}, {"price", 15}, {"tags", QJsonArray{3}}},
+		QJsonObject{{"name", "d"}, {"price", 25}, {"sale", true}, {"owner", QJsonObject{{"name", "e"}}}}
+	}}};
+}
+
+/*
+	200 objects, each with an array of 10 objects that hold some text
+*/
+static QJsonArray
+largeDocument()
+{
+	QJsonArray document;
+	for (int i = 0; i < 200; ++i)
+	{
+		QJsonArray children;
+		for (int j = 0; j < 10; ++j)
+			children << QJsonObject{{"name", QString("child %1").arg(i * 10 + j)}, {"text", QString("lorem ipsum ").repeated(8)}};
+		document << QJsonObject{{"name", QString("item %1").arg(i)}, {"children", children}};
+	}
+	return document;
+}
+
+/*
+	Posts updates to the row of the given index: 1 to 100 to the elements of its "values" array,
+	and then 0 to 999 to its "count".
+*/
+class UpdatePoster : public QThread
+{
+public:
+	UpdatePoster(JsonTreeModel* model, int row) : m_model(model), m_row(row) {}
+
+protected:
+	void run() override
+	{
+		for (int i = 0; i < 100; ++i)
+			m_model->postUpdate(QString("/%1/values/%2").arg(m_row).arg(i), i + 1);
+		for (int i = 0; i < 1000; ++i)
+			m_model->postUpdate(QString("/%1/count").arg(m_row), i);
+	}
+
+private:
+	JsonTreeModel* m_model;
+	int m_row;
+};
+
+void
+tst_JsonTreeModel::init()
+{
+	m_model.setUndoLimit(10);
+	m_model.setJson(sampleDocument());
+}
+
+void
+tst_JsonTreeModel::revisionSnapshots()
+{
+	QVector<int> revisions{m_model.snapshot()};
+	QVector<QJsonValue> documents{m_model.json()};
+
+	QVERIFY(m_model.setData(m_model.index(0, nameColumn()), "renamed"));
+	revisions << m_model.snapshot();
+	documents << m_model.json();
+
+	QVERIFY(m_model.applyPatch(QJsonArray{
+		QJsonObject{{"op", "add"}, {"path", "/1/tags/0"}, {"value", QJsonObject{{"nested", true}}}},
+		QJsonObject{{"op", "move"}, {"from", "/0/tags"}, {"path", "/1/moved"}},
+		QJsonObject{{"op", "copy"}, {"from", "/1/name"}, {"path", "/0/copied"}},
+		QJsonObject{{"op", "remove"}, {"path", "/1/name"}}
+	}));
+	revisions << m_model.snapshot();
+	documents << m_model.json();
+
+	QVERIFY(m_model.setData(m_model.index(0, nameColumn()), "named again"));
+	revisions << m_model.snapshot();
+	documents << m_model.json();
+
+	// Every revision can be read without changing the model
+	for (int i = 0; i < revisions.count(); ++i)
+	{
+		const JsonTreeReadSnapshot view = m_model.readSnapshot(revisions[i]);
+		QVERIFY(!view.isNull());
+		QCOMPARE(view.revision(), revisions[i]);
+		QCOMPARE(view.value(), documents[i]);
+	}
+	QCOMPARE(m_model.snapshot(), revisions.last());
+	QCOMPARE(m_model.json(), documents.last());
+	QVERIFY(m_model.readSnapshot(revisions.first() - 1).isNull());
+	QVERIFY(m_model.readSnapshot(revisions.last() + 1).isNull());
+
+	// Undone revisions can be read until new edits replace them
+	QVERIFY(m_model.restore(revisions[1]));
+	QCOMPARE(m_model.readSnapshot(revisions[3]).value(), documents[3]);
+	QCOMPARE(m_model.readSnapshot(revisions[0]).value(), documents[0]);
+
+	QVERIFY(m_model.setData(m_model.index(1, nameColumn()), "replaced"));
+	QVERIFY(m_model.readSnapshot(revisions[3]).isNull());
+	QCOMPARE(m_model.readSnapshot(revisions[1]).value(), documents[1]);
+}
+
+void
+tst_JsonTreeModel::revisionSnapshotsOfWrappedDocument()
+{
+	// NOTE: The scalars of a top-level object are shown under a wrapper row, so the edited rows start at the wrapper
+	m_model.setJson(QJsonObject{{"name", "top"}, {"rows", sampleDocument()}});
+	const int revision = m_model.snapshot();
+	const QJsonValue document = m_model.json();
+
+	QVERIFY(m_model.setData(m_model.index(0, nameColumn()), "top renamed"));
+	const QModelIndex rows = m_model.index(0, 0, m_model.index(0, 0));
+	QVERIFY(m_model.setData(m_model.index(1, nameColumn(), rows), "second renamed"));
+
+	const JsonTreeReadSnapshot view = m_model.readSnapshot(revision);
+	QCOMPARE(view.value(), document);
+	QCOMPARE(view.value("/rows/1/name"), QJsonValue("second"));
+	QCOMPARE(view.childCount("/rows"), 2);
+	QCOMPARE(view.memberNames(), (QStringList{"name", "rows"}));
+	QCOMPARE(m_model.readSnapshot().value("/rows/1/name"), QJsonValue("second renamed"));
+}
+
+void
+tst_JsonTreeModel::snapshotRoundTrip()
+{
+	JsonTreeModel loaded;
+	QVERIFY(loadSnapshot(&loaded, snapshotOf(sampleDocument())));
+	QCOMPARE(loaded.json(), QJsonValue(sampleDocument()));
+	QCOMPARE(loaded.scalarColumns(), m_model.scalarColumns());
+	QCOMPARE(loaded.rowCount(loaded.index(0, 0, loaded.index(0, 0))), 2);
+}
+
+void
+tst_JsonTreeModel::corruptSnapshotsAreRejected_data()
+{
+	QTest::addColumn<QByteArray>("data");
+
+	// NOTE: See the snapshot layout in jsontreesnapshot.cpp for the header offsets
+	const QByteArray data = snapshotOf(sampleDocument());
+	QTest::newRow("empty") << QByteArray();
+	QTest::newRow("magic") << patched(data, 0, 0);
+	QTest::newRow("version") << patched(data, 4, 2);
+	QTest::newRow("truncated") << data.left(data.size() - 1);
+	QTest::newRow("string index") << patched(data, 20, data.size());
+	QTest::newRow("root offset") << patched(data, 32, data.size());
+	QTest::newRow("root kind") << patched(data, 8, 1);
+}
+
+/*
+	A snapshot that fails validation must not change the model.
+*/
+void
+tst_JsonTreeModel::corruptSnapshotsAreRejected()
+{
+	QFETCH(QByteArray, data);
+	QSignalSpy reset(&m_model, &QAbstractItemModel::modelReset);
+
+	QVERIFY(!loadSnapshot(&m_model, data));
+	QCOMPARE(reset.count(), 0);
+	QCOMPARE(m_model.json(), QJsonValue(sampleDocument()));
+}
+
+/*
+	The row count of a record is reported before its entries are decoded, so rows with corrupted
+	entries must still exist after they are loaded.
+*/
+void
+tst_JsonTreeModel::corruptRecordsKeepTheirRows()
+{
+	// NOTE: The root record is at offset 40, and its 16-byte entries start at offset 56
+	QByteArray data = snapshotOf(QJsonArray{QJsonArray{1, 2}, QJsonArray{3}, QJsonArray{4, 5}});
+	data = patched(data, 56 + 8, 40); // Row 0 refers to the root record
+	data = patched(data, 72 + 4, 99); // Row 1 has an unknown type
+
+	JsonTreeModel loaded;
+	QVERIFY(loadSnapshot(&loaded, data));
+	QCOMPARE(loaded.rowCount(), 3);
+	QCOMPARE(loaded.rowCount(loaded.index(0, 0)), 0);
+	QCOMPARE(loaded.rowCount(loaded.index(2, 0)), 2);
+	QCOMPARE(loaded.json(), QJsonValue(QJsonArray{QJsonValue(), QJsonValue(), QJsonArray{4, 5}}));
+}
+
+void
+tst_JsonTreeModel::batchesCoalesceRanges()
+{
+	m_model.setJson(tableDocument());
+	const int a = m_model.scalarColumns().indexOf("a") + 2;
+	const int b = m_model.scalarColumns().indexOf("b") + 2;
+	QCOMPARE(qAbs(b - a), 1);
+	const int left = qMin(a, b);
+	QSignalSpy changed(&m_model, &QAbstractItemModel::dataChanged);
+
+	// A fully changed block is a single range
+	QCOMPARE(m_model.setDataBatch(m_model.index(0, left), 2, QVariantList{-1, -2, -3, -4, -5, -6}), 6);
+	QCOMPARE(changed.count(), 1);
+	QCOMPARE(changed[0].at(0).value<QModelIndex>(), m_model.index(0, left));
+	QCOMPARE(changed[0].at(1).value<QModelIndex>(), m_model.index(2, left + 1));
+	QCOMPARE(m_model.data(m_model.index(2, left + 1)).toInt(), -6);
+
+	// Unchanged cells are not signalled
+	changed.clear();
+	QCOMPARE(m_model.setDataBatch(m_model.index(0, left), 2, QVariantList{-1, -2}), 0);
+	QCOMPARE(changed.count(), 0);
+
+	// Only adjacent cells are merged, so the ranges cover the changed cells exactly
+	QCOMPARE(m_model.setDataBatch(QVector<QPair<QModelIndex, QVariant>>{
+		qMakePair(m_model.index(3, a), QVariant(7)),
+		qMakePair(m_model.index(0, a), QVariant(7)),
+		qMakePair(m_model.index(2, a), QVariant(7))
+	}), 3);
+	QCOMPARE(changed.count(), 2);
+	QCOMPARE(changed[0].at(0).value<QModelIndex>(), m_model.index(0, a));
+	QCOMPARE(changed[0].at(1).value<QModelIndex>(), m_model.index(0, a));
+	QCOMPARE(changed[1].at(0).value<QModelIndex>(), m_model.index(2, a));
+	QCOMPARE(changed[1].at(1).value<QModelIndex>(), m_model.index(3, a));
+}
+
+void
+tst_JsonTreeModel::throttledNotifications()
+{
+	m_model.setJson(tableDocument());
+	const int a = m_model.scalarColumns().indexOf("a") + 2;
+	QSignalSpy changed(&m_model, &QAbstractItemModel::dataChanged);
+
+	// The data changes right away, but the signals wait for the flush
+	m_model.setNotificationInterval(60 * 60 * 1000);
+	for (int row = 0; row < 4; ++row)
+		QVERIFY(m_model.setData(m_model.index(row, a), row + 100));
+	QVERIFY(m_model.setData(m_model.index(1, a), 200));
+	QCOMPARE(m_model.data(m_model.index(1, a)).toInt(), 200);
+	QCOMPARE(changed.count(), 0);
+
+	m_model.flushChanges();
+	QCOMPARE(changed.count(), 1);
+	QCOMPARE(changed[0].at(0).value<QModelIndex>(), m_model.index(0, a));
+	QCOMPARE(changed[0].at(1).value<QModelIndex>(), m_model.index(3, a));
+
+	m_model.flushChanges();
+	QCOMPARE(changed.count(), 1);
+
+	// Changing the interval flushes the pending cells
+	QVERIFY(m_model.setData(m_model.index(2, a), 300));
+	m_model.setNotificationInterval(10);
+	QCOMPARE(changed.count(), 2);
+
+	// The timer flushes the pending cells too
+	QVERIFY(m_model.setData(m_model.index(3, a), 400));
+	QCOMPARE(changed.count(), 2);
+	QTRY_COMPARE(changed.count(), 3);
+	QCOMPARE(changed[2].at(0).value<QModelIndex>(), m_model.index(3, a));
+
+	m_model.setNotificationInterval(0);
+	QVERIFY(m_model.setData(m_model.index(3, a), 500));
+	QCOMPARE(changed.count(), 4);
+}
+
+void
+tst_JsonTreeModel::failedPatchesAreReverted_data()
+{
+	QTest::addColumn<QJsonObject>("failingOperation");
+
+	QTest::newRow("test") << QJsonObject{{"op", "test"}, {"path", "/0/name"}, {"value", "first"}};
+	QTest::newRow("missing path") << QJsonObject{{"op", "remove"}, {"path", "/5"}};
+	QTest::newRow("unknown op") << QJsonObject{{"op", "swap"}, {"path", "/0"}};
+}
+
+/*
+	A patch is applied completely or not at all, whichever of its operations fails.
+*/
+void
+tst_JsonTreeModel::failedPatchesAreReverted()
+{
+	QFETCH(QJsonObject, failingOperation);
+	const QJsonValue document = m_model.json();
+	const int revision = m_model.snapshot();
+	const bool couldUndo = m_model.canUndo();
+
+	QSignalSpy inserted(&m_model, &QAbstractItemModel::rowsInserted);
+	QSignalSpy removed(&m_model, &QAbstractItemModel::rowsRemoved);
+	QSignalSpy reset(&m_model, &QAbstractItemModel::modelReset);
+
+	QVERIFY(!m_model.applyPatch(QJsonArray{
+		QJsonObject{{"op", "replace"}, {"path", "/0/name"}, {"value", "renamed"}},
+		QJsonObject{{"op", "add"}, {"path", "/1/tags/-"}, {"value", QJsonArray{4, 5}}},
+		QJsonObject{{"op", "remove"}, {"path", "/0/tags/0"}},
+		QJsonObject{{"op", "move"}, {"from", "/1"}, {"path", "/0"}},
+		failingOperation
+	}));
+	QCOMPARE(m_model.json(), document);
+	QCOMPARE(m_model.data(m_model.index(0, nameColumn())).toString(), QString("first"));
+	QCOMPARE(m_model.snapshot(), revision);
+	QCOMPARE(m_model.canUndo(), couldUndo);
+
+	// The views see the rows come and go, but the model is never reset
+	QCOMPARE(inserted.count(), removed.count());
+	QCOMPARE(reset.count(), 0);
+}
+
+void
+tst_JsonTreeModel::pagedRowsRoundTrip()
+{
+	m_model.setJson(largeDocument());
+	m_model.setMemoryBudget(1);
+	const qint64 residentBytes = m_model.residentBytes();
+	QVERIFY(residentBytes > 0);
+
+	m_model.trimMemory();
+	QVERIFY(m_model.residentBytes() < residentBytes);
+	QCOMPARE(m_model.rowCount(), 200);
+
+	// Evicted rows are read back when they are reached
+	const QModelIndex children = m_model.index(0, 0, m_model.index(150, 0));
+	QCOMPARE(m_model.rowCount(children), 10);
+	QCOMPARE(m_model.data(m_model.index(3, nameColumn(), children)).toString(), QString("child 1503"));
+	QCOMPARE(m_model.json(), QJsonValue(largeDocument()));
+
+	// Edits to rows that were paged out are kept, and can be undone
+	m_model.trimMemory();
+	const QModelIndex moreChildren = m_model.index(0, 0, m_model.index(42, 0));
+	QVERIFY(m_model.setData(m_model.index(7, nameColumn(), moreChildren), "renamed"));
+	m_model.trimMemory();
+	QCOMPARE(m_model.data(m_model.index(7, nameColumn(), m_model.index(0, 0, m_model.index(42, 0)))).toString(), QString("renamed"));
+	QVERIFY(m_model.undo());
+	m_model.trimMemory();
+	QCOMPARE(m_model.json(), QJsonValue(largeDocument()));
+
+	m_model.setMemoryBudget(0);
+	QCOMPARE(m_model.json(), QJsonValue(largeDocument()));
+}
+
+void
+tst_JsonTreeModel::updatesFromManyThreads()
+{
+	QJsonArray zeros;
+	for (int i = 0; i < 100; ++i)
+		zeros << 0;
+	QJsonArray document;
+	for (int row = 0; row < 4; ++row)
+		document << QJsonObject{{"count", -1}, {"values", zeros}};
+	m_model.setJson(document);
+	const int revision = m_model.snapshot();
+
+	QVector<UpdatePoster*> posters;
+	for (int row = 0; row < 4; ++row)
+		posters << new UpdatePoster(&m_model, row);
+	for (auto poster : qAsConst(posters))
+		poster->start();
+	for (auto poster : qAsConst(posters))
+		poster->wait();
+	qDeleteAll(posters);
+
+	// Every update is applied, in the order that its thread posted it
+	QCOMPARE(m_model.applyPostedUpdates(), 4 * 1100);
+	QCOMPARE(m_model.applyPostedUpdates(), 0);
+	for (int row = 0; row < 4; ++row)
+	{
+		const QJsonObject object = m_model.json(m_model.index(row, 0)).toObject();
+		QCOMPARE(object.value("count"), QJsonValue(999));
+		const QJsonArray values = object.value("values").toArray();
+		QCOMPARE(values.count(), 100);
+		for (int i = 0; i < 100; ++i)
+			QCOMPARE(values[i], QJsonValue(i + 1));
+	}
+
+	// The batch is a single revision
+	QCOMPARE(m_model.snapshot(), revision + 1);
+	QVERIFY(m_model.undo());
+	QCOMPARE(m_model.json(), QJsonValue(document));
+}
+
+void
+tst_JsonTreeModel::compressedRowsRoundTrip()
+{
+	m_model.setJson(largeDocument());
+	m_model.setPageCompression(true);
+	m_model.setMemoryBudget(1);
+	const qint64 residentBytes = m_model.residentBytes();
+
+	// The compressed pages stay in memory, but take less of it than the rows did
+	m_model.trimMemory();
+	const JsonTreeModel::CompressionStatistics statistics = m_model.compressionStatistics();
+	QVERIFY(statistics.compressedPages > 0);
+	QVERIFY(statistics.ratio() > 1.0);
+	QCOMPARE(statistics.decompressedPages, 0);
+	QVERIFY(m_model.residentBytes() < residentBytes);
+
+	const QModelIndex children = m_model.index(0, 0, m_model.index(150, 0));
+	QCOMPARE(m_model.data(m_model.index(3, nameColumn(), children)).toString(), QString("child 1503"));
+	QVERIFY(m_model.compressionStatistics().decompressedPages > 0);
+	QCOMPARE(m_model.json(), QJsonValue(largeDocument()));
+
+	m_model.resetCompressionStatistics();
+	QCOMPARE(m_model.compressionStatistics().compressedPages, 0);
+}
+
+void
+tst_JsonTreeModel::upsertKeyedRows()
+{
+	m_model.setJson(tableDocument());
+	QVERIFY(m_model.setRowKey(QModelIndex(), "a"));
+	const int revision = m_model.snapshot();
+	QSignalSpy changed(&m_model, &QAbstractItemModel::dataChanged);
+	QSignalSpy inserted(&m_model, &QAbstractItemModel::rowsInserted);
+
+	// An existing row is updated in place; unchanged members are not signalled
+	QCOMPARE(m_model.upsertRow(QModelIndex(), QJsonObject{{"a", 2}, {"b", 20}, {"tags", QJsonArray{1}}}), m_model.index(2, 0));
+	QCOMPARE(m_model.upsertRow(QModelIndex(), QJsonObject{{"a", 2}, {"b", -20}, {"tags", QJsonArray{1}}}), m_model.index(2, 0));
+	QCOMPARE(changed.count(), 1);
+	QCOMPARE(inserted.count(), 1); // The "tags" row
+	QCOMPARE(m_model.json(m_model.index(2, 0)), QJsonValue(QJsonObject{{"a", 2}, {"b", -20}, {"tags", QJsonArray{1}}}));
+
+	// A new key appends a row
+	const QModelIndex appended = m_model.upsertRow(QModelIndex(), QJsonObject{{"a", 9}});
+	QCOMPARE(appended, m_model.index(4, 0));
+	QCOMPARE(m_model.indexForKey(QModelIndex(), 9), appended);
+	QVERIFY(!m_model.upsertRow(QModelIndex(), QJsonObject{{"b", 1}}).isValid());
+
+	// Each upsert is one revision
+	QCOMPARE(m_model.snapshot(), revision + 3);
+	QVERIFY(m_model.restore(revision));
+	QCOMPARE(m_model.json(), QJsonValue(tableDocument()));
+	QVERIFY(!m_model.indexForKey(QModelIndex(), 9).isValid());
+}
+
+/*
+	The rows of a loaded snapshot are decoded on demand, so their columns are read from the
+	snapshot's records.
+*/
+void
+tst_JsonTreeModel::branchColumnsOfDeferredRows()
+{
+	QJsonArray document = tableDocument();
+	document << QJsonObject{{"c", true}, {"rows", tableDocument()}};
+
+	JsonTreeModel loaded;
+	loaded.setBranchColumns(true);
+	QVERIFY(loadSnapshot(&loaded, snapshotOf(document)));
+	QCOMPARE(loaded.scalarColumns(QModelIndex()), (QStringList{"a", "b", "c"}));
+	QCOMPARE(loaded.columnCount(), 5);
+
+	const QModelIndex rows = loaded.index(0, 0, loaded.index(4, 0));
+	QCOMPARE(loaded.scalarColumns(rows), (QStringList{"a", "b"}));
+	QCOMPARE(loaded.json(), QJsonValue(document));
+}
+
+void
+tst_JsonTreeModel::queryExpressions_data()
+{
+	QTest::addColumn<QString>("expression");
+	QTest::addColumn<QJsonArray>("expected");
+
+	QTest::newRow("members") << "$.store[*].name" << QJsonArray{"a", "b c", "d"};
+	QTest::newRow("descendants") << "$.store..name" << QJsonArray{"a", "b c", "d", "e"};
+	QTest::newRow("descendant elements") << "$..tags[0]" << QJsonArray{1, 3};
+	QTest::newRow("negative index") << "$.store[-1].price" << QJsonArray{25};
+	QTest::newRow("index out of range") << "$.store[-4]" << QJsonArray();
+	QTest::newRow("single-quoted names") << "$['store'][1]['name']" << QJsonArray{"b c"};
+	QTest::newRow("double-quoted names") << "$[\"store\"][0][\"price\"]" << QJsonArray{5};
+	QTest::newRow("quoted operand") << "$.store[?(@.name == 'b c')].price" << QJsonArray{15};
+	QTest::newRow("elements") << "$.store[0].tags[?(@ > 1)]" << QJsonArray{2};
+
+	// NOTE: && binds more tightly than ||, in either order
+	QTest::newRow("&& after ||") << "$.store[?(@.price < 10 || @.price > 20 && @.sale)].name" << QJsonArray{"a", "d"};
+	QTest::newRow("&& before ||") << "$.store[?(@.sale && @.price > 20 || @.price < 10)].name" << QJsonArray{"a", "d"};
+	QTest::newRow("member exists") << "$.store[?(@.owner)].price" << QJsonArray{25};
+}
+
+/*
+	Queries select the same values whether or not column projection left the members out.
+*/
+void
+tst_JsonTreeModel::queryExpressions()
+{
+	QFETCH(QString, expression);
+	QFETCH(QJsonArray, expected);
+
+	const JsonTreeQuery query(expression);
+	QVERIFY2(query.isValid(), qPrintable(query.errorString()));
+
+	m_model.setJson(storeDocument());
+	QCOMPARE(m_model.queryValues(query), expected);
+
+	JsonTreeModel projected;
+	projected.setColumnProjection(true);
+	projected.setScalarColumns({"name"});
+	projected.setJson(storeDocument(), JsonTreeModel::NoSearch);
+	QCOMPARE(projected.queryValues(query), expected);
+}
+
+/*
+	A filter on an object selects its scalar members as well as its other members.
+*/
+void
+tst_JsonTreeModel::queryFiltersObjectMembers()
+{
+	m_model.setJson(storeDocument());
+
+	QCOMPARE(m_model.queryValues(JsonTreeQuery("$.store[2][?(@)]")),
+			QJsonArray({"d", 25, true, QJsonObject{{"name", "e"}}}));
+	QCOMPARE(m_model.queryValues(JsonTreeQuery("$.store[2][?(@ > 10)]")), QJsonArray{25});
+	QCOMPARE(m_model.queryValues(JsonTreeQuery("$.store[2][?(@.name)]")), QJsonArray({QJsonObject{{"name", "e"}}}));
+
+	const QModelIndexList indexes = m_model.query(JsonTreeQuery("$.store[2][?(@ == 'd')]"));
+	QCOMPARE(indexes.count(), 1);
+	QCOMPARE(indexes.first().data().toString(), QString("d"));
+}
+
+void
+tst_JsonTreeModel::malformedQueries_data()
+{
+	QTest::addColumn<QString>("expression");
+
+	QTest::newRow("no root") << "store";
+	QTest::newRow("no member name") << "$.";
+	QTest::newRow("unclosed bracket") << "$.store[0";
+	QTest::newRow("bad index") << "$.store[x]";
+	QTest::newRow("unterminated name") << "$['store";
+	QTest::newRow("no operand") << "$.store[?(@.price >)]";
+	QTest::newRow("no condition after &&") << "$.store[?(@.price > 1 &&)]";
+	QTest::newRow("unclosed filter") << "$.store[?(@.price > 1]";
+}
+
+void
+tst_JsonTreeModel::malformedQueries()
+{
+	QFETCH(QString, expression);
+
+	const JsonTreeQuery query(expression);
+	QVERIFY(!query.isValid());
+	QVERIFY(!query.errorString().isEmpty());
+
+	m_model.setJson(storeDocument());
+	QVERIFY(m_model.query(query).isEmpty());
+	QVERIFY(m_model.queryValues(query).isEmpty());
+}
+
+/*
+	The lines are parsed in chunks of at least 256 KiB on several threads, but the rows are
+	appended in the order of the lines.
+*/
+void
+tst_JsonTreeModel::ndjsonChunksKeepFileOrder()
+{
+	const QByteArray padding(100, 'x');
+	const int count = 12000;
+	QByteArray data;
+	for (int i = 0; i < count; ++i)
+	{
+		data += "{\"id\": " + QByteArray::number(i) + ", \"text\": \"" + padding + "\"}\n";
+		if (i == count / 2)
+			data += "\n{not json}\n"; // Skipped
+	}
+	QVERIFY(data.size() > 4 * 256 * 1024);
+
+	QBuffer buffer(&data);
+	QVERIFY(buffer.open(QIODevice::ReadOnly));
+	QVERIFY(m_model.loadNdjson(&buffer));
+	QVERIFY(!m_model.isFollowing());
+	QCOMPARE(m_model.scalarColumns(), QStringList({"id", "text"}));
+
+	QCOMPARE(m_model.rowCount(), count);
+	const int idColumn = m_model.scalarColumns().indexOf("id") + 2;
+	for (int i = 0; i < count; ++i)
+		QCOMPARE(m_model.index(i, idColumn).data().toInt(), i);
+}
+
+/*
+	Lines that are appended to a followed file become rows once their newlines are written.
+*/
+void
+tst_JsonTreeModel::followedFilesAppendRows()
+{
+	QTemporaryFile file;
+	QVERIFY(file.open());
+	file.write("{\"id\": 0}\n{\"id\": 1}\n{\"id\": ");
+	file.flush();
+
+	QVERIFY(m_model.followNdjson(file.fileName()));
+	QVERIFY(m_model.isFollowing());
+	QCOMPARE(m_model.rowCount(), 2);
+
+	// The incomplete line is kept until its newline arrives
+	file.write("2}\n{\"id\": 3}\n");
+	file.flush();
+	QTRY_COMPARE(m_model.rowCount(), 4);
+	const int idColumn = m_model.scalarColumns().indexOf("id") + 2;
+	for (int i = 0; i < 4; ++i)
+		QCOMPARE(m_model.index(i, idColumn).data().toInt(), i);
+
+	// A truncated file is loaded again from the start
+	file.resize(0);
+	file.seek(0);
+	file.write("{\"id\": 10}\n");
+	file.flush();
+	QTRY_COMPARE(m_model.rowCount(), 1);
+	QCOMPARE(m_model.index(0, idColumn).data().toInt(), 10);
+
+	// Replacing the data stops following
+	m_model.setJson(sampleDocument());
+	QVERIFY(!m_model.isFollowing());
+	file.write("{\"id\": 11}\n");
+	file.flush();
+	QTest::qWait(100);
+	QCOMPARE(m_model.rowCount(), 2);
+}
+
+QTEST_GUILESS_MAIN(tst_JsonTreeModel)
+#include "tst_jsontreemodel.moc"
@@ -0,0 +1,31 @@
+# Shared settings of the unit tests. Each test builds the model's sources itself, like the examples do.
+
+QT += core testlib
+QT -= gui
+
+CONFIG += console c++11 testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../src
+
+SOURCES += \
+    $$PWD/../src/jsontreemodel.cpp \
+    $$PWD/../src/jsontreesnapshot.cpp \
+    $$PWD/../src/jsontreeflatmodel.cpp \
+    $$PWD/../src/jsontreefiltermodel.cpp \
+    $$PWD/../src/jsontreepager.cpp \
+    $$PWD/../src/jsontreequery.cpp \
+    $$PWD/../src/jsontreedictionary.cpp \
+    $$PWD/../src/varianttreemodel.cpp
+
+HEADERS += \
+    $$PWD/../src/datatreemodelnode.h \
+    $$PWD/../src/datatreemodelcore.h \
+    $$PWD/../src/jsontreemodel.h \
+    $$PWD/../src/jsontreesnapshot.h \
+    $$PWD/../src/jsontreeflatmodel.h \
+    $$PWD/../src/jsontreefiltermodel.h \
+    $$PWD/../src/jsontreepager.h \
+    $$PWD/../src/jsontreequery.h \
+    $$PWD/../src/jsontreedictionary.h \
+    $$PWD/../src/varianttreemodel.h
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    jsontreemodel \
+    jsontreeflatmodel \
+    jsontreefiltermodel \
+    varianttreemodel
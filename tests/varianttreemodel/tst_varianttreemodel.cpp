@@ -0,0 +1,123 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "varianttreemodel.h"
+#include "jsontreemodel.h"
+#include <QtTest>
+
+class tst_VariantTreeModel : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init();
+
+	void layoutMatchesJsonTreeModel();
+	void nullsAreKept();
+	void setNullValue();
+
+private:
+	int nameColumn() const { return m_model.scalarColumns().indexOf("name") + 2; }
+
+	VariantTreeModel m_model;
+};
+
+/*
+	Three maps, each with a name, a number and a list of strings
+*/
+static QVariantList
+sampleList()
+{
+	QVariantList list;
+	for (int i = 0; i < 3; ++i)
+	{
+		list << QVariantMap{
+			{"name", QString("item %1").arg(i)},
+			{"number", i},
+			{"tags", QVariantList{"a", QString::number(i)}}
+		};
+	}
+	return list;
+}
+
+/*
+	Checks that both models show the same rows and cells under the given parents.
+*/
+static void
+compareModels(const QAbstractItemModel& model, const QModelIndex& parent, const QAbstractItemModel& expected, const QModelIndex& expectedParent)
+{
+	QCOMPARE(model.rowCount(parent), expected.rowCount(expectedParent));
+	QCOMPARE(model.columnCount(parent), expected.columnCount(expectedParent));
+	for (int row = 0; row < model.rowCount(parent); ++row)
+	{
+		for (int column = 0; column < model.columnCount(parent); ++column)
+		{
+			const QModelIndex index = model.index(row, column, parent);
+			QCOMPARE(index.parent(), parent);
+			QCOMPARE(index.data(), expected.index(row, column, expectedParent).data());
+			QCOMPARE(model.flags(index), expected.flags(expected.index(row, column, expectedParent)));
+		}
+		compareModels(model, model.index(row, 0, parent), expected, expected.index(row, 0, expectedParent));
+		if (QTest::currentTestFailed())
+			return;
+	}
+}
+
+void
+tst_VariantTreeModel::init()
+{
+	m_model.setVariant(sampleList());
+}
+
+void
+tst_VariantTreeModel::layoutMatchesJsonTreeModel()
+{
+	JsonTreeModel jsonModel;
+	jsonModel.setJson(QJsonArray::fromVariantList(sampleList()));
+	QCOMPARE(m_model.scalarColumns(), jsonModel.scalarColumns());
+	compareModels(m_model, QModelIndex(), jsonModel, QModelIndex());
+	QCOMPARE(m_model.variant(), QVariant(sampleList()));
+}
+
+void
+tst_VariantTreeModel::nullsAreKept()
+{
+	const QVariantList list{1, QVariant(), QVariantMap{{"name", QVariant()}, {"other", 2}}};
+	m_model.setVariant(list);
+	QCOMPARE(m_model.rowCount(), 3);
+	QVERIFY(!m_model.index(1, 1).data().isValid());
+	QVERIFY(m_model.flags(m_model.index(1, 1)).testFlag(Qt::ItemIsEditable));
+	QCOMPARE(m_model.variant(), QVariant(list));
+}
+
+void
+tst_VariantTreeModel::setNullValue()
+{
+	QSignalSpy changed(&m_model, &QAbstractItemModel::dataChanged);
+
+	// A null is stored as a value, and does not remove the member
+	QVERIFY(m_model.setData(m_model.index(0, nameColumn()), QVariant()));
+	QCOMPARE(changed.count(), 1);
+	const QVariantMap first = m_model.variant(m_model.index(0, 0)).toMap();
+	QVERIFY(first.contains("name"));
+	QVERIFY(!first.value("name").isValid());
+
+	// Storing the same null again changes nothing
+	QVERIFY(!m_model.setData(m_model.index(0, nameColumn()), QVariant()));
+	QCOMPARE(changed.count(), 1);
+
+	// A null member can be given a value again, and a missing member can be added as a null
+	QVERIFY(m_model.setData(m_model.index(0, nameColumn()), "renamed"));
+	QCOMPARE(m_model.index(0, nameColumn()).data(), QVariant("renamed"));
+	m_model.setScalarColumns(QStringList{"name", "missing"});
+	QVERIFY(m_model.setData(m_model.index(1, 3), QVariant()));
+	QVERIFY(m_model.variant(m_model.index(1, 0)).toMap().contains("missing"));
+}
+
+QTEST_GUILESS_MAIN(tst_VariantTreeModel)
+#include "tst_varianttreemodel.moc"
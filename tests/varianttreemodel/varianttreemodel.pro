@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_varianttreemodel
+
+SOURCES += \
+    tst_varianttreemodel.cpp
@@ -0,0 +1,107 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "accessrecorder.h"
+
+/*
+	AccessRecorder sits between a view and the model, and writes every call that the view makes
+	to a trace. Model indexes are recorded as row paths from the root (e.g. "/0/3") and a column,
+	because internal pointers are meaningless in another process. See AccessReplayer for the
+	trace format.
+*/
+AccessRecorder::AccessRecorder(QIODevice* trace, QObject* parent) :
+	QIdentityProxyModel(parent),
+	m_trace(trace),
+	m_recordedCalls(0)
+{}
+
+void
+AccessRecorder::setSourceModel(QAbstractItemModel* sourceModel)
+{
+	QIdentityProxyModel::setSourceModel(sourceModel);
+	m_trace << "# accessreplay 1\n";
+	if (sourceModel != nullptr)
+		m_trace << "# columns " << sourceModel->columnCount() << '\n';
+}
+
+QModelIndex
+AccessRecorder::index(int row, int column, const QModelIndex& parent) const
+{
+	m_trace << "index " << row << ' ' << column << ' ' << rowPath(parent) << ' ' << parent.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::index(row, column, parent);
+}
+
+QModelIndex
+AccessRecorder::parent(const QModelIndex& child) const
+{
+	m_trace << "parent " << rowPath(child) << ' ' << child.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::parent(child);
+}
+
+int
+AccessRecorder::rowCount(const QModelIndex& parent) const
+{
+	m_trace << "rowCount " << rowPath(parent) << ' ' << parent.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::rowCount(parent);
+}
+
+int
+AccessRecorder::columnCount(const QModelIndex& parent) const
+{
+	m_trace << "columnCount " << rowPath(parent) << ' ' << parent.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::columnCount(parent);
+}
+
+bool
+AccessRecorder::hasChildren(const QModelIndex& parent) const
+{
+	m_trace << "hasChildren " << rowPath(parent) << ' ' << parent.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::hasChildren(parent);
+}
+
+QVariant
+AccessRecorder::data(const QModelIndex& index, int role) const
+{
+	m_trace << "data " << rowPath(index) << ' ' << index.column() << ' ' << role << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::data(index, role);
+}
+
+QVariant
+AccessRecorder::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	m_trace << "headerData " << section << ' ' << static_cast<int>(orientation) << ' ' << role << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::headerData(section, orientation, role);
+}
+
+Qt::ItemFlags
+AccessRecorder::flags(const QModelIndex& index) const
+{
+	m_trace << "flags " << rowPath(index) << ' ' << index.column() << '\n';
+	++m_recordedCalls;
+	return QIdentityProxyModel::flags(index);
+}
+
+/*
+	Returns the rows from the root to the given index, e.g. "/0/3". The root is "/".
+	NOTE: This walks the source model directly, so that the walk itself is not recorded.
+*/
+QString
+AccessRecorder::rowPath(const QModelIndex& index) const
+{
+	QStringList rows;
+	for (auto sourceIndex = mapToSource(index); sourceIndex.isValid(); sourceIndex = sourceIndex.parent())
+		rows.prepend(QString::number(sourceIndex.row()));
+	return '/' + rows.join('/');
+}
@@ -0,0 +1,46 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef ACCESSRECORDER_H
+#define ACCESSRECORDER_H
+
+#include <QIdentityProxyModel>
+#include <QTextStream>
+
+//=================================
+// AccessRecorder
+//=================================
+class AccessRecorder : public QIdentityProxyModel
+{
+	Q_OBJECT
+
+public:
+	AccessRecorder(QIODevice* trace, QObject* parent = nullptr);
+
+	void setSourceModel(QAbstractItemModel* sourceModel) override;
+
+	QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+	QModelIndex parent(const QModelIndex& child) const override;
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+	bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+	Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+	int recordedCalls() const { return m_recordedCalls; }
+
+private:
+	QString rowPath(const QModelIndex& index) const;
+
+	mutable QTextStream m_trace;
+	mutable int m_recordedCalls;
+};
+
+#endif // ACCESSRECORDER_H
@@ -0,0 +1,27 @@
+QT += core gui widgets
+
+TARGET = accessreplay
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+SOURCES += \
+    main.cpp \
+    accessrecorder.cpp \
+    accessreplayer.cpp \
+    ../../src/jsontreemodel.cpp \
+    ../../src/jsontreesnapshot.cpp \
+    ../../src/jsontreepager.cpp \
+    ../../src/jsontreequery.cpp \
+    ../../src/jsontreedictionary.cpp
+
+HEADERS += \
+    accessrecorder.h \
+    accessreplayer.h \
+    ../../src/datatreemodelnode.h \
+    ../../src/datatreemodelcore.h \
+    ../../src/jsontreemodel.h \
+    ../../src/jsontreesnapshot.h \
+    ../../src/jsontreepager.h \
+    ../../src/jsontreequery.h \
+    ../../src/jsontreedictionary.h
@@ -0,0 +1,253 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#include "accessreplayer.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+
+/*
+	Trace format
+	============
+	A trace is a text file with one call per line. Lines that start with '#' are comments, except
+	for "# columns <n>", which records the model's column count. An index is written as the path
+	of rows from the root ("/" for the root, "/0/3" for the 4th child of the 1st top-level row)
+	followed by its column:
+
+		index <row> <column> <parent path> <parent column>
+		parent <path> <column>
+		rowCount <path> <column>
+		columnCount <path> <column>
+		hasChildren <path> <column>
+		data <path> <column> <role>
+		flags <path> <column>
+		headerData <section> <orientation> <role>
+
+	During a replay, the index returned by each index() call is kept, and used by later calls that
+	refer to it. This matches what the view did: it could only pass an index to the model after
+	the model created it. The paths are turned into slot numbers when the trace is loaded, so the
+	replay neither parses nor hashes them.
+*/
+
+/*
+	Returns the slot of the index with the given path and column, adding it if it is new. The
+	root has no slot.
+*/
+int
+AccessReplayer::slotFor(const QString& path, int column, QHash<QString, int>* slotIds)
+{
+	if (path == QLatin1String("/"))
+		return -1;
+
+	const QString key = path + ':' + QString::number(column);
+	auto i = slotIds->constFind(key);
+	if (i != slotIds->constEnd())
+		return i.value();
+
+	Slot slot;
+	for (const auto& row : path.mid(1).split('/'))
+		slot.rows << row.toInt();
+	slot.column = column;
+	m_slots << slot;
+	slotIds->insert(key, m_slots.count() - 1);
+	return m_slots.count() - 1;
+}
+
+/*
+	Reads a trace that was written by AccessRecorder.
+*/
+bool
+AccessReplayer::load(QIODevice* trace, QString* errorMessage)
+{
+	static const QHash<QString, Operation> operations
+	{
+		{"index", Index},
+		{"parent", Parent},
+		{"rowCount", RowCount},
+		{"columnCount", ColumnCount},
+		{"hasChildren", HasChildren},
+		{"data", Data},
+		{"headerData", HeaderData},
+		{"flags", Flags}
+	};
+
+	m_calls.clear();
+	m_slots.clear();
+	m_columnCount = -1;
+	QHash<QString, int> slotIds;
+
+	QTextStream in(trace);
+	int lineNumber = 0;
+	while (!in.atEnd())
+	{
+		const QString line = in.readLine();
+		++lineNumber;
+		const QStringList fields = line.split(' ', QString::SkipEmptyParts);
+		if (fields.isEmpty())
+			continue;
+
+		if (fields[0] == QLatin1String("#"))
+		{
+			if (fields.count() == 3 && fields[1] == QLatin1String("columns"))
+				m_columnCount = fields[2].toInt();
+			continue;
+		}
+
+		auto operation = operations.constFind(fields[0]);
+		static const int expectedFields[OperationCount] = {5, 3, 3, 3, 3, 4, 4, 3};
+		if (operation == operations.constEnd() || fields.count() != expectedFields[operation.value()])
+		{
+			*errorMessage = QStringLiteral("Malformed call on line %1: %2").arg(lineNumber).arg(line);
+			return false;
+		}
+
+		Call call;
+		call.operation = operation.value();
+		call.row = 0;
+		call.column = 0;
+		call.value = 0;
+		call.orientation = 0;
+		call.slot = -1;
+		call.childSlot = -1;
+		switch (call.operation)
+		{
+		case Index:
+			call.row = fields[1].toInt();
+			call.value = fields[2].toInt();
+			call.slot = slotFor(fields[3], fields[4].toInt(), &slotIds);
+			call.childSlot = slotFor((fields[3] == QLatin1String("/") ? fields[3] : fields[3] + '/') + fields[1], call.value, &slotIds);
+			break;
+
+		case HeaderData:
+			call.row = fields[1].toInt();
+			call.orientation = fields[2].toInt();
+			call.value = fields[3].toInt();
+			break;
+
+		case Data:
+			call.value = fields[3].toInt();
+			// Fall through
+		default:
+			call.column = fields[2].toInt();
+			call.slot = slotFor(fields[1], call.column, &slotIds);
+		}
+		m_calls << call;
+	}
+
+	m_indexes.fill(QModelIndex(), m_slots.count());
+	m_resolved.fill(false, m_slots.count());
+	return true;
+}
+
+/*
+	Replays the trace against the given model, and returns the elapsed time and the number of
+	calls of each kind.
+*/
+AccessReplayer::Result
+AccessReplayer::replay(const QAbstractItemModel* model) const
+{
+	Result result;
+	std::fill(result.calls, result.calls + OperationCount, 0);
+	result.unresolvedIndexes = 0;
+
+	// NOTE: Filling the vectors with the same size reuses them, so this does not allocate either
+	m_indexes.fill(QModelIndex());
+	m_resolved.fill(false);
+
+	// NOTE: The results are kept until the next call of the same kind, so that destroying them is timed too
+	QModelIndex index;
+	QVariant value;
+	int count = 0;
+	bool flag = false;
+	Qt::ItemFlags itemFlags;
+
+	QElapsedTimer timer;
+	timer.start();
+	for (const auto& call : m_calls)
+	{
+		++result.calls[call.operation];
+		switch (call.operation)
+		{
+		case Index:
+			index = model->index(call.row, call.value, resolve(model, call.slot, &result.unresolvedIndexes));
+			m_indexes[call.childSlot] = index;
+			m_resolved[call.childSlot] = true;
+			break;
+
+		case Parent:
+			index = model->parent(resolve(model, call.slot, &result.unresolvedIndexes));
+			break;
+
+		case RowCount:
+			count += model->rowCount(resolve(model, call.slot, &result.unresolvedIndexes));
+			break;
+
+		case ColumnCount:
+			count += model->columnCount(resolve(model, call.slot, &result.unresolvedIndexes));
+			break;
+
+		case HasChildren:
+			flag ^= model->hasChildren(resolve(model, call.slot, &result.unresolvedIndexes));
+			break;
+
+		case Data:
+			value = model->data(resolve(model, call.slot, &result.unresolvedIndexes), call.value);
+			break;
+
+		case HeaderData:
+			value = model->headerData(call.row, static_cast<Qt::Orientation>(call.orientation), call.value);
+			break;
+
+		case Flags:
+			itemFlags = model->flags(resolve(model, call.slot, &result.unresolvedIndexes));
+			break;
+
+		default:
+			break;
+		}
+	}
+	result.nsecs = timer.nsecsElapsed();
+
+	Q_UNUSED(count);
+	Q_UNUSED(flag);
+	return result;
+}
+
+QString
+AccessReplayer::operationName(Operation operation)
+{
+	static const char* const names[OperationCount] =
+	{
+		"index", "parent", "rowCount", "columnCount", "hasChildren", "data", "headerData", "flags"
+	};
+	return QString::fromLatin1(names[operation]);
+}
+
+/*
+	Returns the index that the trace refers to. An index that was not returned by an earlier
+	index() call (e.g. a persistent index that the view kept from an earlier session) is looked
+	up via index(), which adds calls that the view did not make; such lookups are counted.
+*/
+QModelIndex
+AccessReplayer::resolve(const QAbstractItemModel* model, int slot, int* unresolved) const
+{
+	if (slot < 0)
+		return QModelIndex();
+	if (m_resolved[slot])
+		return m_indexes[slot];
+
+	++*unresolved;
+	const Slot& path = m_slots[slot];
+	QModelIndex index;
+	for (int level = 0; level < path.rows.count(); ++level)
+		index = model->index(path.rows[level], (level == path.rows.count() - 1) ? path.column : 0, index);
+
+	m_indexes[slot] = index;
+	m_resolved[slot] = true;
+	return index;
+}
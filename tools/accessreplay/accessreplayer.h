@@ -0,0 +1,86 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+#ifndef ACCESSREPLAYER_H
+#define ACCESSREPLAYER_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+class QIODevice;
+
+//=================================
+// AccessReplayer
+//=================================
+class AccessReplayer
+{
+public:
+	AccessReplayer() : m_columnCount(-1) {}
+
+	enum Operation
+	{
+		Index,
+		Parent,
+		RowCount,
+		ColumnCount,
+		HasChildren,
+		Data,
+		HeaderData,
+		Flags,
+		OperationCount
+	};
+
+	struct Result
+	{
+		qint64 nsecs;
+		int calls[OperationCount];
+		int unresolvedIndexes; // Indexes that the trace used before obtaining them from index()
+	};
+
+	bool load(QIODevice* trace, QString* errorMessage);
+	int recordedColumnCount() const { return m_columnCount; }
+	int callCount() const { return m_calls.count(); }
+
+	Result replay(const QAbstractItemModel* model) const;
+
+	static QString operationName(Operation operation);
+
+private:
+	// A pre-parsed call, so that parsing is not part of the replay
+	struct Call
+	{
+		Operation operation;
+		int row;       // index(): the requested row. headerData(): the section
+		int column;    // The column of the index argument, or of the requested index
+		int value;     // data() and headerData(): the role. index(): the requested column
+		int orientation;
+		int slot;      // The index argument (or the parent, for index()), or -1 for the root
+		int childSlot; // index(): the index that is returned
+	};
+
+	// An index that the trace refers to, by its rows from the root and its column
+	struct Slot
+	{
+		QVector<int> rows;
+		int column;
+	};
+
+	int slotFor(const QString& path, int column, QHash<QString, int>* slotIds);
+	QModelIndex resolve(const QAbstractItemModel* model, int slot, int* unresolved) const;
+
+	QVector<Call> m_calls;
+	QVector<Slot> m_slots;
+	int m_columnCount;
+
+	// NOTE: Allocated by load(), so that the replay itself allocates nothing
+	mutable QVector<QModelIndex> m_indexes;
+	mutable QVector<bool> m_resolved;
+};
+
+#endif // ACCESSREPLAYER_H
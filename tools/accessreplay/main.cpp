@@ -0,0 +1,294 @@
+/*\
+ * Copyright (c) 2018 Sze Howe Koh
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+\*/
+
+/*
+	accessreplay records the calls that a QTreeView makes on a JsonTreeModel, and replays them
+	without a view, so that changes to the model can be measured on realistic workloads:
+
+		accessreplay record <document.json> <trace.txt> [--workload expand-all|scroll|interactive]
+		accessreplay replay <document.json> <trace.txt> [--repeat <n>]
+
+	Recording needs a window, but works headlessly with "-platform offscreen".
+*/
+
+#include "accessrecorder.h"
+#include "accessreplayer.h"
+#include "../../src/jsontreemodel.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QScrollBar>
+#include <QTextStream>
+#include <QTreeView>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//=================================
+// Allocation counters
+//=================================
+static std::atomic<qint64> allocationCount(0);
+static std::atomic<qint64> allocatedBytes(0);
+
+#if defined(__GLIBC__)
+// NOTE: Qt's containers (QArrayData, QHashData, ...) call malloc() directly, so the C allocation functions are
+// replaced; operator new calls malloc() too. The replacements forward to glibc's own implementations, and every
+// library in the process calls them instead of glibc's, so all allocations are counted.
+static const char allocationLabel[] = "allocations";
+
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+
+void*
+malloc(std::size_t size) noexcept
+{
+	++allocationCount;
+	allocatedBytes += size;
+	return __libc_malloc(size);
+}
+
+void*
+calloc(std::size_t count, std::size_t size) noexcept
+{
+	++allocationCount;
+	allocatedBytes += count * size;
+	return __libc_calloc(count, size);
+}
+
+// NOTE: Growing a QVector or a QString reallocates it, which may move it, so it counts as an allocation
+void*
+realloc(void* p, std::size_t size) noexcept
+{
+	++allocationCount;
+	allocatedBytes += size;
+	return __libc_realloc(p, size);
+}
+}
+
+#else
+// NOTE: Without glibc, only operator new is replaced. Qt's containers allocate with malloc(), so their allocations
+// are not counted, and the report says so.
+static const char allocationLabel[] = "operator new allocations";
+
+void*
+operator new(std::size_t size)
+{
+	++allocationCount;
+	allocatedBytes += size;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void*
+operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void
+operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+#endif
+
+
+//=================================
+// Commands
+//=================================
+static bool
+loadDocument(JsonTreeModel* model, const QString& fileName, JsonTreeModel::ScalarColumnSearchMode searchMode)
+{
+	QFile file(fileName);
+	if (!file.open(QFile::ReadOnly))
+		return false;
+
+	const auto document = QJsonDocument::fromJson(file.readAll());
+	if (document.isArray())
+		model->setJson(document.array(), searchMode);
+	else if (document.isObject())
+		model->setJson(document.object(), searchMode);
+	else
+		return false;
+	return true;
+}
+
+static int
+record(JsonTreeModel* model, const QString& traceName, const QString& workload)
+{
+	QFile traceFile(traceName);
+	if (!traceFile.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+	{
+		qWarning("Cannot write %s", qPrintable(traceName));
+		return 1;
+	}
+
+	AccessRecorder recorder(&traceFile);
+	recorder.setSourceModel(model);
+
+	QTreeView view;
+	view.resize(1024, 768);
+	view.setModel(&recorder);
+	view.show();
+	QApplication::processEvents();
+
+	if (workload == QLatin1String("expand-all"))
+	{
+		view.expandAll();
+		QApplication::processEvents();
+	}
+	else if (workload == QLatin1String("scroll"))
+	{
+		view.expandAll();
+		QApplication::processEvents();
+
+		auto scrollBar = view.verticalScrollBar();
+		while (scrollBar->value() < scrollBar->maximum())
+		{
+			scrollBar->setValue(scrollBar->value() + scrollBar->pageStep());
+			view.viewport()->repaint(); // NOTE: Like a user scrolling, each page is painted
+		}
+	}
+	else if (workload == QLatin1String("interactive"))
+		QApplication::exec();
+	else
+	{
+		qWarning("Unknown workload: %s", qPrintable(workload));
+		return 1;
+	}
+
+	// NOTE: Detach the view first, so that the model's destruction is not recorded
+	view.setModel(nullptr);
+	QTextStream(stdout) << "Recorded " << recorder.recordedCalls() << " calls to " << traceName << endl;
+	return 0;
+}
+
+static int
+replay(JsonTreeModel* model, const QString& traceName, int repeat)
+{
+	QFile traceFile(traceName);
+	if (!traceFile.open(QFile::ReadOnly | QFile::Text))
+	{
+		qWarning("Cannot read %s", qPrintable(traceName));
+		return 1;
+	}
+
+	AccessReplayer replayer;
+	QString errorMessage;
+	if (!replayer.load(&traceFile, &errorMessage))
+	{
+		qWarning("%s", qPrintable(errorMessage));
+		return 1;
+	}
+	if (replayer.recordedColumnCount() >= 0 && replayer.recordedColumnCount() != model->columnCount())
+		qWarning("The trace was recorded with %d columns, but the model has %d", replayer.recordedColumnCount(), model->columnCount());
+
+	QTextStream out(stdout);
+	qint64 bestNsecs = -1;
+	qint64 totalNsecs = 0;
+	for (int run = 0; run < repeat; ++run)
+	{
+		const qint64 allocationsBefore = allocationCount;
+		const qint64 bytesBefore = allocatedBytes;
+		const auto result = replayer.replay(model);
+		const qint64 allocations = allocationCount - allocationsBefore;
+		const qint64 bytes = allocatedBytes - bytesBefore;
+
+		if (run == 0)
+		{
+			out << "Calls:";
+			for (int op = 0; op < AccessReplayer::OperationCount; ++op)
+				out << ' ' << AccessReplayer::operationName(static_cast<AccessReplayer::Operation>(op)) << '=' << result.calls[op];
+			out << '\n';
+			if (result.unresolvedIndexes > 0)
+				out << "Indexes looked up outside of the trace: " << result.unresolvedIndexes << '\n';
+		}
+		out << "Run " << (run + 1) << ": " << QString::number(result.nsecs / 1e6, 'f', 3) << " ms, "
+			<< allocations << ' ' << allocationLabel << " (" << bytes << " bytes)" << endl;
+
+		totalNsecs += result.nsecs;
+		if (bestNsecs < 0 || result.nsecs < bestNsecs)
+			bestNsecs = result.nsecs;
+	}
+
+	out << "Best: " << QString::number(bestNsecs / 1e6, 'f', 3) << " ms, mean: "
+		<< QString::number(totalNsecs / 1e6 / repeat, 'f', 3) << " ms over "
+		<< replayer.callCount() << " calls" << endl;
+	return 0;
+}
+
+
+//=================================
+// main()
+//=================================
+int main(int argc, char *argv[])
+{
+	// NOTE: Only recording needs a GUI
+	const bool isRecording = (argc > 1 && qstrcmp(argv[1], "record") == 0);
+	QScopedPointer<QCoreApplication> app( isRecording ? new QApplication(argc, argv) : new QCoreApplication(argc, argv) );
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Records the calls that a QTreeView makes on a JsonTreeModel, and replays them without a view.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("command", "\"record\" or \"replay\"");
+	parser.addPositionalArgument("document", "The JSON document to load");
+	parser.addPositionalArgument("trace", "The trace file to write or read");
+
+	QCommandLineOption workloadOption("workload", "What the view does while recording: expand-all (default), scroll or interactive.", "workload", "expand-all");
+	QCommandLineOption repeatOption("repeat", "How many times to replay the trace (default: 5).", "n", "5");
+	QCommandLineOption searchOption("search", "How to find the scalar columns: none, quick (default) or comprehensive.", "mode", "quick");
+	parser.addOption(workloadOption);
+	parser.addOption(repeatOption);
+	parser.addOption(searchOption);
+	parser.process(*app);
+
+	const QStringList arguments = parser.positionalArguments();
+	if (arguments.count() != 3 || (arguments[0] != QLatin1String("record") && arguments[0] != QLatin1String("replay")))
+		parser.showHelp(1);
+
+	auto searchMode = JsonTreeModel::QuickSearch;
+	if (parser.value(searchOption) == QLatin1String("none"))
+		searchMode = JsonTreeModel::NoSearch;
+	else if (parser.value(searchOption) == QLatin1String("comprehensive"))
+		searchMode = JsonTreeModel::ComprehensiveSearch;
+
+	JsonTreeModel model;
+	if (!loadDocument(&model, arguments[1], searchMode))
+	{
+		qWarning("Cannot load a JSON array or object from %s", qPrintable(arguments[1]));
+		return 1;
+	}
+
+	if (isRecording)
+		return record(&model, arguments[2], parser.value(workloadOption));
+	return replay(&model, arguments[2], qMax(1, parser.value(repeatOption).toInt()));
+}